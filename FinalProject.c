@@ -1,12 +1,27 @@
+// Build with: gcc -std=gnu11 -O2 FinalProject.c -o FinalProject -lm -pthread
+// -lm links pow and sqrt, which the roll statistics self-test and the expected damage averages use.
+#define _GNU_SOURCE           // For syncfs and open_memstream
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <limits.h>
 #include <string.h>
 #include <math.h>
 #include <string.h>
 #include <time.h>
 #include <ctype.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include <malloc.h>
+#include <poll.h>
 
 struct Character {
+    int id;                   // Character's stable storage ID (names its file under roster/)
     char name[25];            // Character's name (up to 24 characters + null terminator)
     int level;                // Character's current level (determines power and abilities)
     struct Class *class;      // Pointer to the character's class (e.g., Fighter, Wizard)
@@ -26,6 +41,10 @@ struct Character {
     int hasShield;            // Boolean indicating if the character has a shield (1 = yes, 0 = no)
     int proficiencyModifier;  // Character's proficiency modifier (based on level)
     int HP;                   // Character's current hit points (health value)
+    int isLoaded;             // Boolean indicating if the fields past name are in memory (0 = only id and name, see --lazy)
+    unsigned long lastUsed;   // Access tick of the last time the character was used (for evicting cold characters)
+    struct RollStats *rollStats;  // Rolls this character has made this session (NULL until their first roll)
+    struct CharacterHistory *history;  // Versions recorded this session (NULL until the character is first edited)
     struct Character *next;   // Pointer to the next character in a linked list
 };
 
@@ -38,8 +57,6 @@ struct Armor {
     int stealthDisadvantage;  // Boolean indicating if this armor imposes disadvantage on Stealth checks (1 = yes, 0 = no)
 };
 
-struct Armor armors[13];      // Array to hold all of the data that armors.txt has
-
 struct Weapon {
     char *name;               // Name of the weapon (e.g., "Longsword", "Shortbow")
     char *type;               // Category of weapon (e.g., "Melee", "Ranged")
@@ -55,23 +72,126 @@ struct Weapon {
     int isReach;              // Boolean indicating if the weapon has extended reach (1 = yes, 0 = no)
 };
 
-struct Weapon weapons[31];    // Array to hold all of the data that weapons.txt has
+struct Monster {
+    char *name;               // Name of the monster (e.g., "Goblin", "Ogre")
+    int armorClass;           // Monster's Armor Class
+    int HP;                   // Monster's hit points
+    int attackBonus;          // Bonus added to the monster's attack rolls
+    char *damageDice;         // Damage dice for the monster's attack (e.g., "1d6", "2d8")
+    int damageBonus;          // Bonus added to the monster's damage rolls
+    int dexterity;            // Monster's Dexterity score (used for initiative)
+};
 
 struct Class {
     char *name;               // Name of the class (e.g., "Fighter", "Wizard", "Rogue")
     char *subClass;           // Name of the subclass or specialization (e.g., "Champion", "Evoker")
-    char *hitDie;             // Hit die used for determining hit points (e.g., "1d8", "1d10")
+    int hitDie;               // Hit die used for determining hit points (e.g., 8 for a d8, 10 for a d10)
+    struct ClassProgression *progression;  // Progression table row for this class (NULL until initializeHitDie runs)
 };
 
-char *attributes[6];          // Array to hold all of the data that armors.txt has
+#define MAX_LEVEL 20          // Highest level a character can reach
 
-char *alignments[9];          // Array to hold all of the data that armors.txt has
-
-char *races[10];              // Array to hold all of the data that armors.txt has
+struct ClassProgression {
+    char *name;                        // Name of the class (matches classes.txt)
+    int hitDie;                        // Hit die size (e.g., 12 for a d12)
+    int hpPerLevel;                    // Fixed HP gained each level after 1st (hitDie / 2 + 1)
+    int subClassLevel;                 // Level the subclass is unlocked at
+    int baseHP[MAX_LEVEL + 1];         // HP at each level before the Constitution modifier is added
+    int proficiency[MAX_LEVEL + 1];    // Proficiency modifier at each level
+};
 
-char *backgrounds[16];        // Array to hold all of the data that armors.txt has
+// Everything loaded from the catalog files. Each reload builds a whole new catalog (an epoch) off to the side
+// and publishes it, so a thread never sees a catalog that is half way through loading.
+struct Catalog {
+    unsigned int epoch;                  // Increases by one every time the catalog files are reloaded
+    int readers;                         // Threads pinned to this epoch, plus one while it is the latest
+    struct Armor armors[13];             // armors.txt
+    struct Weapon weapons[31];           // weapons.txt
+    struct Monster monsters[10];         // monsters.txt
+    struct ClassProgression *classProgressions;  // classProgression.txt
+    int classProgressionCount;           // Number of rows in classProgressions
+    char *attributes[6];                 // attributes.txt
+    char *alignments[9];                 // alignments.txt
+    char *races[10];                     // races.txt
+    char *backgrounds[16];               // backgrounds.txt
+    char *classes[12][5];                // classes.txt (name followed by its four subclasses)
+};
 
-char *classes[12][5];         // Array to hold all of the data that armors.txt has
+__thread struct Catalog *catalog;        // Epoch this thread is reading (parallelFor workers share their caller's)
+struct Catalog *latestCatalog;           // Newest epoch published by the catalog watcher
+pthread_mutex_t catalogLock = PTHREAD_MUTEX_INITIALIZER;
+int catalogWatching = 1;                 // Reload the catalog files when they change (off with --no-watch)
+
+// Trace functions
+// With --trace=<file>, TRACE_SPAN records how long the rest of the enclosing block takes. Each thread writes its
+// spans into its own ring buffer (the oldest are overwritten once it is full, so recording never takes a lock),
+// and at exit every buffer is written out as Chrome trace-event JSON that Perfetto or chrome://tracing can open.
+// Spans wrap a whole unit of work (a worker slice, one character's optimizer search) rather than the stat helpers
+// it calls, which run millions of times and would push everything else out of the ring.
+#define TRACE_RING_SIZE 16384         // Spans kept per thread
+struct TraceEvent {
+    const char *name;                 // String literal naming the span
+    const char *category;
+    long long start;                  // Nanoseconds since tracing started
+    long long duration;
+};
+struct TraceBuffer {
+    int tid;                          // Thread number shown in the trace
+    const char *threadName;
+    int inUse;                        // 0 once the owning thread has exited, the next new thread reuses it
+    unsigned long long recorded;      // Spans recorded so far, the ring holds the last TRACE_RING_SIZE
+    struct TraceEvent events[TRACE_RING_SIZE];
+    struct TraceBuffer *next;
+};
+struct TraceSpan {
+    const char *name;                 // NULL when tracing is off
+    const char *category;
+    long long start;
+};
+int tracing = 0;                      // Boolean indicating if --trace was given
+char traceFileName[256];              // File the trace is written to at exit
+// Starts recording if --trace was given
+void startTracing(void);
+struct TraceSpan traceBegin(const char *name, const char *category);
+// Records a finished span in the calling thread's ring buffer
+void traceEnd(struct TraceSpan *span);
+// Labels the calling thread in the trace
+void traceThreadName(const char *name);
+// Writes every recorded span to traceFileName
+void stopTracing(void);
+#define TRACE_SPAN(name, category) struct TraceSpan traceSpan __attribute__((cleanup(traceEnd))) = traceBegin(name, category)
+
+// Memory accounting functions
+// Every heap allocation goes through the tracked* wrappers with the subsystem that owns it. The wrappers count
+// the allocator's usable size of each block, so the same tag has to be passed again when the block is freed.
+enum MemoryTag {
+    MEMORY_CATALOG,           // Catalog epochs and their strings
+    MEMORY_ROSTER,            // Characters, their strings and roll stats, campaigns and packed rosters
+    MEMORY_NAMES,             // Name filters and packed name arenas
+    MEMORY_HISTORY,           // Character version history
+    MEMORY_IO,                // File contents, index buffers and queued writes
+    MEMORY_WORK,              // Scratch arrays for menus, simulations and trace buffers
+    MEMORY_TAGS
+};
+struct MemoryUsage {
+    long long liveBytes;
+    long long peakBytes;
+    long long liveAllocations;
+    long long totalAllocations;
+};
+struct MemoryUsage memoryUsage[MEMORY_TAGS];
+struct MemoryUsage memoryTotal;       // Every subsystem together (its peak is the peak of the sum)
+void *trackedMalloc(size_t size, enum MemoryTag tag);
+void *trackedCalloc(size_t count, size_t size, enum MemoryTag tag);
+void *trackedRealloc(void *pointer, size_t size, enum MemoryTag tag);
+char *trackedStrdup(const char *value, enum MemoryTag tag);
+void trackedFree(void *pointer, enum MemoryTag tag);
+// Starts counting a block the C library allocated for us (e.g. an open_memstream buffer)
+void trackAdopted(void *pointer, enum MemoryTag tag);
+// Prints live and peak usage for every subsystem
+void printMemoryUsage(void);
+// Reports anything still allocated once the program has freed everything it owns
+void reportLeaks(void);
 
 // Utility functions
 void inputBuffer(void);
@@ -79,32 +199,564 @@ int isValidInput(int *userInput, int floor, int ceiling);
 int isValidName(char *name);
 
 // File Loading functions
-void loadArmors(const char *filename);
-void freeArmors(void);
-void loadWeapons(const char *filename);
-void freeWeapons(void);
-void loadFilesTo2DArray(const char *filename, char **array, int i);
+int loadArmors(struct Catalog *catalog, const char *filename);
+void freeArmors(struct Catalog *catalog);
+int loadWeapons(struct Catalog *catalog, const char *filename);
+void freeWeapons(struct Catalog *catalog);
+int loadFilesTo2DArray(const char *filename, char **array, int i);
 void free2DArray(char **array, int size);
-void loadClassesFromFile(const char *filename);
-void freeClasses(void);
+int loadClassesFromFile(struct Catalog *catalog, const char *filename);
+void freeClasses(struct Catalog *catalog);
+int loadClassProgression(struct Catalog *catalog, const char *filename);
+void freeClassProgression(struct Catalog *catalog);
+int loadMonsters(struct Catalog *catalog, const char *filename);
+void freeMonsters(struct Catalog *catalog);
 void loadCharactersFromFile(struct Character **currCharacter);
 void writeCharacterToFile(const char *fileName, struct Character *character);
+void printCharacterRecord(FILE *characterFile, struct Character *character);
 void initializeGlobalArrays(void);
 
+// Catalog functions
+// The catalog files are watched with inotify. A change is parsed into a new epoch on the watcher thread and
+// published as the latest catalog; each thread keeps reading the epoch it pinned until it moves to the new
+// one, and an epoch is freed once the last thread pinned to it lets go.
+// Loads every catalog file into a new epoch, setting *valid to 0 if any file was missing or malformed
+struct Catalog *loadCatalog(unsigned int epoch, int *valid);
+void freeCatalog(struct Catalog *catalog);
+// Pins the latest epoch for the calling thread
+struct Catalog *acquireCatalog(void);
+// Unpins an epoch, freeing it if it was the last reader of a replaced epoch
+void releaseCatalog(struct Catalog *catalog);
+// Makes a freshly loaded epoch the latest one
+void publishCatalog(struct Catalog *next);
+// Moves the main thread onto the latest epoch, repointing every character's armor, weapon and class row
+void refreshCatalog(struct Character *head);
+void startCatalogWatcher(void);
+void stopCatalogWatcher(void);
+
+// Name filter functions
+// A cuckoo filter over the current campaign's character names answers "is there a character called X?" without
+// scanning the roster: a miss is certain, a hit is confirmed against the list. Each name is kept as a 16-bit
+// fingerprint in one of two buckets, so names can be removed again when characters are deleted. The filter is
+// saved next to index.txt as names.filter and only trusted at startup if the index has not changed since.
+#define FILTER_BUCKET_SIZE 4          // Fingerprints per bucket
+#define FILTER_MAX_KICKS 500          // Relocations tried before an insert gives up and the filter is rebuilt larger
+#define FILTER_MAX_LOAD 0.9           // Fraction of slots used before the filter is rebuilt larger
+struct NameFilter {
+    unsigned int bucketCount;         // Always a power of two
+    unsigned int count;               // Fingerprints stored
+    int saturated;                    // Set if the roster could not fit (e.g. many characters sharing a name), every lookup then hits
+    unsigned long long nameSum;       // Sum of the stored names' hashes, checked against the roster when names.filter is loaded
+    unsigned short *slots;            // bucketCount * FILTER_BUCKET_SIZE fingerprints, 0 is an empty slot
+};
+struct NameFilter nameFilter;         // Filter for the current campaign
+// Returns 0 if no character in the current campaign can be named name, 1 if one might be
+int nameFilterContains(const char *name);
+// Adds the name of a character that has already been linked into head, rebuilding the filter from head if it is full
+void nameFilterAdd(struct Character *head, const char *name);
+// Adds several characters that have already been linked into head
+void nameFilterAddMany(struct Character *head, struct Character **characters, int count);
+// Removes one copy of a name after its character has been deleted
+void nameFilterRemove(const char *name);
+// Frees the new characters whose names are already in the roster or earlier in the batch and moves the rest to the
+// front, returns how many are left. head must not hold the new characters yet.
+int dropTakenNames(struct Character *head, struct Character **characters, int count);
+// Rebuilds the filter from the whole roster, sized for it to be half full
+void rebuildNameFilter(struct Character *head);
+void freeNameFilter(struct NameFilter *filter);
+// Writes the filter to names.filter, tagged with the index.txt line counts it matches
+void saveNameFilter(void);
+// Reads names.filter, returns 0 if it matches the index and the roster that were just loaded
+int loadNameFilter(struct Character *head);
+// Returns 1 if a character in the list has the name (the filter answers misses, the list confirms hits)
+int characterNameExists(struct Character *head, const char *name);
+
+// Campaign functions
+// Each campaign keeps its own index.txt, roster directory and roster.pack under campaigns/<name>/, while the
+// default campaign uses the working directory so existing rosters keep working. Campaigns are opened on
+// demand and stay resident after switching away, most recently used first, until the estimated memory of
+// the resident rosters passes campaignBudget and the coldest ones are flushed and freed.
+#define CAMPAIGN_DIRECTORY "campaigns"
+#define DEFAULT_CAMPAIGN "default"
+struct Campaign {
+    char name[25];                   // Campaign name (also its directory under campaigns/)
+    char directory[64];              // Prefix for the campaign's files ("" for the default campaign)
+    struct Character *characters;    // Roster, kept up to date whenever the campaign is switched away from
+    int nextCharacterId;             // Saved storage counters of the campaign while it is not current
+    int indexEntryLines;
+    int indexTombstoneLines;
+    int loadedCharacterCount;
+    struct NameFilter names;         // The campaign's name filter while it is not current
+    size_t bytes;                    // Roster and name filter memory, from the allocation counters when it was parked
+    struct Campaign *next;           // Next most recently used campaign
+};
+struct Campaign *campaigns = NULL;   // Resident campaigns, most recently used first (the current one is first)
+char campaignDirectory[64] = "";     // Prefix for the current campaign's files
+size_t campaignBudget = 256 * 1024 * 1024;  // Most bytes of resident rosters (--campaign-budget=<MB>)
+char initialCampaign[25] = DEFAULT_CAMPAIGN;  // Campaign opened at startup (--campaign=<name>)
+// Opens the default campaign, or the one given with --campaign=<name>
+void openInitialCampaign(struct Character **head);
+// Makes a campaign current, opening it if it is not resident, and points *head at its roster
+void switchCampaign(struct Character **head, const char *name);
+// Frees the least recently used campaigns (never the current one) until the resident rosters fit the budget
+void enforceCampaignBudget(void);
+// Lets the user switch campaigns and see which ones are resident
+void campaignMenu(struct Character **head);
+// Frees every campaign other than the current one
+void closeCampaigns(void);
+
+// Storage functions
+// Characters are stored by ID as roster/<ab>/<cd>/<id>.txt, where ab/cd come from a hash of the ID so no
+// directory grows past a few hundred files. index.txt holds one "<id>,<name>" line per character.
+// Deleting a character appends a "-<id>" tombstone instead of rewriting the index, and the index is
+// compacted (rewritten without tombstoned entries) once tombstones make up INDEX_COMPACTION_RATIO of it.
+#define ROSTER_DIRECTORY "roster"
+#define INDEX_COMPACTION_RATIO 0.25
+int nextCharacterId = 1;      // ID handed to the next new character
+int nextMemoryOnlyId = -1;    // ID handed to the next memory-only generated character (counts down, never saved)
+int indexEntryLines = 0;      // "<id>,<name>" lines in index.txt
+int indexTombstoneLines = 0;  // "-<id>" lines in index.txt
+void characterFilePath(int id, char *path, size_t size);
+int ensureCharacterDirectory(int id);
+// Builds the path of a file (index.txt, roster.pack, ...) inside the current campaign's directory
+void campaignFilePath(const char *name, char *path, size_t size);
+int saveCharacter(struct Character *character);
+int deleteCharacterFile(int id);
+// Queue an index line to be added or removed by the persistence worker
+void appendIndexEntry(struct Character *character);
+void removeIndexEntry(int id);
+// Rewrites index.txt from the list followed by legacy file name lines still waiting to move, returns 0 on success
+int rewriteIndex(struct Character *head, char **legacyLines, int legacyCount);
+// Rewrites index.txt without tombstones or the entries they delete (temp file + atomic rename)
+void compactIndex(void);
+
+// Persistence functions
+// Every save writes the new contents to "<path>.tmp" and renames it over the old file, so a crash never
+// leaves a half written character. Saves, deletes and index updates are pushed onto a lock-free queue and
+// a background worker commits them in groups with one sync per batch, so the menus never wait on the disk.
+// Repeated saves of one character in a batch are coalesced and index updates are applied in one pass.
+enum DurabilityMode {
+    DURABILITY_IMMEDIATE,     // Each save is committed and synced before it returns
+    DURABILITY_GROUP,         // Saves within the group commit window are committed together with one sync
+    DURABILITY_ASYNC          // Saves are committed within the window but never synced (fastest, a crash can lose recent edits)
+};
+enum DurabilityMode durabilityMode = DURABILITY_GROUP;
+int groupCommitWindowMs = 50; // How long a save may wait for others to join its group commit
+// Queues a serialized copy of the character to be committed to its roster file (takes ownership of contents)
+void queueCharacterWrite(int id, char *contents, size_t length);
+// Queues the removal of a character's roster file, dropping any write still queued for it
+void queueCharacterDelete(int id);
+enum PersistOpType {
+    PERSIST_WRITE,            // Write a character's roster file
+    PERSIST_DELETE,           // Remove a character's roster file
+    PERSIST_INDEX_APPEND,     // Add a line to index.txt
+    PERSIST_INDEX_REMOVE,     // Remove a character's line from index.txt
+    PERSIST_FLUSH,            // Commit everything queued before this and wake the caller
+    PERSIST_STOP              // Commit everything and stop the worker
+};
+struct IndexUpdate {
+    int id;
+    char name[25];
+};
+// Queues an index.txt change for the persistence worker
+void queueIndexUpdate(enum PersistOpType type, int id, const char *name);
+// Commits everything queued so far and waits for it to reach the disk, returns -1 if a roster file
+// could not be written or replaced since the last flush
+int flushPendingWrites(void);
+// Writes contents to path through a temp file and an atomic rename, syncing first if requested
+int writeFileAtomically(const char *path, const char *contents, size_t length, int sync);
+// Starts the persistence worker thread
+void startPersistence(void);
+// Commits everything still queued and stops the persistence worker
+void stopPersistence(void);
+// Reads --durability=immediate|group|async and --group-window=<ms> from the command line
+void parseCommandLine(int argc, char *argv[]);
+
+// Lazy loading functions
+// With --lazy, startup only reads index.txt and creates characters holding just their id and name.
+// The rest of a character is read from its roster file the first time it is used, and characters
+// that have not been used recently are unloaded again once more than lazyBudget are in memory.
+int lazyLoading = 0;          // Boolean indicating if --lazy was given
+int lazyBudget = 1000;        // Most characters kept fully loaded at once with --lazy
+int loadedCharacterCount = 0; // Characters currently fully loaded
+// Reads a character file into an existing character, returns 0 on success
+int readCharacterFile(const char *fileName, struct Character *character);
+// Thread safe part of readCharacterFile: reads and validates the file, leaving any error or warning in message
+int loadCharacterRecord(const char *fileName, struct Character *character, char *message, size_t messageSize);
+// Makes sure a character is fully loaded and marks it as recently used, returns 0 on success
+int ensureLoaded(struct Character *character);
+// Frees a character and everything it owns
+void freeCharacter(struct Character *character);
+// Finds a character by name and makes sure it is fully loaded (NULL if not found)
+struct Character *findCharacter(struct Character *head, const char *name);
+// Unloads the least recently used characters until no more than lazyBudget are loaded
+void enforceMemoryBudget(struct Character *head);
+
+// History functions
+// Every edit records a new immutable version of the character. Versions are split into blocks (identity,
+// abilities, equipment) and a block that did not change is shared with the version before it, so an edit
+// only costs the block it touched. When the blocks use more than historyBudget bytes, older versions are
+// spilled to roster/history/<xx>/<yy>/<id>.bin (sharded like the roster files) as fixed size records and read
+// back when they are needed.
+struct IdentityBlock {
+    int refs;                 // Versions sharing this block
+    char *className;
+    char *subClass;
+    char *background;
+    char *race;
+    char *alignment;
+};
+
+struct AbilityBlock {
+    int refs;                 // Versions sharing this block
+    unsigned char scores[6];  // Strength, Dexterity, Constitution, Intelligence, Wisdom, Charisma
+};
+
+struct EquipmentBlock {
+    int refs;                 // Versions sharing this block
+    struct Armor *armor;
+    struct Weapon *weapon;
+    int hasShield;
+};
+
+struct CharacterVersion {
+    int number;               // Position in the history (0 is the character before its first edit)
+    short level;
+    short HP;
+    short proficiency;
+    short speed;
+    struct IdentityBlock *identity;
+    struct AbilityBlock *abilities;
+    struct EquipmentBlock *equipment;
+};
+
+struct CharacterHistory {
+    int count;                // Versions recorded
+    int current;              // Version the character is at (moves back and forth with undo and redo)
+    int firstInMemory;        // Versions before this one have been spilled to disk
+    int capacity;             // Slots in versions
+    struct CharacterVersion **versions;  // versions[i] is version firstInMemory + i
+    char directory[64];       // Campaign the spill file belongs to (a parked campaign can be freed while another is current)
+};
+
+size_t historyBudget = 64 * 1024 * 1024;  // Most bytes of history kept in memory (--history-budget=<MB>)
+size_t historyBytes = 0;                  // Bytes of history currently in memory
+
+// Records the character as it is now as version 0, if it has no history yet
+void beginHistory(struct Character *character);
+// Records the character as it is now as a new version, returns 1 if anything changed since the current version
+int recordVersion(struct Character *character);
+// Calls beginHistory or recordVersion on every character in a batch across worker threads
+void beginHistories(struct Character **batch, int count);
+void recordVersions(struct Character **batch, int count);
+// Moves the character back or forward one version, returns 0 on success
+int undoVersion(struct Character *character);
+int redoVersion(struct Character *character);
+// Prints every version of the character, then shows one in full if asked
+void historyMenu(struct Character *character);
+// Spills older versions of every character to disk until the history fits in historyBudget
+void enforceHistoryBudget(struct Character *head);
+// Frees a character's history and removes its spill file
+void freeHistory(struct Character *character);
+
+// Random number functions
+// Simulations run on many threads at once, so each one rolls from its own seeded generator instead of rand()
+struct Rng {
+    unsigned long long state;
+};
+void rngSeed(struct Rng *rng, unsigned long long seed);
+unsigned long long rngNext(struct Rng *rng);
+// Rolls a number between 1 and sides with no modulo bias
+int rngRoll(struct Rng *rng, int sides);
+// Splits "2d6" style dice into count and sides, returns 0 on success
+int parseDice(const char *dice, int *count, int *sides);
+
+// Attack functions
+enum AdvantageState {
+    ROLL_NORMAL = 0,          // One D20
+    ROLL_ADVANTAGE,           // Two D20s, keep the higher
+    ROLL_DISADVANTAGE         // Two D20s, keep the lower
+};
+
+#define MAX_ATTACKS 4         // Most attacks one action can make (a level 20 Fighter)
+
+// Everything needed to resolve one attack action
+struct AttackAction {
+    int attacks;              // Number of attacks in the action (more than 1 with Extra Attack)
+    enum AdvantageState advantage;
+    int attackBonus;          // Bonus added to each attack roll
+    int critRange;            // Lowest natural roll that is a critical hit (20 for most attackers)
+    int damageCount;          // Number of damage dice (doubled on a critical hit)
+    int damageSides;          // Sides on each damage die
+    int damageBonus;          // Bonus added to each hit's damage
+    int targetAC;             // Armor Class to beat (0 = no target, anything but a natural 1 hits)
+};
+
+struct AttackRoll {
+    int natural;              // D20 result that was kept
+    int total;                // Natural roll + attack bonus
+    int hit;                  // 1 if the attack hit
+    int critical;             // 1 if the attack was a critical hit
+    int damage;               // Damage dealt (0 on a miss)
+};
+
+struct AttackResult {
+    int attacks;              // Number of attacks rolled
+    int hits;                 // Attacks that hit
+    int criticals;            // Attacks that were critical hits
+    int damage;               // Total damage from every hit
+    struct AttackRoll rolls[MAX_ATTACKS];
+};
+
+// Attacks per action for the character's class, subclass and level
+int attacksPerAction(struct Character *character);
+// Lowest natural roll that crits for the character (lower for a Champion)
+int criticalRange(struct Character *character);
+// Builds the attack action for a character's equipped weapon, returns 0 on success
+int buildAttackAction(struct Character *character, int targetAC, enum AdvantageState advantage, struct AttackAction *action);
+// Resolves every attack in an action, rolling from rng (NULL rolls the tracked dice through rollDie)
+void resolveAttackAction(const struct AttackAction *action, struct Rng *rng, struct AttackResult *result);
+// Resolves count actions across worker threads, action i rolls from a generator seeded with seed + i
+void resolveAttackActions(const struct AttackAction *actions, int count, unsigned long long seed, struct AttackResult *results);
+// Prompts for advantage and a target, then rolls and prints the character's attack action
+void makeAttackAction(struct Character *character);
+// Resolves many copies of a character's attack action and prints hit, crit and damage averages
+void attackActionStatistics(struct Character *character);
+
+// Damage matrix functions
+#define MATRIX_MIN_AC 10      // Lowest target Armor Class in the matrix
+#define MATRIX_COLUMNS 16     // Target Armor Classes 10 through 25
+#define MATRIX_LANES 8        // Characters per block, a fixed count so the inner loops compile to vector instructions
+
+// Eight characters' attack actions stored field by field, with their expected damage against every column
+struct DamageBlock {
+    float attacks[MATRIX_LANES];      // Attacks per action (0 for padding and characters without a usable weapon)
+    float attackBonus[MATRIX_LANES];
+    float critRange[MATRIX_LANES];
+    float criticals[MATRIX_LANES];    // Natural rolls out of 20 that crit (21 - critRange)
+    float hitDamage[MATRIX_LANES];    // Exact average damage of an ordinary hit
+    float critDamage[MATRIX_LANES];   // Exact average damage of a critical hit
+    float damage[MATRIX_COLUMNS][MATRIX_LANES];  // Expected damage per round against MATRIX_MIN_AC + column
+};
+
+struct DamageMatrix {
+    struct Character **characters;
+    int count;
+    int blockCount;
+    int *classIndex;          // Row of catalog->classes for each character (-1 if not found)
+    struct DamageBlock *blocks;
+};
+
+// Returns the exact average of max(1, bonus + count dice with the given sides), the damage of one hit
+double averageHitDamage(int count, int sides, int bonus);
+// Builds the attack actions for every character and works out their expected damage against every column
+void buildDamageMatrix(struct DamageMatrix *matrix, struct Character **characters, int count);
+// Writes one row per character to a CSV file, returns 0 on success
+int exportDamageMatrix(const struct DamageMatrix *matrix, const char *fileName);
+// Prompts for a filter, prints average expected damage by class and optionally exports every character's row
+void damageMatrixMenu(struct Character *head);
+
+// Encounter functions
+#define MAX_COMBATANTS 32     // Most characters and monsters in one encounter
+#define MAX_ROUNDS 100        // Encounters still going after this many rounds are counted as draws
+
+// One side of a fight, built from a character or a monster
+struct Combatant {
+    char name[25];            // Character or monster name
+    int team;                 // 0 = party, 1 = monsters
+    int initiative;           // Initiative roll for this encounter (D20 + DEX modifier)
+    int dexModifier;          // Dexterity modifier (breaks initiative ties)
+    int armorClass;           // Armor Class attacks must meet or beat
+    int maxHP;                // Hit points at the start of the encounter
+    int HP;                   // Hit points left
+    struct AttackAction action;  // Attack action taken each turn (targetAC is filled in per target)
+};
+
+struct Encounter {
+    struct Combatant combatants[MAX_COMBATANTS];
+    int count;
+};
+
+struct EncounterResult {
+    int winner;               // 0 = party, 1 = monsters, -1 = draw
+    int rounds;               // Rounds the encounter lasted
+};
+
+// Builds a combatant from a character's weapon, armor, attributes and HP
+void characterCombatant(struct Character *character, struct Combatant *combatant);
+// Builds a combatant from a monsters.txt entry
+void monsterCombatant(struct Monster *monster, struct Combatant *combatant);
+// Plays out one encounter on a copy of the combatants, printing each turn if verbose is set
+struct EncounterResult runEncounter(const struct Encounter *encounter, struct Rng *rng, int verbose);
+// Runs many independent copies of an encounter across worker threads and reports win rates and average rounds
+void simulateEncounters(const struct Encounter *encounter, int simulations, unsigned long long seed);
+// Prompts for a party and monsters, then runs one encounter turn by turn or simulates many
+void encounterMenu(struct Character *head);
+
+// Equipment optimizer functions
+enum LoadoutObjective {
+    OBJECTIVE_ARMOR_CLASS = 1, // Highest Armor Class
+    OBJECTIVE_DAMAGE,          // Highest expected damage per round
+    OBJECTIVE_WEIGHTED         // Weighted mix of Armor Class and expected damage
+};
+
+struct LoadoutGoal {
+    enum LoadoutObjective objective;
+    int targetAC;             // Armor Class of the target expected damage is measured against
+    double acWeight;          // Weight of one point of Armor Class (OBJECTIVE_WEIGHTED)
+    double damageWeight;      // Weight of one point of expected damage (OBJECTIVE_WEIGHTED)
+};
+
+struct Loadout {
+    int armor;                // Index into armors
+    int weapon;               // Index into weapons
+    int hasShield;            // 1 if the loadout carries a shield
+    int armorClass;           // Armor Class with this loadout
+    double expectedDamage;    // Expected damage per round against the goal's target AC
+    double score;             // Objective value the loadouts are ranked by
+};
+
+// Returns the ability modifier a character attacks with when using a weapon (best of STR/DEX for finesse)
+int weaponAbilityModifier(struct Character *character, struct Weapon *weapon);
+// Returns the expected damage of one Attack action against targetAC, counting misses, hits, critical hits and Extra Attacks
+double expectedWeaponDamage(struct Character *character, struct Weapon *weapon, int hasShield, int targetAC);
+// Finds the k best legal loadouts for a character, best first, and returns how many were found
+int optimizeLoadout(struct Character *character, const struct LoadoutGoal *goal, struct Loadout *best, int k);
+// Prompts for a goal and optimizes one character or every character in the roster
+void equipmentOptimizerMenu(struct Character *head);
+
+// Ability score functions
+enum AllocationMethod {
+    ALLOCATION_POINT_BUY = 1, // 27 points spent on scores from 8 to 15
+    ALLOCATION_STANDARD_ARRAY,// 15, 14, 13, 12, 10, 8 in any order
+    ALLOCATION_ROLLED         // One set of 4d6-drop-lowest rolls in any order
+};
+
+struct AbilityAllocation {
+    unsigned char scores[6];  // Strength, Dexterity, Constitution, Intelligence, Wisdom, Charisma
+    int armorClass;           // Armor Class with the chosen equipment
+    int HP;                   // Hit points at the chosen level
+    int attackBonus;          // Attack bonus with the chosen weapon
+    double expectedDamage;    // Expected damage per round against the target AC
+    double score;             // Weighted value the allocations are ranked by
+};
+
+struct AllocationWeights {
+    double armorClass;        // Weight of one point of AC
+    double HP;                // Weight of one hit point
+    double attackBonus;       // Weight of one point of attack bonus
+    double damage;            // Weight of one point of expected damage per round
+};
+
+// Lists every legal allocation for a method into a malloc'd array and returns how many there are
+int enumerateAllocations(enum AllocationMethod method, struct Rng *rng, struct AbilityAllocation **allocations);
+// Scores every allocation for a template character (class, level and equipment) and keeps the k best, best first
+int rankAllocations(struct Character *build, struct AbilityAllocation *allocations, int count, const struct AllocationWeights *weights, int targetAC, struct AbilityAllocation *best, int k);
+// Prompts for a method, class, level, equipment and focus, then shows the best allocations
+void abilityScorePlannerMenu(void);
+
+// Character generator functions
+int generateCount = 0;                 // Characters to generate at startup (--generate)
+unsigned long long generateSeed = 0;   // Seed for generated characters (--seed, 0 = random)
+// Fills in a random valid character from the catalogs, the same seed always gives the same character. The ID is
+// appended to the name so generated names never repeat ("#<n>" for memory-only characters, whose IDs are negative).
+void generateCharacter(struct Rng *rng, int id, struct Character *character);
+// Generates count characters across worker threads and adds them to the front of the list
+void generateCharacters(struct Character **head, int count, unsigned long long seed, int save);
+// Prompts for how many characters to generate, a seed and where they should go
+void characterGeneratorMenu(struct Character **head);
+
+// Packed roster functions
+// A packed character keeps every catalog choice as a one byte index into the catalog arrays and its
+// name as an offset into the roster's shared name arena, so it takes 28 bytes instead of a struct
+// Character plus its nested class and five heap strings. 10M generated characters measure 267 MB of records
+// and 185 MB of names, about 450 MB in all.
+#define PACKED_NONE 255       // Catalog index stored for "N/A" subclasses
+
+struct PackedCharacter {
+    unsigned int id;          // Character's ID
+    unsigned int nameOffset;  // Offset of the name in the roster's name arena
+    short HP;
+    unsigned char level;
+    unsigned char proficiency;
+    unsigned char speed;
+    unsigned char classId;    // Row of classes
+    unsigned char subClassId; // Column of classes (1-4), or PACKED_NONE
+    unsigned char backgroundId;
+    unsigned char raceId;
+    unsigned char alignmentId;
+    unsigned char armorId;    // Index into armors
+    unsigned char weaponId;   // Index into weapons
+    unsigned char scores[6];  // Strength, Dexterity, Constitution, Intelligence, Wisdom, Charisma
+    unsigned char hasShield;
+};
+
+struct PackedRoster {
+    struct PackedCharacter *characters;
+    int count;
+    int capacity;
+    char *names;              // Every name back to back, each ending in '\0'
+    size_t namesUsed;
+    size_t namesCapacity;
+};
+
+// Packs a character onto the end of the roster, returns -1 if it uses something that isn't in the catalogs
+int packCharacter(struct PackedRoster *roster, struct Character *character);
+// Unpacks a character into a struct Character with its own class and strings (free with freeUnpackedCharacter)
+void unpackCharacter(const struct PackedRoster *roster, const struct PackedCharacter *packed, struct Character *character);
+void freeUnpackedCharacter(struct Character *character);
+void freePackedRoster(struct PackedRoster *roster);
+// Saves and loads a packed roster file, both return 0 on success
+int savePackedRoster(const struct PackedRoster *roster, const char *fileName);
+int loadPackedRoster(struct PackedRoster *roster, const char *fileName);
+// Generates count characters straight into a packed roster file
+void generatePackedRoster(int count, unsigned long long seed, const char *fileName);
+// Packs, searches and imports roster.pack
+void packedRosterMenu(struct Character **head);
+
+// Columnar export functions
+// roster.cols holds the roster column by column for loading into dataframes. The file is self-describing:
+//   header   "DNDCOL01", u32 column count, then per column: u8 type, u8 name length, name, and for a
+//            dictionary column u16 entry count followed by u8 length + text for each entry
+//   batches  up to COLUMN_BATCH_ROWS rows each: u32 rows, u32 0, then per column u64 byte length + data
+//   footer   u64 offset of every batch, u64 batch count, u64 total rows, "DNDCOL01"
+// Sections start on 8 byte boundaries and numbers are little endian, so a column can be mapped straight into
+// an array. A string column is rows + 1 u32 offsets followed by the text, a dictionary column is one u8 code
+// per row (COLUMN_NULL when missing). Batches are encoded across worker threads and written in one pass.
+#define COLUMN_MAGIC "DNDCOL01"
+#define COLUMN_BATCH_ROWS 65536       // Rows encoded and written at a time
+#define COLUMN_NULL 255               // Dictionary code for a missing value
+
+enum ColumnType {
+    COLUMN_UINT8 = 1,
+    COLUMN_INT16,
+    COLUMN_INT32,
+    COLUMN_STRING,
+    COLUMN_DICTIONARY
+};
+
+// Writes the characters to a column file, returns 0 on success
+int exportRosterColumns(struct Character **characters, int count, const char *fileName);
+
 // Armor functions
 const char *armorRequirement(struct Armor *armor);
 const char *armorStealth(struct Armor *armor);
+struct Armor *findArmor(const char *armorName);
+int armorStrengthRequirement(struct Armor *armor);
 
 // Weapon functions
 const char *weaponFinesse(struct Weapon *weapon);
 const char *weaponVersatile(struct Weapon *weapon);
 const char *weaponRange(struct Weapon *weapon);
+struct Weapon *findWeapon(const char *weaponName);
 
 // Class functions
 void initializeHitDie(struct Character *character);
+struct ClassProgression *findClassProgression(const char *className);
+int subClassUnlockLevel(struct Character *character);
 
 // Selecting functions (adding updating character data)
-void selectName(struct Character *character);
+void selectName(struct Character *head, struct Character *character);
 int selectLevel(struct Character *character);
 void selectClass(struct Character *character);
 void selectSubClass(struct Character *character);
@@ -123,8 +775,6 @@ int calculateModifier(int attribute);
 int calculateArmorClass(int dexterity, const char *armorName, int hasShield); 
 // calculateRollModifier: Computes a D20 roll with a modifier based on character attributes.
 int calculateRollModifier(struct Character *head, char *diceCharacterName, int numChoice); 
-// calculateDamageDiceRoll: Calculates the damage roll based on weapon type.
-int calculateDamageDiceRoll(struct Weapon *weapon);
 // calculateDamageRoll: Calculates total damage, including modifiers and weapon effects.
 int calculateDamageRoll(struct Character *character, char *characterName);
 // calculateAttackRoll: Computes the attack roll, factoring in modifiers and weapon.
@@ -158,20 +808,252 @@ int rollD8(void);   // Rolls a D8
 int rollD6(void);   // Rolls a D6
 int rollD4(void);   // Rolls a D4
 
-int main(){
+// Roll statistics functions
+#define DIE_TYPES 6           // D4, D6, D8, D10, D12 and D20
+
+// Face counts for every die type. Mean, variance and chi-square are all worked out
+// from the counts, so recording a roll is just one increment.
+struct RollStats {
+    unsigned long long faces[DIE_TYPES][21];  // faces[die][face] = times that face came up
+};
+
+struct RollStats diceStats;              // Every roll made through rollD* this session
+struct Character *rollingCharacter;      // Character the current rolls belong to (NULL for none)
+struct Rng diceRng;                      // Generator behind rollD* (the dice menu only runs on the main thread)
+
+// Summary of one die's counts
+struct DieSummary {
+    int sides;                // Number of sides on the die
+    unsigned long long rolls; // Number of rolls
+    double mean;              // Average roll
+    double variance;          // Variance of the rolls
+    double chiSquare;         // Chi-square goodness-of-fit against a fair die
+    double criticalValue;     // Chi-square above this is flagged (p < 0.001)
+};
+
+// Rolls a die through diceRng and records the result
+int rollDie(int sides);
+// Adds one roll to the totals and to the rolling character's stats
+void recordRoll(int sides, int face);
+// Works out the mean, variance and chi-square of one die's counts
+void summarizeDie(const struct RollStats *stats, int die, struct DieSummary *summary);
+// Prints a table of every die that has been rolled
+void printRollStats(const struct RollStats *stats, const char *title);
+// Writes the session and per-character statistics to a CSV file, returns 0 on success
+int exportRollStats(struct Character *head, const char *fileName);
+// Rolls every die rolls / DIE_TYPES times across worker threads and flags any that look biased
+void diceSelfTest(int rolls);
+// Lets the user view, export or self-test the roll statistics
+void rollStatsMenu(struct Character *head);
+// Draws a seed for worker rolls, encounters, planners or generated characters from diceRng, recording the draw
+// in the audit log so any generator seeded from it can be replayed
+unsigned long long drawDiceSeed(void);
+
+// Audit log functions
+// With --audit=<file>, every draw from diceRng is logged so an organized-play table can be checked afterwards.
+// Records are appended to the current block of an in-memory ring, and a writer thread writes each block once it
+// fills (compressed with --audit-compress), so a roll costs a few stores. The file is:
+//   header   "DNDAUD02", u64 diceRng seed, i64 start time, u32 flags, u32 block size
+//   blocks   u32 raw length, u32 stored length (smaller when compressed), then the block's records
+// and every block holds whole records:
+//   name     u8 AUDIT_RECORD_NAME, u32 id, u8 length, text (the first time a character rolls)
+//   roll     u8 AUDIT_RECORD_ROLL, u8 function, u32 name id, u32 ms since start, i16 modifier, i16 result,
+//            u8 dice, then u8 sides + u8 face for each die
+//   draw     u8 AUDIT_RECORD_DRAW, u64 value taken straight from the generator
+// Numbers are little endian. --audit-read=<file> replays a log against its seed, optionally filtered with
+// --audit-character=<name> and --audit-function=<name>.
+#define AUDIT_MAGIC "DNDAUD02"
+#define AUDIT_BLOCK_SIZE 65536        // Bytes of records written at a time
+#define AUDIT_RING_BLOCKS 8           // Blocks the roller can fill before it waits on the writer
+#define AUDIT_MAX_DICE 64             // Dice in one roll record, longer rolls continue in the next record
+#define AUDIT_NO_NAME 0xFFFFFFFFu     // Name id of a roll with no character
+#define AUDIT_CONTINUED 0x80          // Set on the function of a record that carries on the previous roll
+#define AUDIT_COMPRESSED 1            // Header flag: blocks may be compressed
+
+enum AuditRecordType {
+    AUDIT_RECORD_NAME = 1,
+    AUDIT_RECORD_ROLL,
+    AUDIT_RECORD_DRAW
+};
+
+enum AuditFunction {
+    AUDIT_DIE = 1,                    // A die rolled outside any of the functions below
+    AUDIT_ROLL_D20,
+    AUDIT_ROLL_MODIFIER,
+    AUDIT_DAMAGE_ROLL,
+    AUDIT_ATTACK_ROLL,
+    AUDIT_ATTACK_ACTION,
+    AUDIT_FUNCTIONS
+};
+
+int auditing = 0;                     // Boolean indicating the audit log is being written
+int auditCompression = 0;             // Boolean indicating if --audit-compress was given
+char auditFileName[256];              // Log written with --audit
+char auditReadFileName[256];          // Log replayed with --audit-read
+char auditCharacterFilter[25];        // Only show rolls by this character when replaying
+char auditFunctionFilter[32];         // Only show rolls made by this function when replaying
+// Opens the audit log if --audit was given, recording the seed diceRng was given
+void startAuditLog(unsigned long long seed);
+// Starts a roll made by function for character. Rolls nest, so only the outermost one is recorded.
+void auditBegin(enum AuditFunction function, struct Character *character);
+// Adds one die to the roll in progress (or records it on its own)
+void auditDie(int sides, int face);
+// Finishes the roll in progress with the modifier it added and the result it returned
+void auditEnd(int modifier, int result);
+// Records a value drawn from diceRng without rolling a die
+void auditDraw(unsigned long long value);
+// Writes out the last block and closes the log
+void stopAuditLog(void);
+// Prints the log's rolls and checks every die against the seeded generator, returns 0 if they all match
+int readAuditLog(const char *fileName);
+
+// Parallel functions
+// parallelFor: Splits the range [0, count) across worker threads and runs work(begin, end, arg) on each slice.
+void parallelFor(int count, void (*work)(int begin, int end, void *arg), void *arg);
+// workerThreadCount: Returns how many worker threads to use (one per online CPU).
+int workerThreadCount(void);
+
+// Filter expression functions
+// Expressions such as  level >= 5 && class == "Rogue" && armor.type == "Light"  are compiled once into a short
+// program for a stack machine and then run against each character. Fields are character fields, derived attack
+// stats and the equipped armor's and weapon's catalog attributes; strings compare without regard to case.
+// A comparison between a field and a literal compiles to a single instruction.
+#define EXPRESSION_MAX_CODE 128       // Most instructions in one program
+#define EXPRESSION_MAX_STRINGS 256    // Bytes of string literals in one program
+#define EXPRESSION_STACK_SIZE 16      // Deepest the value stack may get
+
+enum ExpressionOp {
+    OP_PUSH_NUMBER,           // Push operand
+    OP_PUSH_STRING,           // Push the literal at strings + operand
+    OP_NUMBER_FIELD,          // Push number field `field`
+    OP_STRING_FIELD,          // Push string field `field`
+    OP_COMPARE_NUMBERS,       // Pop two numbers and push the result of `compare`
+    OP_COMPARE_STRINGS,       // Pop two strings and push the result of `compare`
+    OP_NUMBER_FIELD_COMPARE,  // Push number field `field` `compare` operand
+    OP_STRING_FIELD_COMPARE,  // Push string field `field` `compare` the literal at strings + operand
+    OP_NOT,                   // Replace the top value with 1 if it is 0, else 0
+    OP_JUMP_IF_FALSE,         // If the top value is 0 jump to operand, otherwise pop it (&&)
+    OP_JUMP_IF_TRUE           // If the top value is not 0 jump to operand, otherwise pop it (||)
+};
+
+enum ExpressionCompare {
+    COMPARE_EQUAL,
+    COMPARE_NOT_EQUAL,
+    COMPARE_LESS,
+    COMPARE_LESS_EQUAL,
+    COMPARE_GREATER,
+    COMPARE_GREATER_EQUAL
+};
+
+struct ExpressionInstruction {
+    unsigned char op;         // enum ExpressionOp
+    unsigned char compare;    // enum ExpressionCompare for the compare instructions
+    short field;              // Field index for the field instructions
+    int operand;
+};
+
+struct FilterExpression {
+    int length;               // Instructions in code (0 = no expression, every character matches)
+    struct ExpressionInstruction code[EXPRESSION_MAX_CODE];
+    char strings[EXPRESSION_MAX_STRINGS];
+    int stringsUsed;
+    char source[256];         // Expression as typed
+};
+
+// Compiles source into expression, returns 0 on success or -1 with the reason in message
+int compileFilterExpression(const char *source, struct FilterExpression *expression, char *message, size_t messageSize);
+// Runs a compiled expression against a loaded character, returns 1 if it matches
+int evaluateFilterExpression(const struct FilterExpression *expression, struct Character *character);
+// Prompts until the user types a valid expression or leaves it blank (no expression)
+void readFilterExpression(struct FilterExpression *expression);
+// Prints every field an expression can use
+void printFilterFields(void);
+// Compiles and runs a table of expressions against a scratch character, returns the number that went wrong
+int checkFilterExpressions(void);
+
+// Bulk functions
+struct CharacterFilter {
+    char className[50];       // Only match characters of this class ("" matches every class)
+    char race[50];            // Only match characters of this race ("" matches every race)
+    int minLevel;             // Lowest level to match
+    int maxLevel;             // Highest level to match
+    struct FilterExpression expression;  // Only match characters the expression accepts (length 0 matches everyone)
+};
+
+// Subclass policies used when a bulk level up reaches the subclass level
+enum SubClassPolicy {
+    SUBCLASS_LEAVE_UNSET = 1, // Keep "N/A" so the subclass can be chosen later
+    SUBCLASS_FIRST_OPTION,    // Assign the first subclass listed for the class
+    SUBCLASS_PROMPT           // Ask the user for each character after the bulk level up
+};
+
+// Fields that can be changed with a bulk update
+enum BulkField {
+    BULK_FIELD_LEVEL = 1,
+    BULK_FIELD_BACKGROUND,
+    BULK_FIELD_RACE,
+    BULK_FIELD_ALIGNMENT,
+    BULK_FIELD_ATTRIBUTE,
+    BULK_FIELD_WEAPON,
+    BULK_FIELD_SHIELD
+};
 
+// Prompts the user to build a filter (class, race, level range and expression) for bulk operations
+void selectCharacterFilter(struct CharacterFilter *filter);
+// Returns 1 if the character matches every part of the filter
+int characterMatchesFilter(struct Character *character, struct CharacterFilter *filter);
+// Returns a malloc'd array of every character in the list matching the filter
+struct Character **collectMatchingCharacters(struct Character *head, struct CharacterFilter *filter, int *count);
+char startupQuery[256];       // Expression given with --query ("" for none)
+int checkingExpressions = 0;   // Boolean indicating if --check-expressions was given
+// Prompts for an expression and lists every character it matches
+void queryCharactersMenu(struct Character *head);
+// Lists the characters matching an expression, used by --query at startup
+void queryCharacters(struct Character *head, const char *source);
+// Levels up every matching character in parallel and saves them with one batched write
+void bulkLevelUpCharacters(struct Character *head);
+// Applies one field update to every matching character in parallel and saves them with one batched write
+void bulkUpdateCharacters(struct Character *head);
+// Writes every character in the batch to its file in a single pass
+void writeCharactersToFiles(struct Character **batch, int count);
+
+int main(int argc, char *argv[]){
+
+    parseCommandLine(argc, argv);
+    if (auditReadFileName[0] != '\0') {
+        return readAuditLog(auditReadFileName);
+    }
+    if (checkingExpressions) {
+        return checkFilterExpressions() == 0 ? 0 : 1;
+    }
+    startTracing();
     initializeGlobalArrays();
+    startCatalogWatcher();
+    startPersistence();
 
     srand(time(NULL));          // Seeds a random number
+    unsigned long long diceSeed = (unsigned long long)time(NULL) ^ ((unsigned long long)getpid() << 32);
+    rngSeed(&diceRng, diceSeed);
+    startAuditLog(diceSeed);
 
     char userCharacter[25];     // Users character name input
     int userChoice;             // Users choice input
     struct Character *characterList = NULL;
-    loadCharactersFromFile(&characterList);
+    openInitialCampaign(&characterList);
+    if (generateCount > 0) {
+        generateCharacters(&characterList, generateCount, generateSeed ? generateSeed : drawDiceSeed(), 0);
+    }
+    if (startupQuery[0] != '\0') {
+        queryCharacters(characterList, startupQuery);
+    }
 
     printf("\nWelcome to the DnD Character Creator!\n\n");
 
     do{
+        refreshCatalog(characterList);
+        enforceMemoryBudget(characterList);
+        enforceHistoryBudget(characterList);
+
         // Display menu options
         printf("1. Add a new character\n");
         printf("2. Level up a character\n");
@@ -180,7 +1062,8 @@ int main(){
         printf("5. Update a character\n");
         printf("6. Delete a character\n");
         printf("7. Dice rolling menu\n");
-        printf("8. Exit DnD Character Creator\n");
+        printf("8. Campaign tools menu\n");
+        printf("9. Exit DnD Character Creator\n");
         printf("Enter your choice: ");
         scanf("%d", &userChoice); //user's choice
 
@@ -213,9 +1096,11 @@ int main(){
                     printf("\nDice Rolling Menu\n");
                     printf("1. Roll a D20\n");
                     printf("2. Roll a D20 with modifiers\n");
-                    printf("3. Make an attack role with currently equipped weapon\n");
+                    printf("3. Make an attack action with currently equipped weapon\n");
                     printf("4. Roll for damage with currently equipped weapon\n");
-                    printf("5. Exit dice rolling menu\n");
+                    printf("5. Attack action statistics\n");
+                    printf("6. Roll statistics\n");
+                    printf("7. Exit dice rolling menu\n");
                     printf("Enter your choice: ");
                     scanf("%d", &userChoice);
 
@@ -235,47 +1120,133 @@ int main(){
                             printf("7. None\n");
                             printf("Enter your choice: ");
                             scanf("%d", &userChoice);
-                            printf("You rolled: %d\n\n", calculateRollModifier(characterList, userCharacter, userChoice));
+                            rollingCharacter = findCharacter(characterList, userCharacter);
+                            printf("You rolled: %d\n\n", calculateRollModifier(rollingCharacter, userCharacter, userChoice));
+                            rollingCharacter = NULL;
                             break;
                         case 3:
                             getCharacterName(userCharacter, "Enter the name of your character you would like to attack with: ");
-                            printf("You rolled: %d\n\n", calculateAttackRoll(characterList, userCharacter));
+                            rollingCharacter = findCharacter(characterList, userCharacter);
+                            if (rollingCharacter == NULL) {
+                                printf("Error: Character not found...\n\n");
+                            }
+                            else {
+                                makeAttackAction(rollingCharacter);
+                            }
+                            rollingCharacter = NULL;
                             break;
                         case 4:
                             getCharacterName(userCharacter, "Enter the name of your character you would like roll for damage with: ");
-                            printf("You rolled: %d\n\n", calculateDamageRoll(characterList, userCharacter));
+                            rollingCharacter = findCharacter(characterList, userCharacter);
+                            printf("You rolled: %d\n\n", calculateDamageRoll(rollingCharacter, userCharacter));
+                            rollingCharacter = NULL;
                             break;
                         case 5:
+                            getCharacterName(userCharacter, "Enter the name of your character: ");
+                            if (findCharacter(characterList, userCharacter) == NULL) {
+                                printf("Error: Character not found...\n\n");
+                            }
+                            else {
+                                attackActionStatistics(findCharacter(characterList, userCharacter));
+                            }
+                            break;
+                        case 6:
+                            rollStatsMenu(characterList);
+                            break;
+                        case 7:
                             break;
                         default:
                             printf("\nInvalid choice, please try again...\n\n");
                             break;
                     }
-                } while(userChoice != 5);
+                } while(userChoice != 7);
                 break;
             case 8:
+                do {
+                    printf("\nCampaign Tools Menu\n");
+                    printf("1. Bulk level up characters\n");
+                    printf("2. Bulk update characters\n");
+                    printf("3. Encounter simulator\n");
+                    printf("4. Equipment optimizer\n");
+                    printf("5. Ability score planner\n");
+                    printf("6. Random character generator\n");
+                    printf("7. Packed roster tools\n");
+                    printf("8. Switch campaign\n");
+                    printf("9. Expected damage matrix\n");
+                    printf("10. Query characters\n");
+                    printf("11. Memory usage\n");
+                    printf("12. Exit campaign tools menu\n");
+                    printf("Enter your choice: ");
+                    scanf("%d", &userChoice);
+
+                    switch (userChoice) {
+                        case 1:
+                            bulkLevelUpCharacters(characterList);
+                            break;
+                        case 2:
+                            bulkUpdateCharacters(characterList);
+                            break;
+                        case 3:
+                            encounterMenu(characterList);
+                            break;
+                        case 4:
+                            equipmentOptimizerMenu(characterList);
+                            break;
+                        case 5:
+                            abilityScorePlannerMenu();
+                            break;
+                        case 6:
+                            characterGeneratorMenu(&characterList);
+                            break;
+                        case 7:
+                            packedRosterMenu(&characterList);
+                            break;
+                        case 8:
+                            campaignMenu(&characterList);
+                            break;
+                        case 9:
+                            damageMatrixMenu(characterList);
+                            break;
+                        case 10:
+                            queryCharactersMenu(characterList);
+                            break;
+                        case 11:
+                            printMemoryUsage();
+                            break;
+                        case 12:
+                            break;
+                        default:
+                            printf("\nInvalid choice, please try again...\n\n");
+                            break;
+                    }
+                } while(userChoice != 12);
+                break;
+            case 9:
                 printf("Exiting DnD Character Creator...\n");
                 break;
             default:
                 printf("\nInvalid choice, please try again...\n\n");
                 break;
         }
-    } while(userChoice != 8);
+    } while(userChoice != 9);
+
+    stopPersistence();
+    stopAuditLog();
+    closeCampaigns();
 
     struct Character *temp;
         while (characterList != NULL) {
             temp = characterList;
             characterList = characterList->next;
-            free(temp);
+            freeCharacter(temp);
         }
 
-    freeArmors();
-    freeWeapons();
-    free2DArray(attributes, 6);
-    free2DArray(alignments, 9);
-    free2DArray(races, 10);
-    free2DArray(backgrounds, 16);
-    void freeClasses();
+    // Releasing the last epochs frees the catalogs, classes included
+    stopCatalogWatcher();
+    stopTracing();
+    releaseCatalog(catalog);
+    releaseCatalog(latestCatalog);
+    reportLeaks();
     return 0;
 }
 
@@ -321,8 +1292,9 @@ void getCharacterName(char *name, const char *prompt) {
 }
 
 // File Loading Functions
-// Loads armor from the armors file and loads them into an array of armor structs
-void loadArmors(const char *filename) {
+// Loads armor from the armors file into the catalog's array of armor structs, returning how many were loaded
+int loadArmors(struct Catalog *catalog, const char *filename) {
+    TRACE_SPAN("loadArmors", "catalog");
 
     char buffer[256];
     int count = 0;
@@ -330,7 +1302,7 @@ void loadArmors(const char *filename) {
     FILE *file = fopen(filename, "r");
     if (file == NULL) {
         perror("Error opening file");
-        return;
+        return 0;
     }
 
     while (fgets(buffer, sizeof(buffer), file) != NULL && count < 13) {
@@ -345,28 +1317,28 @@ void loadArmors(const char *filename) {
         if (sscanf(buffer, "%255[^,],%255[^,],%d,%d,%d,%d", tempName, tempType, &baseAC, &dexBonus, &requiresDexCap, &stealthDisadvantage) != 6) {
             fprintf(stderr, "Error parsing line: %s\n", buffer);
             fclose(file);
-            return;
+            return count;
         }
 
         // Allocate memory for the name and type fields
-        armors[count].name = malloc(strlen(tempName) + 1);
-        armors[count].type = malloc(strlen(tempType) + 1);
+        catalog->armors[count].name = trackedMalloc(strlen(tempName) + 1, MEMORY_CATALOG);
+        catalog->armors[count].type = trackedMalloc(strlen(tempType) + 1, MEMORY_CATALOG);
 
-        if (armors[count].name == NULL || armors[count].type == NULL) {
+        if (catalog->armors[count].name == NULL || catalog->armors[count].type == NULL) {
             fprintf(stderr, "Memory allocation error\n");
             fclose(file);
-            return;
+            return count;
         }
 
         // Copy the parsed strings into the dynamically allocated memory
-        strcpy(armors[count].name, tempName);
-        strcpy(armors[count].type, tempType);
+        strcpy(catalog->armors[count].name, tempName);
+        strcpy(catalog->armors[count].type, tempType);
 
         // Populate the remaining fields
-        armors[count].baseAC = baseAC;
-        armors[count].maxDexBonus = dexBonus;
-        armors[count].requiresDexCap = requiresDexCap;
-        armors[count].stealthDisadvantage = stealthDisadvantage;
+        catalog->armors[count].baseAC = baseAC;
+        catalog->armors[count].maxDexBonus = dexBonus;
+        catalog->armors[count].requiresDexCap = requiresDexCap;
+        catalog->armors[count].stealthDisadvantage = stealthDisadvantage;
 
         count++;
     }
@@ -376,20 +1348,22 @@ void loadArmors(const char *filename) {
     if (count != 13) {
         fprintf(stderr, "Error: Expected %d armors, but loaded %d.\n", 13, count);
     }
+    return count;
 }
 
-void freeArmors(void) {
+void freeArmors(struct Catalog *catalog) {
     for (int i = 0; i < 13; i++) {
-        free(armors[i].name);
-        free(armors[i].type);
+        trackedFree(catalog->armors[i].name, MEMORY_CATALOG);
+        trackedFree(catalog->armors[i].type, MEMORY_CATALOG);
     }
 }
 
-void loadWeapons(const char *filename) {
+int loadWeapons(struct Catalog *catalog, const char *filename) {
+    TRACE_SPAN("loadWeapons", "catalog");
     FILE *file = fopen(filename, "r");
     if (file == NULL) {
         perror("Error opening file");
-        return;
+        return 0;
     }
 
     char buffer[512];
@@ -411,34 +1385,34 @@ void loadWeapons(const char *filename) {
         }
 
         // Allocate memory for name, type, damageType, damage, and range
-        weapons[count].name = malloc(strlen(tempName) + 1);
-        weapons[count].type = malloc(strlen(tempType) + 1);
-        weapons[count].damageType = malloc(strlen(tempDamageType) + 1);
-        weapons[count].damageDice = malloc(strlen(tempDamageDice) + 1);
-        weapons[count].twoHandDamage = malloc(strlen(tempTwoHandedDamage) + 1);
+        catalog->weapons[count].name = trackedMalloc(strlen(tempName) + 1, MEMORY_CATALOG);
+        catalog->weapons[count].type = trackedMalloc(strlen(tempType) + 1, MEMORY_CATALOG);
+        catalog->weapons[count].damageType = trackedMalloc(strlen(tempDamageType) + 1, MEMORY_CATALOG);
+        catalog->weapons[count].damageDice = trackedMalloc(strlen(tempDamageDice) + 1, MEMORY_CATALOG);
+        catalog->weapons[count].twoHandDamage = trackedMalloc(strlen(tempTwoHandedDamage) + 1, MEMORY_CATALOG);
 
-        if (weapons[count].name == NULL || weapons[count].type == NULL || weapons[count].damageType == NULL || weapons[count].damageDice == NULL || weapons[count].twoHandDamage == NULL) {
+        if (catalog->weapons[count].name == NULL || catalog->weapons[count].type == NULL || catalog->weapons[count].damageType == NULL || catalog->weapons[count].damageDice == NULL || catalog->weapons[count].twoHandDamage == NULL) {
             fprintf(stderr, "Memory allocation error\n");
             fclose(file);
-            return;
+            return count;
         }
 
         // Copy the parsed strings into the dynamically allocated memory
-        strcpy(weapons[count].name, tempName);
-        strcpy(weapons[count].type, tempType);
-        strcpy(weapons[count].damageType, tempDamageType);
-        strcpy(weapons[count].damageDice, tempDamageDice);
-        strcpy(weapons[count].twoHandDamage, tempTwoHandedDamage);
+        strcpy(catalog->weapons[count].name, tempName);
+        strcpy(catalog->weapons[count].type, tempType);
+        strcpy(catalog->weapons[count].damageType, tempDamageType);
+        strcpy(catalog->weapons[count].damageDice, tempDamageDice);
+        strcpy(catalog->weapons[count].twoHandDamage, tempTwoHandedDamage);
 
         // Populate the remaining fields
-        weapons[count].isFinesse = tempIsFinesse;
-        weapons[count].isVersatile = tempIsVersatile;
-        weapons[count].isTwoHanded = tempIsTwoHanded;
-        weapons[count].range[0] = range1;
-        weapons[count].range[1] = range2;
-        weapons[count].isLight = tempIsLight;
-        weapons[count].isHeavy = tempIsHeavy;
-        weapons[count].isReach = tempIsReach;
+        catalog->weapons[count].isFinesse = tempIsFinesse;
+        catalog->weapons[count].isVersatile = tempIsVersatile;
+        catalog->weapons[count].isTwoHanded = tempIsTwoHanded;
+        catalog->weapons[count].range[0] = range1;
+        catalog->weapons[count].range[1] = range2;
+        catalog->weapons[count].isLight = tempIsLight;
+        catalog->weapons[count].isHeavy = tempIsHeavy;
+        catalog->weapons[count].isReach = tempIsReach;
 
         count++;
     }
@@ -448,26 +1422,28 @@ void loadWeapons(const char *filename) {
     if (count != 31) {
         fprintf(stderr, "Error: Expected %d weapons, but loaded %d.\n", 31, count);
     }
+    return count;
 }
 
-void freeWeapons(void) {
+void freeWeapons(struct Catalog *catalog) {
     for (int i = 0; i < 31; i++) {
-        free(weapons[i].name);
-        free(weapons[i].type);
-        free(weapons[i].damageType);
-        free(weapons[i].damageDice);
-        free(weapons[i].twoHandDamage);
+        trackedFree(catalog->weapons[i].name, MEMORY_CATALOG);
+        trackedFree(catalog->weapons[i].type, MEMORY_CATALOG);
+        trackedFree(catalog->weapons[i].damageType, MEMORY_CATALOG);
+        trackedFree(catalog->weapons[i].damageDice, MEMORY_CATALOG);
+        trackedFree(catalog->weapons[i].twoHandDamage, MEMORY_CATALOG);
     }
 }
 
-void loadFilesTo2DArray(const char *filename, char **array, int i) {
+int loadFilesTo2DArray(const char *filename, char **array, int i) {
+    TRACE_SPAN("loadFilesTo2DArray", "catalog");
     char buffer[256];
     int count = 0;
 
     FILE *file = fopen(filename, "r");
     if (file == NULL) {
         perror("Error opening file");
-        return;
+        return 0;
     }
 
     while (fgets(buffer, sizeof(buffer), file) != NULL && count < i) {
@@ -475,11 +1451,11 @@ void loadFilesTo2DArray(const char *filename, char **array, int i) {
         buffer[strcspn(buffer, "\n")] = '\0';
 
         // Allocate memory for the string and copy it
-        array[count] = malloc(strlen(buffer) + 1);
+        array[count] = trackedMalloc(strlen(buffer) + 1, MEMORY_CATALOG);
         if (array[count] == NULL) {
             fprintf(stderr, "Memory allocation error\n");
             fclose(file);
-            return;
+            return count;
         }
         strcpy(array[count], buffer);
 
@@ -491,25 +1467,29 @@ void loadFilesTo2DArray(const char *filename, char **array, int i) {
     if (count != i) {
         fprintf(stderr, "Warning: Expected %d items, but loaded %d from %s.\n", i, count, filename);
     }
+    return count;
 }
 
 void free2DArray(char **array, int size) {
     for (int i = 0; i < size; i++) {
         if (array[i] != NULL) {
-            free(array[i]);
+            trackedFree(array[i], MEMORY_CATALOG);
         }
     }
 }
 
-void loadClassesFromFile(const char *filename) {
+// Loads classes.txt into the catalog, returning how many classes had a name and all four subclasses
+int loadClassesFromFile(struct Catalog *catalog, const char *filename) {
+    TRACE_SPAN("loadClassesFromFile", "catalog");
     FILE *file = fopen(filename, "r");
     if (file == NULL) {
         perror("Error opening file");
-        exit(1);
+        return 0;
     }
 
     char line[256];
     int class = 0;
+    int complete = 0;
 
     while (fgets(line, sizeof(line), file) != NULL && class < 12) {
         line[strcspn(line, "\n")] = '\0';  // Remove trailing newline if present
@@ -518,8 +1498,8 @@ void loadClassesFromFile(const char *filename) {
         int subclass = 0;
 
         while (token != NULL && subclass < 5) {
-            classes[class][subclass] = strdup(token);  // Allocate memory and copy the string
-            if (classes[class][subclass] == NULL) {
+            catalog->classes[class][subclass] = trackedStrdup(token, MEMORY_CATALOG);  // Allocate memory and copy the string
+            if (catalog->classes[class][subclass] == NULL) {
                 printf("Memory allocation failed for classes[%d][%d]\n", class, subclass);
                 fclose(file);
                 exit(1);
@@ -527,1159 +1507,8562 @@ void loadClassesFromFile(const char *filename) {
             token = strtok(NULL, ",");
             subclass++;
         }
+        if (subclass == 5) {
+            complete++;
+        }
 
         class++;
     }
 
     fclose(file);
+    return complete;
 }
 
-void freeClasses(void) {
+void freeClasses(struct Catalog *catalog) {
     for (int i = 0; i < 12; i++) {
         for (int j = 0; j < 5; j++) {
-            free(classes[i][j]);  // Free allocated memory
+            trackedFree(catalog->classes[i][j], MEMORY_CATALOG);  // Free allocated memory
+        }
+    }
+}
+
+static int compareIds(const void *a, const void *b) {
+    int first = *(const int *)a, second = *(const int *)b;
+    return (first > second) - (first < second);
+}
+
+// One index entry being loaded by the parallel loader
+struct CharacterLoad {
+    const char *fileName;         // Roster file (or legacy file) to read
+    struct Character *character;  // Filled in by the worker, NULL for deleted entries
+    int read;                     // 1 if the file has to be read (0 when --lazy only needs the name)
+    int status;                   // Result of loadCharacterRecord
+    char *message;                // Error or warning to print once the characters are merged, or NULL
+};
+
+static void characterLoadWorker(int begin, int end, void *arg) {
+    struct CharacterLoad *loads = arg;
+    char message[200];
+
+    for (int e = begin; e < end; e++) {
+        if (!loads[e].read) {
+            continue;
+        }
+        message[0] = '\0';
+        loads[e].status = loadCharacterRecord(loads[e].fileName, loads[e].character, message, sizeof(message));
+        if (message[0] != '\0') {
+            loads[e].message = trackedStrdup(message, MEMORY_WORK);
         }
     }
 }
 
-// Function to load students from existing .txt files into the student list
+// Function to load characters listed in index.txt into the character list
 void loadCharactersFromFile(struct Character **character) {
-    FILE *index = fopen("index.txt", "r");
+    TRACE_SPAN("loadCharactersFromFile", "roster");
+    char indexPath[100];
+    campaignFilePath("index.txt", indexPath, sizeof(indexPath));
+    FILE *index = fopen(indexPath, "r");
     if (index == NULL) {
         printf("Index file not found. No characters to load.\n\n");
         return;
     }
 
-    char fileName[100];
-    while (fgets(fileName, sizeof(fileName), index) != NULL) {
+    // Read every index entry first so legacy "<FirstName>.txt" entries get IDs past the highest existing one
+    int entryCount = 0, entryCapacity = 64, legacyCount = 0;
+    int tombstoneCount = 0, tombstoneCapacity = 64;
+    int *tombstones = trackedMalloc(tombstoneCapacity * sizeof(int), MEMORY_IO);
+    struct IndexEntry {
+        int id;                // 0 for legacy entries that still need an ID
+        char name[25];         // Character name from the index
+        char fileName[100];    // Legacy file name, or the roster path for the ID
+    } *entries = trackedMalloc(entryCapacity * sizeof(struct IndexEntry), MEMORY_IO);
+    if (entries == NULL || tombstones == NULL) {
+        printf("Memory allocation failed.\n");
+        exit(1);
+    }
+
+    char line[100];
+    setvbuf(index, NULL, _IOFBF, 1 << 20);
+    while (fgets(line, sizeof(line), index) != NULL) {
         // Remove trailing newline character
-        fileName[strcspn(fileName, "\n")] = '\0';
+        line[strcspn(line, "\n")] = '\0';
+        if (line[0] == '\0') {
+            continue;
+        }
 
-        // Open each file and read character data
-        FILE *characterFile = fopen(fileName, "r");
-        if (characterFile == NULL) {
-            printf("Could not open file: %s\n", fileName);
+        // "-<id>" tombstones delete an earlier entry
+        int tombstone;
+        if (line[0] == '-' && sscanf(line + 1, "%d", &tombstone) == 1) {
+            if (tombstoneCount == tombstoneCapacity) {
+                tombstoneCapacity *= 2;
+                int *grown = trackedRealloc(tombstones, tombstoneCapacity * sizeof(int), MEMORY_IO);
+                if (grown == NULL) {
+                    printf("Memory allocation failed.\n");
+                    exit(1);
+                }
+                tombstones = grown;
+            }
+            tombstones[tombstoneCount++] = tombstone;
             continue;
         }
 
-        struct Character *newCharacter = malloc(sizeof(struct Character));
-        if (newCharacter == NULL) {
+        if (entryCount == entryCapacity) {
+            entryCapacity *= 2;
+            struct IndexEntry *grown = trackedRealloc(entries, entryCapacity * sizeof(struct IndexEntry), MEMORY_IO);
+            if (grown == NULL) {
+                printf("Memory allocation failed.\n");
+                exit(1);
+            }
+            entries = grown;
+        }
+
+        struct IndexEntry *entry = &entries[entryCount++];
+        if (sscanf(line, "%d,%24[^\n]", &entry->id, entry->name) == 2 && entry->id > 0) {
+            characterFilePath(entry->id, entry->fileName, sizeof(entry->fileName));
+            if (entry->id >= nextCharacterId) {
+                nextCharacterId = entry->id + 1;
+            }
+        }
+        else {
+            entry->id = 0;
+            campaignFilePath(line, entry->fileName, sizeof(entry->fileName));
+            legacyCount++;
+        }
+    }
+    fclose(index);
+    indexEntryLines = entryCount;
+    indexTombstoneLines = tombstoneCount;
+    qsort(tombstones, tombstoneCount, sizeof(int), compareIds);
+
+    // Decide what each entry needs before any file is read
+    int deletedCount = 0;
+    struct CharacterLoad *loads = trackedCalloc(entryCount > 0 ? entryCount : 1, sizeof(struct CharacterLoad), MEMORY_WORK);
+    if (loads == NULL) {
+        printf("Memory allocation failed.\n");
+        exit(1);
+    }
+    for (int e = 0; e < entryCount; e++) {
+        if (entries[e].id > 0 && bsearch(&entries[e].id, tombstones, tombstoneCount, sizeof(int), compareIds) != NULL) {
+            deletedCount++;
+            continue;
+        }
+
+        loads[e].character = trackedCalloc(1, sizeof(struct Character), MEMORY_ROSTER);
+        if (loads[e].character == NULL) {
             printf("Memory allocation failed.\n");
-            fclose(characterFile);
             exit(1);
         }
+        loads[e].fileName = entries[e].fileName;
+
+        // Lazy loading only needs the name from the index, legacy entries are read now so they can be moved
+        if (lazyLoading && entries[e].id != 0) {
+            snprintf(loads[e].character->name, sizeof(loads[e].character->name), "%s", entries[e].name);
+        }
+        else {
+            loads[e].read = 1;
+        }
+    }
+
+    // Read the roster files in parallel, then link the characters in index order with any errors in that order too
+    parallelFor(entryCount, characterLoadWorker, loads);
+    for (int e = 0; e < entryCount; e++) {
+        struct Character *newCharacter = loads[e].character;
+        if (newCharacter == NULL) {
+            continue;
+        }
+        if (loads[e].message != NULL) {
+            printf("%s\n", loads[e].message);
+            trackedFree(loads[e].message, MEMORY_WORK);
+        }
+        if (loads[e].status != 0) {
+            trackedFree(newCharacter, MEMORY_ROSTER);
+            loads[e].character = NULL;
+            continue;
+        }
+        if (loads[e].read) {
+            loadedCharacterCount++;
+        }
+
+        // Legacy characters get a new ID and move into the roster directory
+        newCharacter->id = entries[e].id;
+        if (newCharacter->id == 0) {
+            newCharacter->id = nextCharacterId++;
+            saveCharacter(newCharacter);
+        }
 
-        // Allocate memory for nested structs
-        newCharacter->class = malloc(sizeof(struct Class));
-        newCharacter->armor = malloc(sizeof(struct Armor));
-        newCharacter->weapon = malloc(sizeof(struct Weapon));
+        // Add the character to the linked list
+        newCharacter->next = *character;
+        *character = newCharacter;
+    }
 
-        if (!newCharacter->class || !newCharacter->armor || !newCharacter->weapon) {
-            printf("Memory allocation failed for nested structs.\n");
-            fclose(characterFile);
-            free(newCharacter);
+    // Replace the legacy file names in the index with ID entries once their roster files are committed
+    if (legacyCount > 0) {
+        char **legacyLines = trackedMalloc(legacyCount * sizeof(char *), MEMORY_IO);
+        if (legacyLines == NULL) {
+            printf("Memory allocation failed.\n");
             exit(1);
         }
+        if (flushPendingWrites() != 0) {
+            printf("Some characters could not be moved into the %s directory and stay where they are.\n", ROSTER_DIRECTORY);
+        }
+
+        // A legacy file only goes once its character's roster file is on disk, everything else keeps its old line
+        int movedCount = 0, keptCount = 0;
+        size_t prefix = strlen(campaignDirectory);
+        for (int e = 0; e < entryCount; e++) {
+            if (entries[e].id != 0) {
+                continue;
+            }
+            struct Character *moved = loads[e].character;
+            char path[100];
+            struct stat info;
+            if (moved != NULL) {
+                characterFilePath(moved->id, path, sizeof(path));
+                if (stat(path, &info) == 0) {
+                    movedCount++;
+                    continue;
+                }
+
+                // Not on disk, so leave the character for the next start to move again
+                struct Character **link = character;
+                while (*link != moved) {
+                    link = &(*link)->next;
+                }
+                *link = moved->next;
+                if (loads[e].read) {
+                    loadedCharacterCount--;
+                }
+                freeCharacter(moved);
+                loads[e].character = NULL;
+            }
+            legacyLines[keptCount++] = entries[e].fileName + prefix;
+        }
+
+        if (rewriteIndex(*character, legacyLines, keptCount) == 0) {
+            for (int e = 0; e < entryCount; e++) {
+                if (entries[e].id == 0 && loads[e].character != NULL) {
+                    remove(entries[e].fileName);
+                }
+            }
+            printf("Moved %d character(s) into the %s directory.\n", movedCount, ROSTER_DIRECTORY);
+        }
+        trackedFree(legacyLines, MEMORY_IO);
+    }
+    else if (indexTombstoneLines > 0 && indexTombstoneLines >= INDEX_COMPACTION_RATIO * (indexEntryLines + indexTombstoneLines)) {
+        compactIndex();
+    }
 
-        char className[50], subClass[50], armorName[50], weaponName[50], background[50], race[50], alignment[50];
+    trackedFree(loads, MEMORY_WORK);
+    trackedFree(entries, MEMORY_IO);
+    trackedFree(tombstones, MEMORY_IO);
+    if (lazyLoading) {
+        printf("Indexed %d character(s), they will be loaded when first used.\n", entryCount - deletedCount);
+    }
+    else {
+        printf("Characters loaded successfully from files.\n");
+    }
+}
 
-        // Read the character data from the file
-        fscanf(characterFile, "Name: %[^\n]\n" "Level: %d\n" "Class: %[^\n]\n" "Subclass: %[^\n]\n" "Background: %[^\n]\n" "Race: %[^\n]\n"
-               "Alignment: %[^\n]\n" "HP: %d\n" "Speed: %d\n" "Proficiency Modifier: %d\n" "Strength: %d\n" "Dexterity: %d\n" "Constitution: %d\n"
-               "Intelligence: %d\n" "Wisdom: %d\n" "Charisma: %d\n" "Armor: %[^\n]\n" "Weapon: %[^\n]\n" "Shield: %d\n",
-               newCharacter->name, &newCharacter->level, className, subClass, background, race, alignment, &newCharacter->HP,
-               &newCharacter->speed, &newCharacter->proficiencyModifier, &newCharacter->strength, &newCharacter->dexterity, &newCharacter->constitution, 
-               &newCharacter->intelligence, &newCharacter->wisdom, &newCharacter->charisma, armorName, weaponName, &newCharacter->hasShield);
+// Fields of a character file as written by printCharacterRecord, one "Key: value" per line in this order
+struct CharacterRecord {
+    char name[25];
+    int level;
+    char className[50];
+    char subClass[50];
+    char background[50];
+    char race[50];
+    char alignment[50];
+    int HP;
+    int speed;
+    int proficiency;
+    int scores[6];
+    char armor[50];
+    char weapon[50];
+    int hasShield;
+};
 
-        // Allocate memory for strings and copy the values
-        newCharacter->class->name = malloc(strlen(className) + 1);
-        strcpy(newCharacter->class->name, className);
+struct RecordField {
+    const char *key;
+    size_t offset;                // Where the value goes in struct CharacterRecord
+    size_t size;                  // Size of a text field's buffer, 0 for numbers
+    int min;                      // Range a number has to be in
+    int max;
+};
 
-        newCharacter->class->subClass = malloc(strlen(subClass) + 1);
-        strcpy(newCharacter->class->subClass, subClass);
+#define TEXT_FIELD(key, member) { key, offsetof(struct CharacterRecord, member), sizeof(((struct CharacterRecord *)0)->member), 0, 0 }
+#define NUMBER_FIELD(key, member, min, max) { key, offsetof(struct CharacterRecord, member), 0, min, max }
+
+static const struct RecordField recordFields[] = {
+    TEXT_FIELD("Name", name),
+    NUMBER_FIELD("Level", level, 1, MAX_LEVEL),
+    TEXT_FIELD("Class", className),
+    TEXT_FIELD("Subclass", subClass),
+    TEXT_FIELD("Background", background),
+    TEXT_FIELD("Race", race),
+    TEXT_FIELD("Alignment", alignment),
+    NUMBER_FIELD("HP", HP, -999, 99999),
+    NUMBER_FIELD("Speed", speed, 0, 1000),
+    NUMBER_FIELD("Proficiency Modifier", proficiency, 0, 20),
+    NUMBER_FIELD("Strength", scores[0], 1, 30),
+    NUMBER_FIELD("Dexterity", scores[1], 1, 30),
+    NUMBER_FIELD("Constitution", scores[2], 1, 30),
+    NUMBER_FIELD("Intelligence", scores[3], 1, 30),
+    NUMBER_FIELD("Wisdom", scores[4], 1, 30),
+    NUMBER_FIELD("Charisma", scores[5], 1, 30),
+    TEXT_FIELD("Armor", armor),
+    TEXT_FIELD("Weapon", weapon),
+    NUMBER_FIELD("Shield", hasShield, 0, 1),
+};
 
-        newCharacter->background = malloc(strlen(background) + 1);
-        strcpy(newCharacter->background, background);
+// Reads a whole file with one read into a NUL terminated buffer the caller frees, or returns NULL
+static char *readWholeFile(const char *fileName, size_t *length) {
+    int fd = open(fileName, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
 
-        newCharacter->race = malloc(strlen(race) + 1);
-        strcpy(newCharacter->race, race);
+    struct stat info;
+    char *contents = NULL;
+    if (fstat(fd, &info) == 0 && (contents = trackedMalloc(info.st_size + 1, MEMORY_IO)) != NULL) {
+        size_t total = 0;
+        ssize_t got;
+        while (total < (size_t)info.st_size && (got = read(fd, contents + total, info.st_size - total)) > 0) {
+            total += got;
+        }
+        contents[total] = '\0';
+        *length = total;
+    }
+    close(fd);
+    return contents;
+}
 
-        newCharacter->alignment = malloc(strlen(alignment) + 1);
-        strcpy(newCharacter->alignment, alignment);
+// Parses a character file, reporting the exact line of the first field that is missing or out of range
+static int parseCharacterRecord(const char *text, size_t length, const char *fileName, struct CharacterRecord *record, char *message, size_t messageSize) {
+    const char *at = text, *end = text + length;
 
-        newCharacter->armor->name = malloc(strlen(armorName) + 1);
-        strcpy(newCharacter->armor->name, armorName);
+    for (int f = 0; f < (int)(sizeof(recordFields) / sizeof(recordFields[0])); f++) {
+        const struct RecordField *field = &recordFields[f];
+        int line = f + 1;
+        size_t keyLength = strlen(field->key);
 
-        newCharacter->weapon->name = malloc(strlen(weaponName) + 1);
-        strcpy(newCharacter->weapon->name, weaponName);
+        if (at >= end) {
+            snprintf(message, messageSize, "%s:%d: the file ends before the %s line.", fileName, line, field->key);
+            return -1;
+        }
+        const char *lineEnd = memchr(at, '\n', end - at);
+        if (lineEnd == NULL) {
+            lineEnd = end;
+        }
+        if ((size_t)(lineEnd - at) < keyLength + 2 || memcmp(at, field->key, keyLength) != 0 || at[keyLength] != ':' || at[keyLength + 1] != ' ') {
+            snprintf(message, messageSize, "%s:%d: expected '%s: '.", fileName, line, field->key);
+            return -1;
+        }
 
-        fclose(characterFile);
+        const char *value = at + keyLength + 2;
+        size_t valueLength = lineEnd - value;
+        if (valueLength > 0 && value[valueLength - 1] == '\r') {
+            valueLength--;
+        }
 
-        // Add the character to the linked list
-        newCharacter->next = *character;
-        *character = newCharacter;
+        if (field->size > 0) {
+            if (valueLength == 0 || valueLength >= field->size) {
+                snprintf(message, messageSize, "%s:%d: %s has to be 1 to %d characters long.", fileName, line, field->key, (int)field->size - 1);
+                return -1;
+            }
+            char *destination = (char *)record + field->offset;
+            memcpy(destination, value, valueLength);
+            destination[valueLength] = '\0';
+        }
+        else {
+            size_t i = 0;
+            int negative = 0;
+            long number = 0;
+            if (valueLength > 0 && value[0] == '-') {
+                negative = 1;
+                i = 1;
+            }
+            if (i == valueLength) {
+                snprintf(message, messageSize, "%s:%d: %s is not a number.", fileName, line, field->key);
+                return -1;
+            }
+            for (; i < valueLength; i++) {
+                if (value[i] < '0' || value[i] > '9' || number > 1000000) {
+                    snprintf(message, messageSize, "%s:%d: %s is not a number.", fileName, line, field->key);
+                    return -1;
+                }
+                number = number * 10 + (value[i] - '0');
+            }
+            if (negative) {
+                number = -number;
+            }
+            if (number < field->min || number > field->max) {
+                snprintf(message, messageSize, "%s:%d: %s %ld is outside %d to %d.", fileName, line, field->key, number, field->min, field->max);
+                return -1;
+            }
+            *(int *)((char *)record + field->offset) = (int)number;
+        }
+
+        at = lineEnd < end ? lineEnd + 1 : end;
+    }
+    return 0;
+}
+
+int loadCharacterRecord(const char *fileName, struct Character *character, char *message, size_t messageSize) {
+    TRACE_SPAN("loadCharacterRecord", "roster");
+    struct CharacterRecord record;
+    size_t length;
+
+    char *contents = readWholeFile(fileName, &length);
+    if (contents == NULL) {
+        snprintf(message, messageSize, "Could not open file: %s", fileName);
+        return -1;
+    }
+    int parsed = parseCharacterRecord(contents, length, fileName, &record, message, messageSize);
+    trackedFree(contents, MEMORY_IO);
+    if (parsed != 0) {
+        return -1;
     }
 
-    fclose(index);
-    printf("Characters loaded successfully from files.\n");
+    // Allocate memory for the class, armor and weapon come from the catalogs
+    character->class = trackedMalloc(sizeof(struct Class), MEMORY_ROSTER);
+    if (!character->class) {
+        printf("Memory allocation failed for nested structs.\n");
+        exit(1);
+    }
+    character->class->hitDie = 0;
+    character->class->progression = NULL;  // Filled in by initializeHitDie when HP is recalculated
+
+    memcpy(character->name, record.name, sizeof(character->name));
+    character->level = record.level;
+    character->HP = record.HP;
+    character->speed = record.speed;
+    character->proficiencyModifier = record.proficiency;
+    character->strength = record.scores[0];
+    character->dexterity = record.scores[1];
+    character->constitution = record.scores[2];
+    character->intelligence = record.scores[3];
+    character->wisdom = record.scores[4];
+    character->charisma = record.scores[5];
+    character->hasShield = record.hasShield;
+
+    // Allocate memory for strings and copy the values
+    character->class->name = trackedStrdup(record.className, MEMORY_ROSTER);
+    character->class->subClass = trackedStrdup(record.subClass, MEMORY_ROSTER);
+    character->background = trackedStrdup(record.background, MEMORY_ROSTER);
+    character->race = trackedStrdup(record.race, MEMORY_ROSTER);
+    character->alignment = trackedStrdup(record.alignment, MEMORY_ROSTER);
+    if (!character->class->name || !character->class->subClass || !character->background || !character->race || !character->alignment) {
+        printf("Memory allocation failed.\n");
+        exit(1);
+    }
+
+    // Point at the catalog entries like selectArmor and selectWeapon do
+    character->armor = findArmor(record.armor);
+    if (character->armor == NULL) {
+        snprintf(message, messageSize, "Unknown armor '%s' for '%s', using %s.", record.armor, character->name, catalog->armors[0].name);
+        character->armor = &catalog->armors[0];
+    }
+    character->weapon = findWeapon(record.weapon);
+    if (character->weapon == NULL) {
+        size_t used = strlen(message);
+        snprintf(message + used, messageSize - used, "%sUnknown weapon '%s' for '%s', using %s.", used > 0 ? "\n" : "", record.weapon, character->name, catalog->weapons[0].name);
+        character->weapon = &catalog->weapons[0];
+    }
+
+    character->isLoaded = 1;
+    return 0;
+}
+
+// Reads one "Name: ...\nLevel: ..." character file into an existing character
+int readCharacterFile(const char *fileName, struct Character *character) {
+    char message[200] = "";
+    int result = loadCharacterRecord(fileName, character, message, sizeof(message));
+
+    if (message[0] != '\0') {
+        printf("%s\n", message);
+    }
+    if (result == 0) {
+        loadedCharacterCount++;
+    }
+    return result;
 }
 
 void writeCharacterToFile(const char *fileName, struct Character *character) {
-    FILE *characterFile = fopen(fileName, "w");
-    if (characterFile == NULL) {
+    TRACE_SPAN("writeCharacterToFile", "file write");
+    char *contents = NULL;
+    size_t length = 0;
+
+    FILE *record = open_memstream(&contents, &length);
+    if (record == NULL) {
         printf("Error: Could not open the file '%s' for writing.\n", fileName);
         return;
     }
+    printCharacterRecord(record, character);
+    fclose(record);
+    trackAdopted(contents, MEMORY_IO);
 
+    if (writeFileAtomically(fileName, contents, length, durabilityMode != DURABILITY_ASYNC) == 0) {
+        printf("Character data successfully written to '%s'.\n\n", fileName);
+    }
+    trackedFree(contents, MEMORY_IO);
+}
+
+// Prints a character in the "Name: ...\nLevel: ..." format used by the character files
+void printCharacterRecord(FILE *characterFile, struct Character *character) {
     fprintf(characterFile, "Name: %s\n" "Level: %d\n" "Class: %s\n" "Subclass: %s\n" "Background: %s\n" "Race: %s\n" "Alignment: %s\n" "HP: %d\n" "Speed: %d\n" "Proficiency Modifier: %d\n"
             "Strength: %d\n" "Dexterity: %d\n" "Constitution: %d\n" "Intelligence: %d\n" "Wisdom: %d\n" "Charisma: %d\n" "Armor: %s\n" "Weapon: %s\n" "Shield: %d\n",
             character->name, character->level, character->class->name, character->class->subClass, character->background,
             character->race, character->alignment, character->HP, character->speed, character->proficiencyModifier,
             character->strength, character->dexterity, character->constitution, character->intelligence, character->wisdom,
             character->charisma, character->armor->name, character->weapon->name, character->hasShield);
-
-    fclose(characterFile);
-    printf("Character data successfully written to '%s'.\n\n", fileName);
 }
 
-void initializeGlobalArrays(void) {
-    loadArmors("armors.txt");
-    loadWeapons("weapons.txt");
-    loadFilesTo2DArray("attributes.txt", attributes, 6);
-    loadFilesTo2DArray("alignments.txt", alignments, 9);
-    loadFilesTo2DArray("races.txt", races, 10);
-    loadFilesTo2DArray("backgrounds.txt", backgrounds, 16);
-    loadClassesFromFile("classes.txt");
-}
-
-// Armor functions
-const char *armorRequirement(struct Armor *armor) {
-    // Check specific strength requirements for heavy armor types
+// Loads classProgression.txt ("Class,HitDie,SubclassLevel") and precomputes HP and proficiency for levels 1-20
+int loadClassProgression(struct Catalog *catalog, const char *filename) {
+    TRACE_SPAN("loadClassProgression", "catalog");
+    FILE *file = fopen(filename, "r");
+    if (file == NULL) {
+        perror("Error opening file");
+        return 0;
+    }
 
-    if (strcmp(armor->name, "Chain Mail Armor") == 0) {
-        return "13 Strength";
-    } 
-    else if (strcmp(armor->name, "Splint Armor") == 0 || strcmp(armor->name, "Plate Armor") == 0) {
-        return "15 Strength";
-    } 
-    else {
-        return " --------- "; // No strength requirement for other armors
+    char line[256];
+    int capacity = 16;
+    catalog->classProgressions = trackedMalloc(capacity * sizeof(struct ClassProgression), MEMORY_CATALOG);
+    if (catalog->classProgressions == NULL) {
+        fprintf(stderr, "Memory allocation error\n");
+        fclose(file);
+        exit(1);
     }
-}
+    catalog->classProgressionCount = 0;
 
-const char *armorStealth(struct Armor *armor) {
-    return (armor->stealthDisadvantage == 1) ? "Disadvantage" : " --------- ";
-}
+    while (fgets(line, sizeof(line), file) != NULL) {
+        line[strcspn(line, "\n")] = '\0';
+        if (line[0] == '\0') {
+            continue;
+        }
 
-// Weapon functions
-const char *weaponFinesse(struct Weapon *weapon) {
-    return (weapon->isFinesse == 1) ? "  Finesse  " : "Not Finesse";
-}
+        char tempName[256];
+        int hitDie, subClassLevel;
+        if (sscanf(line, "%255[^,],%d,%d", tempName, &hitDie, &subClassLevel) != 3 || hitDie < 1 || subClassLevel < 1 || subClassLevel > MAX_LEVEL) {
+            fprintf(stderr, "Error parsing line: %s\n", line);
+            continue;
+        }
 
-const char *weaponVersatile(struct Weapon *weapon) {
-    return (weapon->isVersatile == 1) ? "  Versatile  " : "Not Versatile";
-}
+        if (catalog->classProgressionCount == capacity) {
+            capacity *= 2;
+            struct ClassProgression *grown = trackedRealloc(catalog->classProgressions, capacity * sizeof(struct ClassProgression), MEMORY_CATALOG);
+            if (grown == NULL) {
+                fprintf(stderr, "Memory allocation error\n");
+                fclose(file);
+                exit(1);
+            }
+            catalog->classProgressions = grown;
+        }
 
-const char *weaponRange(struct Weapon *weapon) {
-    static char rangeStr[20]; // Use a static buffer for returning the string
-    if (weapon->range[0] == 0 && weapon->range[1] == 0) {
-        return "Melee";
-    } 
-    else {
-        // Format the range into a string
-        snprintf(rangeStr, sizeof(rangeStr), "%d/%d", weapon->range[0], weapon->range[1]);
-        return rangeStr;
+        struct ClassProgression *progression = &catalog->classProgressions[catalog->classProgressionCount];
+        progression->name = trackedStrdup(tempName, MEMORY_CATALOG);
+        if (progression->name == NULL) {
+            fprintf(stderr, "Memory allocation error\n");
+            fclose(file);
+            exit(1);
+        }
+        progression->hitDie = hitDie;
+        progression->hpPerLevel = hitDie / 2 + 1;
+        progression->subClassLevel = subClassLevel;
+
+        // Level 1 gets the full hit die, every level after gets the fixed average
+        progression->baseHP[0] = 0;
+        progression->proficiency[0] = 0;
+        for (int level = 1; level <= MAX_LEVEL; level++) {
+            progression->baseHP[level] = (level == 1) ? hitDie : progression->baseHP[level - 1] + progression->hpPerLevel;
+            progression->proficiency[level] = ((level - 1) / 4) + 2;
+        }
+
+        catalog->classProgressionCount++;
     }
+
+    fclose(file);
+    return catalog->classProgressionCount;
 }
 
-//Selecting functions (adding/updating character data)
-void selectName (struct Character *character) {
-    int validInput = 0;
-    char userName[25];
+// Loads monsters from the monsters file ("Name,AC,HP,AttackBonus,DamageDice,DamageBonus,Dexterity")
+int loadMonsters(struct Catalog *catalog, const char *filename) {
+    TRACE_SPAN("loadMonsters", "catalog");
 
-    inputBuffer();
-    while (!validInput) {   
-        printf("Enter your character's name: ");
-        fgets(userName, 25, stdin); // Get user input
-        userName[strcspn(userName, "\n")] = '\0';  // Check if the input has a newline character and remove it 
-        validInput = isValidName(userName);
+    char buffer[256];
+    int count = 0;
+
+    FILE *file = fopen(filename, "r");
+    if (file == NULL) {
+        perror("Error opening file");
+        return 0;
     }
-    strcpy(character->name, userName);
-    printf("\nYour character's name is: %s\n\n", character->name);
-}
 
-int selectLevel(struct Character *character) {
-    int usersLevel, validInput = 0;
+    while (fgets(buffer, sizeof(buffer), file) != NULL && count < 10) {
+        // Remove newline character if present
+        buffer[strcspn(buffer, "\n")] = '\0';
 
-    while (!validInput) {
-        printf("Enter your character's level (1-20): ");
-        validInput = isValidInput(&usersLevel, 1, 20);  // Validate the input range
-    }
+        // Temporary buffers for parsing
+        char tempName[256], tempDamageDice[256];
+        int armorClass, HP, attackBonus, damageBonus, dexterity;
 
-    character->level = usersLevel;  // Set the character's level after validating
+        // Parse the line
+        if (sscanf(buffer, "%255[^,],%d,%d,%d,%255[^,],%d,%d", tempName, &armorClass, &HP, &attackBonus, tempDamageDice, &damageBonus, &dexterity) != 7) {
+            fprintf(stderr, "Error parsing line: %s\n", buffer);
+            continue;
+        }
 
-    printf("Your character is level: %d\n\n", character->level);
-    return usersLevel;  // Output the selected level
-}
+        catalog->monsters[count].name = trackedStrdup(tempName, MEMORY_CATALOG);
+        catalog->monsters[count].damageDice = trackedStrdup(tempDamageDice, MEMORY_CATALOG);
+        if (catalog->monsters[count].name == NULL || catalog->monsters[count].damageDice == NULL) {
+            fprintf(stderr, "Memory allocation error\n");
+            fclose(file);
+            return count;
+        }
 
-void selectClass(struct Character *character){
+        // Populate the remaining fields
+        catalog->monsters[count].armorClass = armorClass;
+        catalog->monsters[count].HP = HP;
+        catalog->monsters[count].attackBonus = attackBonus;
+        catalog->monsters[count].damageBonus = damageBonus;
+        catalog->monsters[count].dexterity = dexterity;
 
-    int usersClass;
-    int validInput = 0;
-    char tempClass[50];
+        count++;
+    }
 
-    if (character->class == NULL) {
-        character->class = malloc(sizeof(struct Class));
-        if (!character->class) {
-            fprintf(stderr, "Memory allocation failed!\n");
-            exit(EXIT_FAILURE);
-        }
-    } 
+    fclose(file);
 
-    character->class->name = NULL;
-    character->class->hitDie = NULL;
-    
-    // Display Class options
-    printf("Enter your character's class:\n");
-    for(int i = 0; i < 12; i++){
-        printf("%d. %s\n", i + 1, classes[i][0]);
+    if (count != 10) {
+        fprintf(stderr, "Error: Expected %d monsters, but loaded %d.\n", 10, count);
     }
+    return count;
+}
 
-    // Input validation loop
-    while(!validInput){
-        printf("Enter your Choice: ");
-        validInput = isValidInput(&usersClass, 1, 12);  // Validate the input range
+void freeMonsters(struct Catalog *catalog) {
+    for (int i = 0; i < 10; i++) {
+        trackedFree(catalog->monsters[i].name, MEMORY_CATALOG);
+        trackedFree(catalog->monsters[i].damageDice, MEMORY_CATALOG);
     }
+}
 
-    // Set class name
-    strcpy(tempClass, classes[usersClass - 1][0]);
-    if (character->class->name) {
-        free(character->class->name); // Free old memory if allocated
+void freeClassProgression(struct Catalog *catalog) {
+    for (int i = 0; i < catalog->classProgressionCount; i++) {
+        trackedFree(catalog->classProgressions[i].name, MEMORY_CATALOG);
     }
-    character->class->name = malloc(strlen(tempClass) + 1);
+    trackedFree(catalog->classProgressions, MEMORY_CATALOG);
+    catalog->classProgressions = NULL;
+    catalog->classProgressionCount = 0;
+}
 
-    if (!character->class->name) {
-        fprintf(stderr, "Memory allocation failed!\n");
-        exit(EXIT_FAILURE);
+// Storage functions
+// Mixes the ID so neighbouring IDs spread evenly over the shard directories
+static unsigned int characterIdHash(int id) {
+    unsigned int hash = (unsigned int)id * 2654435761u;
+    return hash ^ (hash >> 16);
+}
+
+void campaignFilePath(const char *name, char *path, size_t size) {
+    if (snprintf(path, size, "%s%s", campaignDirectory, name) >= (int)size) {
+        printf("Error: The path '%s%s' is too long.\n", campaignDirectory, name);
     }
-    strcpy(character->class->name, tempClass);
+}
 
-    printf("You selected: %s\n\n", character->class->name);
+void characterFilePath(int id, char *path, size_t size) {
+    unsigned int hash = characterIdHash(id);
+    snprintf(path, size, "%s%s/%02x/%02x/%d.txt", campaignDirectory, ROSTER_DIRECTORY, (hash >> 24) & 0xff, (hash >> 16) & 0xff, id);
+}
 
-    initializeHitDie(character);
+// Creates the roster shard directories for an ID if they do not exist yet
+int ensureCharacterDirectory(int id) {
+    unsigned int hash = characterIdHash(id);
+    char path[100];
+
+    snprintf(path, sizeof(path), "%s%s/%02x/%02x", campaignDirectory, ROSTER_DIRECTORY, (hash >> 24) & 0xff, (hash >> 16) & 0xff);
+    if (mkdir(path, 0755) == 0 || errno == EEXIST) {
+        return 0;
+    }
+
+    // Parent directories are missing, create them from the top down
+    campaignFilePath(ROSTER_DIRECTORY, path, sizeof(path));
+    mkdir(path, 0755);
+    snprintf(path, sizeof(path), "%s%s/%02x", campaignDirectory, ROSTER_DIRECTORY, (hash >> 24) & 0xff);
+    mkdir(path, 0755);
+    snprintf(path, sizeof(path), "%s%s/%02x/%02x", campaignDirectory, ROSTER_DIRECTORY, (hash >> 24) & 0xff, (hash >> 16) & 0xff);
+    if (mkdir(path, 0755) == 0 || errno == EEXIST) {
+        return 0;
+    }
+
+    printf("Error: Could not create directory '%s'.\n", path);
+    return -1;
 }
 
-void initializeHitDie(struct Character *character){
-    char tempHitDie[50];
+// Queues a character to be written to its roster file, returns 0 on success
+int saveCharacter(struct Character *character) {
+    char *contents = NULL;
+    size_t length = 0;
 
-    if(strcmp(character->class->name, "Wizard") == 0 || strcmp(character->class->name, "Sorcerer") == 0){
-        strcpy(tempHitDie, "1D6");
+    // Memory-only generated characters (negative IDs) are kept out of the roster on purpose
+    if (character->id < 0) {
+        return 0;
     }
-    else if(strcmp(character->class->name, "Bard") == 0 || strcmp(character->class->name, "Cleric") == 0 || strcmp(character->class->name, "Druid") == 0 || strcmp(character->class->name, "Monk") == 0 || strcmp(character->class->name, "Rogue") == 0 || strcmp(character->class->name, "Warlock") == 0){
-        strcpy(tempHitDie, "1D8");
+
+    // Serialize now so later edits to the character do not leak into this save
+    FILE *record = open_memstream(&contents, &length);
+    if (record == NULL) {
+        printf("Error: Could not save character '%s'.\n", character->name);
+        return -1;
     }
-    else if(strcmp(character->class->name, "Fighter") == 0 || strcmp(character->class->name, "Paladin") == 0 || strcmp(character->class->name, "Ranger") == 0){
-        strcpy(tempHitDie, "1D10");
+    printCharacterRecord(record, character);
+    fclose(record);
+    trackAdopted(contents, MEMORY_IO);
+
+    queueCharacterWrite(character->id, contents, length);
+    return 0;
+}
+
+// Queues the removal of a character's roster file, returns 0 on success
+int deleteCharacterFile(int id) {
+    queueCharacterDelete(id);
+    return 0;
+}
+
+// Appends a batch of "<id>,<name>" entries and "-<id>" tombstones to the index in one write, then
+// compacts it if the tombstones have crossed INDEX_COMPACTION_RATIO (run by the persistence worker)
+static void writeIndexUpdates(const struct IndexUpdate *entries, int entryCount, const int *removals, int removalCount) {
+    TRACE_SPAN("writeIndexUpdates", "file write");
+    char indexPath[100];
+    campaignFilePath("index.txt", indexPath, sizeof(indexPath));
+    FILE *index = fopen(indexPath, "a");
+    if (index == NULL) {
+        printf("Couldn't open the index file.\n");
+        return;
     }
-    else if(strcmp(character->class->name, "Barbarian") == 0){
-        strcpy(tempHitDie, "1D12");
+    for (int i = 0; i < entryCount; i++) {
+        fprintf(index, "%d,%s\n", entries[i].id, entries[i].name);
     }
-    else{
-        strcpy(tempHitDie, "-1");
+    for (int i = 0; i < removalCount; i++) {
+        fprintf(index, "-%d\n", removals[i]);
     }
-
-    if (character->class->hitDie) {
-        free(character->class->hitDie); // Free old memory if allocated
+    if (durabilityMode != DURABILITY_ASYNC) {
+        fflush(index);
+        fsync(fileno(index));
     }
-    character->class->hitDie = malloc(strlen(tempHitDie) + 1);
+    fclose(index);
 
-    if (!character->class->hitDie) {
-        fprintf(stderr, "Memory allocation failed!\n");
-        exit(EXIT_FAILURE);
+    indexEntryLines += entryCount;
+    indexTombstoneLines += removalCount;
+    if (indexTombstoneLines > 0 && indexTombstoneLines >= INDEX_COMPACTION_RATIO * (indexEntryLines + indexTombstoneLines)) {
+        compactIndex();
     }
-    strcpy(character->class->hitDie, tempHitDie);
 }
 
-void selectSubClass(struct Character *character){
-    int usersSubClass, usersChoice = 0;
-    int validInput = 0;
-    int usersClass = -1;
-    char tempSubClass[50];
+void compactIndex(void) {
+    TRACE_SPAN("compactIndex", "file write");
+    int tombstoneCount = 0, tombstoneCapacity = 64, lineId;
+    int *tombstones = trackedMalloc(tombstoneCapacity * sizeof(int), MEMORY_IO);
+    char line[100], indexPath[100], tempPath[100];
+    if (tombstones == NULL) {
+        printf("Memory allocation failed.\n");
+        exit(1);
+    }
 
-    if(character->level < 3){
-        printf("Reach level 3 to unlock Sub Classes.\n\n");
-        strcpy(tempSubClass, "N/A");
-        character->class->subClass = malloc(strlen(tempSubClass) + 1);
-        strcpy(character->class->subClass, tempSubClass);
+    campaignFilePath("index.txt", indexPath, sizeof(indexPath));
+    campaignFilePath("temp_index.txt", tempPath, sizeof(tempPath));
+    FILE *indexFile = fopen(indexPath, "r");
+    if(indexFile == NULL){
+        trackedFree(tombstones, MEMORY_IO);
         return;
     }
 
-    // Display sub class options
-    printf("Enter your character's sub class:\n");
-    
-    // Display sub classes and finds users current class
-    for(int i = 0; i < 13; i++){
-        if(strcmp(character->class->name, classes[i][0]) == 0){
-            for(int j = 1; j < 5; j++){
-                usersClass = i;
-                printf("%d. %s\n", j, classes[usersClass][j]);
+    // First pass collects the tombstones
+    while(fgets(line, sizeof(line), indexFile)){
+        if(line[0] == '-' && sscanf(line + 1, "%d", &lineId) == 1){
+            if (tombstoneCount == tombstoneCapacity) {
+                tombstoneCapacity *= 2;
+                int *grown = trackedRealloc(tombstones, tombstoneCapacity * sizeof(int), MEMORY_IO);
+                if (grown == NULL) {
+                    printf("Memory allocation failed.\n");
+                    exit(1);
+                }
+                tombstones = grown;
             }
-            break;
+            tombstones[tombstoneCount++] = lineId;
         }
     }
-    
-    // If users class is not found
-    if (usersClass == -1) {
-        printf("Error: Class not found. Please ensure your character's class is valid.\n");
-        character->class->subClass = malloc(strlen("N/A") + 1);
-        strcpy(character->class->subClass, "N/A");
+    qsort(tombstones, tombstoneCount, sizeof(int), compareIds);
+
+    // Create a temporary file to write the compacted index
+    FILE *tempFile = fopen(tempPath, "w");
+    if(tempFile == NULL){
+        printf("Error: Could not create temporary index file.\n");
+        fclose(indexFile);
+        trackedFree(tombstones, MEMORY_IO);
         return;
     }
 
-    // Input validation loop
-    while(!validInput){
-        printf("Enter your Choice: ");
-        validInput = isValidInput(&usersChoice, 1, 4);  // Validate the input range
+    // Second pass keeps every entry that was not tombstoned
+    int kept = 0;
+    rewind(indexFile);
+    while(fgets(line, sizeof(line), indexFile)){
+        if(line[0] == '-'){
+            continue;
+        }
+        if(sscanf(line, "%d,", &lineId) == 1 && bsearch(&lineId, tombstones, tombstoneCount, sizeof(int), compareIds) != NULL){
+            continue;
+        }
+        fputs(line, tempFile);
+        kept++;
     }
+    fclose(indexFile);
+    trackedFree(tombstones, MEMORY_IO);
 
-    strcpy(tempSubClass, classes[usersClass][usersChoice]);
-    if (character->class->subClass) {
-        free(character->class->subClass); // Free old memory if allocated
+    // The old index stays in place until the new one is complete, so a crash leaves one or the other
+    if (durabilityMode != DURABILITY_ASYNC) {
+        fflush(tempFile);
+        fsync(fileno(tempFile));
     }
-    character->class->subClass = malloc(strlen(tempSubClass) + 1);
-
-    if (!character->class->subClass) {
-        fprintf(stderr, "Memory allocation failed!\n");
-        exit(EXIT_FAILURE);
+    fclose(tempFile);
+    if(rename(tempPath, indexPath) != 0){
+        printf("Error: Could not rename temporary index file.\n");
+        return;
     }
-    
-    strcpy(character->class->subClass, tempSubClass);
-    printf("You selected: %s\n\n", character->class->subClass);
+    indexEntryLines = kept;
+    indexTombstoneLines = 0;
 }
 
-void selectBackground(struct Character *character){
-    int usersBackground;
-    int validInput = 0;
+void appendIndexEntry(struct Character *character) {
+    queueIndexUpdate(PERSIST_INDEX_APPEND, character->id, character->name);
+}
 
-    // Display background options
-    printf("Enter your character's background:\n");
-    for(int i = 0; i < 16; i++){
-        printf("%d. %s\n", i + 1, backgrounds[i]);
-    }
+void removeIndexEntry(int id) {
+    queueIndexUpdate(PERSIST_INDEX_REMOVE, id, "");
+}
 
-    // Input validation loop
-    while(!validInput){
-        printf("Enter your Choice: ");
-        validInput = isValidInput(&usersBackground, 1, 16);  // Validate the input range
+// Writes the whole index from the character list, keeping the order the characters were added in
+int rewriteIndex(struct Character *head, char **legacyLines, int legacyCount) {
+    TRACE_SPAN("rewriteIndex", "file write");
+    int count = 0;
+    for (struct Character *character = head; character != NULL; character = character->next) {
+        count++;
     }
 
-    // Free existing memory for background if already allocated
-    if (character->background != NULL) {
-        free(character->background);
+    char indexPath[100], tempPath[100];
+    campaignFilePath("index.txt", indexPath, sizeof(indexPath));
+    campaignFilePath("temp_index.txt", tempPath, sizeof(tempPath));
+    FILE *tempFile = fopen(tempPath, "w");
+    if (tempFile == NULL) {
+        printf("Error: Could not create temporary index file.\n");
+        return -1;
     }
 
-    // Allocate memory and copy the selected background
-    character->background = malloc(strlen(backgrounds[usersBackground - 1]) + 1);
-    if (character->background == NULL) {
-        fprintf(stderr, "Memory allocation failed for background.\n");
+    // The list holds the newest character first, so write it back to front
+    struct Character **ordered = trackedMalloc((count > 0 ? count : 1) * sizeof(struct Character *), MEMORY_IO);
+    if (ordered == NULL) {
+        printf("Memory allocation failed.\n");
         exit(1);
     }
+    int i = count;
+    for (struct Character *character = head; character != NULL; character = character->next) {
+        ordered[--i] = character;
+    }
+    for (i = 0; i < count; i++) {
+        fprintf(tempFile, "%d,%s\n", ordered[i]->id, ordered[i]->name);
+    }
+    trackedFree(ordered, MEMORY_IO);
+    for (i = 0; i < legacyCount; i++) {
+        fprintf(tempFile, "%s\n", legacyLines[i]);
+    }
+    indexEntryLines = count + legacyCount;
+    indexTombstoneLines = 0;
+    if (durabilityMode != DURABILITY_ASYNC) {
+        fflush(tempFile);
+        fsync(fileno(tempFile));
+    }
+    fclose(tempFile);
 
-    strcpy(character->background, backgrounds[usersBackground - 1]);
-    printf("You selected: %s\n\n", character->background);
+    if (rename(tempPath, indexPath) != 0) {
+        printf("Error: Could not rename temporary index file.\n");
+        return -1;
+    }
+    return 0;
 }
 
-void selectRace(struct Character *character){
-    int usersRace;
-    int validInput = 0;
+// Lazy loading functions
+static unsigned long characterUseTick = 0;   // Increases every time a character is used
 
-    // Display race options
-    printf("Enter your characters race:\n");
-    for(int i = 0; i < 10; i++){
-        printf("%d. %s\n", i + 1, races[i]);
+int ensureLoaded(struct Character *character) {
+    character->lastUsed = ++characterUseTick;
+    if (character->isLoaded) {
+        return 0;
     }
 
-    // Input validation loop
-    while(!validInput){
-        printf("Enter your Choice: ");
-        validInput = isValidInput(&usersRace, 1, 10);  // Validate the input range
-    }
+    char path[100];
+    characterFilePath(character->id, path, sizeof(path));
+    return readCharacterFile(path, character);
+}
 
-    // Free existing memory for background if already allocated
-    if (character->race != NULL) {
-        free(character->race);
+struct Character *findCharacter(struct Character *head, const char *name) {
+    if (!nameFilterContains(name)) {
+        return NULL;
     }
-
-    // Allocate memory and copy the selected background
-    character->race = malloc(strlen(races[usersRace - 1]) + 1);
-    if (character->race == NULL) {
-        fprintf(stderr, "Memory allocation failed for background.\n");
-        exit(1);
+    while (head != NULL) {
+        if (strcmp(head->name, name) == 0) {
+            return ensureLoaded(head) == 0 ? head : NULL;
+        }
+        head = head->next;
     }
+    return NULL;
+}
 
-    strcpy(character->race, races[usersRace - 1]);
-    printf("You selected: %s\n\n", character->race);
+// Frees everything but the id and name, leaving the character to be loaded again from its roster file
+static void releaseCharacterDetails(struct Character *character) {
+    trackedFree(character->class->name, MEMORY_ROSTER);
+    trackedFree(character->class->subClass, MEMORY_ROSTER);
+    trackedFree(character->class, MEMORY_ROSTER);
+    trackedFree(character->background, MEMORY_ROSTER);
+    trackedFree(character->race, MEMORY_ROSTER);
+    trackedFree(character->alignment, MEMORY_ROSTER);
+    character->class = NULL;
+    character->background = NULL;
+    character->race = NULL;
+    character->alignment = NULL;
+    character->armor = NULL;
+    character->weapon = NULL;
+    character->isLoaded = 0;
 }
 
-void selectAlignment(struct Character *character){
-    int usersAlignment;
-    int validInput = 0;
+// Unloads a character counted as loaded, the roster file already holds the latest saved copy
+static void unloadCharacter(struct Character *character) {
+    releaseCharacterDetails(character);
+    loadedCharacterCount--;
+}
 
-    // Display alignment options
-    printf("Enter your character's alignment:\n");
-    for (int i = 0; i < 9; i++) {
-        printf("%d. %s\n", i + 1, alignments[i]);
+void freeCharacter(struct Character *character) {
+    if (character->class != NULL) {
+        trackedFree(character->class->name, MEMORY_ROSTER);
+        trackedFree(character->class->subClass, MEMORY_ROSTER);
+        trackedFree(character->class, MEMORY_ROSTER);
     }
+    trackedFree(character->background, MEMORY_ROSTER);
+    trackedFree(character->race, MEMORY_ROSTER);
+    trackedFree(character->alignment, MEMORY_ROSTER);
+    trackedFree(character->rollStats, MEMORY_ROSTER);
+    freeHistory(character);
+    trackedFree(character, MEMORY_ROSTER);
+}
 
-    // Input validation loop
-    while(!validInput){
-        printf("Enter your Choice: ");
-        validInput = isValidInput(&usersAlignment, 1, 9);  // Validate the input range
-    }
+static int compareLastUsed(const void *a, const void *b) {
+    const struct Character *first = *(struct Character *const *)a;
+    const struct Character *second = *(struct Character *const *)b;
+    return (first->lastUsed > second->lastUsed) - (first->lastUsed < second->lastUsed);
+}
 
-    // Free existing memory for background if already allocated
-    if (character->alignment != NULL) {
-        free(character->alignment);
+void enforceMemoryBudget(struct Character *head) {
+    if (!lazyLoading || loadedCharacterCount <= lazyBudget) {
+        return;
     }
 
-    // Allocate memory and copy the selected background
-    character->alignment = malloc(strlen(alignments[usersAlignment - 1]) + 1);
-    if (character->alignment == NULL) {
-        fprintf(stderr, "Memory allocation failed for background.\n");
-        exit(1);
+    struct Character **loaded = trackedMalloc(loadedCharacterCount * sizeof(struct Character *), MEMORY_WORK);
+    if (loaded == NULL) {
+        return;   // Try again next time instead of failing
     }
-
-    strcpy(character->alignment, alignments[usersAlignment - 1]);
-    printf("You selected: %s\n\n", character->alignment);
-}
-
-void selectAttributes(struct Character *character){
-    int userChoice;
-
-    for(int i = 0; i < 6; i++){ 
-        int validInput = 0;
-        while(!validInput){
-            printf("Enter your character's %s value (8-20): ", attributes[i]);
-            validInput = isValidInput(&userChoice, 8, 20);  // Validate the input range
-        }
-        switch(i){
-            case 0: 
-                character->strength = userChoice;
-                break;
-            case 1: 
-                character->dexterity = userChoice;
-                break;
-            case 2: 
-                character->constitution = userChoice;
-                break;
-            case 3: 
-                character->intelligence = userChoice;
-                break;
-            case 4: 
-                character->wisdom = userChoice;
-                break;
-            case 5: 
-                character->charisma = userChoice;
-                break;
-            default: 
-                printf("Error in attribute selection.\n");
-                return;
+    int count = 0;
+    for (struct Character *character = head; character != NULL && count < loadedCharacterCount; character = character->next) {
+        // Memory-only generated characters have no file to be read back from
+        if (character->isLoaded && character->id > 0) {
+            loaded[count++] = character;
         }
-        printf("Your character has %d %s!\n", userChoice, attributes[i]);
-        validInput = 1;
     }
-}
-    
-void selectArmor(struct Character *character) {
-    int usersArmor;
-    int validInput, strCheck = 0;
-        // Display armor menu
-        printf("Select Your Armor:\n");
-        printf("-------------------------------------------------------------------------------------\n");
-        printf("   %-22s |   %-6s |  %-3s | %-8s |    %-10s| %-15s\n", "Name", "Type", "AC", "Dex Mod.", "Stealth", "Requirements");
-        printf("-------------------------------------------------------------------------------------\n");
-        //prints armor from armors array
-        for ( int i = 0; i < 9; i++) {
-            printf("%d. %-22s |  %-7s |  %-3d |    %-5d | %-12s | %-15s\n", i + 1, armors[i].name, armors[i].type, armors[i].baseAC, calculateModifier(character->dexterity), armorStealth(&armors[i]), armorRequirement(&armors[i]));
-        }
-        for (int i = 9; i < 13; i++) {
-            printf("%d. %-21s |  %-7s |  %-3d |    %-5d | %-12s | %-15s\n", i + 1, armors[i].name, armors[i].type, armors[i].baseAC, calculateModifier(character->dexterity), armorStealth(&armors[i]), armorRequirement(&armors[i]));
-        }
-        printf("-------------------------------------------------------------------------------------\n");
-        
-        do {
-            printf("Enter your choice: ");
-            validInput = isValidInput(&usersArmor, 1, 13);  // Validate the input range
-            if (validInput) {  // Proceed only if the input is valid
-                const char *requirement = armorRequirement(&armors[usersArmor - 1]);
-
-                // Check strength requirement
-                if ((strcmp(requirement, "13 Strength") == 0 && character->strength < 13) || (strcmp(requirement, "15 Strength") == 0 && character->strength < 15)) {
-                    printf("\nYou do not have enough strength to wield this armor! Please try again.\n\n");
-                    strCheck = 0;  // Reset flag
-                } else {
-                    strCheck = 1;  // Strength requirement satisfied
-                }
-            }
-        } while (!validInput || !strCheck);
 
-    // Assign selected armor
-    character->armor = &armors[usersArmor - 1];
-    printf("You selected: %s\n\n", character->armor->name);
+    // Unloaded characters are read back from their files, so queued saves have to land first
+    flushPendingWrites();
+    qsort(loaded, count, sizeof(struct Character *), compareLastUsed);
+    int evict = loadedCharacterCount - lazyBudget;
+    for (int i = 0; i < evict && i < count; i++) {
+        unloadCharacter(loaded[i]);
+    }
+    trackedFree(loaded, MEMORY_WORK);
 }
 
-void selectWeapon(struct Character *character){
-    int usersWeapon;
-    int validInput = 0;
+// Persistence functions
+// One queued operation. The queue is an intrusive multi-producer single-consumer list: producers
+// only swap the head pointer, so the menus never take a lock or wait on the worker.
+struct PersistOp {
+    enum PersistOpType type;
+    int id;                   // Character the operation belongs to
+    char *contents;           // Serialized record (PERSIST_WRITE)
+    size_t length;            // Length of contents in bytes
+    char name[25];            // Character name (PERSIST_INDEX_APPEND)
+    sem_t *done;              // Posted once a PERSIST_FLUSH has been committed
+    struct PersistOp *next;
+};
 
-        // Display weapon menu
-        printf("Select Your Weapon(s):\n");
-        printf("----------------------------------------------------------------------------------------------------------\n");
-        printf(" %-19s |      %-9s |   %-10s | %-8s |    %-5s    |    %-5s    | %-10s \n", "Name", "Type", "DMG type", "DMG dice", "Finesse", "Versitile", "Range");
-        printf("----------------------------------------------------------------------------------------------------------\n");
-        //prints weapons from the weapons array
-        for ( int i = 0; i < 9; i++) {
-            printf("%d.  %-16s |  %-13s |  %-11s |    %-5s |   %-5s |  %-6s  | %-10s \n", i + 1, weapons[i].name, weapons[i].type, weapons[i].damageType, weapons[i].damageDice, weaponFinesse(&weapons[i]), weaponVersatile(&weapons[i]), weaponRange(&weapons[i]));
-        }
-        for (int i = 9; i < 31; i++) {
-            printf("%d.  %-15s |  %-13s |  %-11s |    %-5s |   %-5s |  %-6s  | %-10s \n", i + 1, weapons[i].name, weapons[i].type, weapons[i].damageType, weapons[i].damageDice, weaponFinesse(&weapons[i]), weaponVersatile(&weapons[i]), weaponRange(&weapons[i]));
-        }
-        printf("----------------------------------------------------------------------------------------------------------\n");
+static struct PersistOp persistStub;                       // Keeps the queue from ever being empty
+static struct PersistOp *persistHead = &persistStub;       // Newest operation, swapped by producers
+static struct PersistOp *persistTail = &persistStub;       // Oldest operation, only touched by the consumer
+static sem_t persistWake;                                  // Posted once per queued operation
+static unsigned long long persistSubmitted = 0;            // Saves, deletes and index updates queued so far
+static unsigned long long persistFlushed = 0;              // persistSubmitted as of the last finished flush
+static unsigned long long persistFailures = 0;             // Roster files the worker could not write or replace
+static unsigned long long persistReported = 0;             // persistFailures as of the last flush
+static pthread_t persistThread;
+static int persistThreadRunning = 0;
+
+// Writes the worker has coalesced but not committed yet. Only the worker touches these.
+struct PendingWrite {
+    int id;                   // Character ID the write belongs to
+    char *contents;           // Serialized character record (NULL if the file should be removed)
+    size_t length;            // Length of contents in bytes
+};
+static struct PendingWrite *pendingWrites = NULL;
+static int pendingCount = 0;
+static int pendingCapacity = 0;
+static int *pendingSlots = NULL;          // Open addressing table of pendingWrites indexes by ID (-1 = empty)
+static int pendingSlotCount = 0;
+static struct IndexUpdate *pendingAppends = NULL;
+static int pendingAppendCount = 0;
+static int pendingAppendCapacity = 0;
+static int *pendingRemovals = NULL;
+static int pendingRemovalCount = 0;
+static int pendingRemovalCapacity = 0;
+static long long pendingSinceMs = 0;      // When the oldest uncommitted operation arrived
+
+static long long currentTimeMs(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
 
-        while (!validInput){
-            printf("Enter your choice: ");
-            validInput = isValidInput(&usersWeapon, 1, 31);  // Validate the input range
+// Writes all of a buffer to a file descriptor, returns 0 on success
+static int writeAll(int fd, const char *contents, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, contents, length);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
         }
-
-    // Assign selected armor
-    character->weapon = &weapons[usersWeapon - 1];
-    printf("You selected: %s\n\n", character->weapon->name);
+        contents += written;
+        length -= written;
+    }
+    return 0;
 }
 
-void selectShield(struct Character *character){
-    int usersShield, validInput = 0; 
+int writeFileAtomically(const char *path, const char *contents, size_t length, int sync) {
+    TRACE_SPAN("writeFileAtomically", "file write");
+    char tempPath[110];
+    snprintf(tempPath, sizeof(tempPath), "%s.tmp", path);
 
-    printf("Is your character holding a shield? (1: yes | 0: no)\n");
-    // Input validation loop
-    while(!validInput){
-        printf("Enter your Choice: ");
-        validInput = isValidInput(&usersShield, 0, 1);  // Validate the input range
+    int fd = open(tempPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        printf("Error: Could not open the file '%s' for writing.\n", tempPath);
+        return -1;
     }
-
-    character->hasShield = usersShield;
-
-    if(usersShield == 1){
-        printf("Your character is now holding a shield!\n\n");
+    if (writeAll(fd, contents, length) != 0 || (sync && fsync(fd) != 0)) {
+        printf("Error: Could not write the file '%s'.\n", tempPath);
+        close(fd);
+        remove(tempPath);
+        return -1;
     }
-    else{
-        printf("Your character is not holding a shield!\n\n");
+    close(fd);
+
+    if (rename(tempPath, path) != 0) {
+        printf("Error: Could not replace the file '%s'.\n", path);
+        remove(tempPath);
+        return -1;
     }
+    return 0;
 }
 
-// Calculate functions
-// Returns the modifer associated with your character attribute
-int calculateModifier(int attribute){
-    return (attribute - 10) / 2;
+static void pushPersistOp(struct PersistOp *op) {
+    op->next = NULL;
+    struct PersistOp *previous = __atomic_exchange_n(&persistHead, op, __ATOMIC_ACQ_REL);
+    __atomic_store_n(&previous->next, op, __ATOMIC_RELEASE);
 }
 
-// Returns your characters armor class number
-int calculateArmorClass(int dexterity, const char *armorName, int hasShield) {
-    int shieldBonus = hasShield ? 2 : 0;            // +2 AC if the character has a shield
-    int maxDex = 0;                                 // Default max dex modifier
+// Takes the oldest operation off the queue, or NULL if it is empty (or a push is half done,
+// in which case its producer posts persistWake again once it finishes)
+static struct PersistOp *popPersistOp(void) {
+    struct PersistOp *tail = persistTail;
+    struct PersistOp *next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
 
-    // Find the armor in the armors array
-    struct Armor *selectedArmor = NULL;
-    for (int i = 0; i < sizeof(armors) - 1; i++) {
-        if (strcmp(armors[i].name, armorName) == 0) {
-            selectedArmor = &armors[i];
-            break;
+    if (tail == &persistStub) {
+        if (next == NULL) {
+            return NULL;
         }
+        persistTail = next;
+        tail = next;
+        next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
     }
-    // If armor is not found, return a default value
-    if (!selectedArmor) {
-        printf("Invalid armor type: %s\n", armorName);
-        return 10; // Default unarmored AC
+    if (next != NULL) {
+        persistTail = next;
+        return tail;
     }
-
-    // Apply max dexterity bonus if required
-    if (selectedArmor->requiresDexCap == 1 && calculateModifier(dexterity) > selectedArmor->maxDexBonus) {
-        maxDex = selectedArmor->maxDexBonus;
+    if (tail != __atomic_load_n(&persistHead, __ATOMIC_ACQUIRE)) {
+        return NULL;
     }
-    if(selectedArmor->maxDexBonus == -1){
-        maxDex = calculateModifier(dexterity);
+    // tail is the last operation, put the stub behind it so it can be handed out
+    pushPersistOp(&persistStub);
+    next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+    if (next != NULL) {
+        persistTail = next;
+        return tail;
     }
-    //if the armor is of "Heavy" type then AC gets 0 dexterity bonus
-    if(strcmp(selectedArmor->type, "Heavy") == 0){
-        maxDex = 0;
+    return NULL;
+}
+
+static struct PersistOp *newPersistOp(enum PersistOpType type, int id) {
+    struct PersistOp *op = trackedCalloc(1, sizeof(struct PersistOp), MEMORY_IO);
+    if (op == NULL) {
+        printf("Memory allocation failed.\n");
+        exit(1);
     }
+    op->type = type;
+    op->id = id;
+    return op;
+}
 
-    // Calculate the final AC
-    int armorClass = selectedArmor->baseAC + maxDex + shieldBonus;
-    return armorClass;
+static void processPersistQueue(void);
+
+// Hands an operation to the worker (without one it waits for the caller's flushPendingWrites)
+static void submitPersistOp(struct PersistOp *op) {
+    pushPersistOp(op);
+    if (op->type != PERSIST_FLUSH && op->type != PERSIST_STOP) {
+        __atomic_add_fetch(&persistSubmitted, 1, __ATOMIC_RELEASE);
+    }
+    if (persistThreadRunning) {
+        sem_post(&persistWake);
+    }
 }
 
-int calculateRollModifier(struct Character *head, char *diceCharacterName, int numChoice){
-    //puts all characters modifiers in an array
-    int *attributes[] = {
-        &head->strength, &head->dexterity,
-        &head->constitution, &head->intelligence,
-        &head->wisdom, &head->charisma
-    };  
-    //check to see if list is empty
-    if(head == NULL){ 
-        return -1; //indicates error
+void queueCharacterWrite(int id, char *contents, size_t length) {
+    struct PersistOp *op = newPersistOp(PERSIST_WRITE, id);
+    op->contents = contents;
+    op->length = length;
+    submitPersistOp(op);
+
+    if (durabilityMode == DURABILITY_IMMEDIATE || !persistThreadRunning) {
+        flushPendingWrites();
     }
-    //checks to make sure the character entered exists
-    if (strcmp(head->name, diceCharacterName) != 0){
-        return -1; //not found -1 indicating error
+}
+
+void queueCharacterDelete(int id) {
+    submitPersistOp(newPersistOp(PERSIST_DELETE, id));
+    if (durabilityMode == DURABILITY_IMMEDIATE || !persistThreadRunning) {
+        flushPendingWrites();
     }
-    //validates numChoice
-    if(numChoice > 6 || numChoice < 1){
-        return rollD20();
+}
+
+void queueIndexUpdate(enum PersistOpType type, int id, const char *name) {
+    struct PersistOp *op = newPersistOp(type, id);
+    snprintf(op->name, sizeof(op->name), "%s", name);
+    submitPersistOp(op);
+    if (durabilityMode == DURABILITY_IMMEDIATE || !persistThreadRunning) {
+        flushPendingWrites();
     }
-    //returns the baseRoll + your character modifier of choice
-    return rollD20() + calculateModifier(*attributes[numChoice - 1]);
 }
 
-int calculateDamageDiceRoll(struct Weapon *weapon){
+// Returns the pendingWrites index for an ID, adding an empty entry if there isn't one yet
+static int pendingWriteFor(int id) {
+    if (pendingCount * 2 >= pendingSlotCount) {
+        // Grow and rebuild the lookup table
+        int slotCount = pendingSlotCount ? pendingSlotCount * 2 : 64;
+        int *slots = trackedMalloc(slotCount * sizeof(int), MEMORY_IO);
+        if (slots == NULL) {
+            printf("Memory allocation failed.\n");
+            exit(1);
+        }
+        memset(slots, -1, slotCount * sizeof(int));
+        for (int i = 0; i < pendingCount; i++) {
+            unsigned int slot = characterIdHash(pendingWrites[i].id) & (slotCount - 1);
+            while (slots[slot] != -1) {
+                slot = (slot + 1) & (slotCount - 1);
+            }
+            slots[slot] = i;
+        }
+        trackedFree(pendingSlots, MEMORY_IO);
+        pendingSlots = slots;
+        pendingSlotCount = slotCount;
+    }
 
-    if (!weapon || !weapon->damageDice){
-            return -1; // Error: Null pointer
+    unsigned int slot = characterIdHash(id) & (pendingSlotCount - 1);
+    while (pendingSlots[slot] != -1) {
+        if (pendingWrites[pendingSlots[slot]].id == id) {
+            return pendingSlots[slot];
         }
+        slot = (slot + 1) & (pendingSlotCount - 1);
+    }
 
-        if (strcasecmp(weapon->damageDice, "1D4") == 0){
-            return rollD4();
-        } 
-        else if (strcasecmp(weapon->damageDice, "1D6") == 0){
-            return rollD6();
-        } 
-        else if (strcasecmp(weapon->damageDice, "1D8") == 0){
-            return rollD8();
-        } 
-        else if (strcasecmp(weapon->damageDice, "1D10") == 0){
-            return rollD10();
-        } 
-        else if (strcasecmp(weapon->damageDice, "1D12") == 0){
-            return rollD12();
-        } 
-        else if (strcasecmp(weapon->damageDice, "2D6") == 0){
-            return rollD6() + rollD6();
-        } 
-        else{
-            return -1; // Error: Unknown dice type
+    if (pendingCount == pendingCapacity) {
+        pendingCapacity = pendingCapacity ? pendingCapacity * 2 : 16;
+        struct PendingWrite *grown = trackedRealloc(pendingWrites, pendingCapacity * sizeof(struct PendingWrite), MEMORY_IO);
+        if (grown == NULL) {
+            printf("Memory allocation failed.\n");
+            exit(1);
         }
+        pendingWrites = grown;
+    }
+    pendingWrites[pendingCount].id = id;
+    pendingWrites[pendingCount].contents = NULL;
+    pendingWrites[pendingCount].length = 0;
+    pendingSlots[slot] = pendingCount;
+    return pendingCount++;
 }
 
-int calculateDamageRoll(struct Character *character, char *characterName) {
-    int dmgDice;
+static void *growArray(void *array, int *capacity, size_t size) {
+    *capacity = *capacity ? *capacity * 2 : 16;
+    void *grown = trackedRealloc(array, *capacity * size, MEMORY_IO);
+    if (grown == NULL) {
+        printf("Memory allocation failed.\n");
+        exit(1);
+    }
+    return grown;
+}
 
-    // Check if character or characterName is NULL
-    if (character == NULL || characterName == NULL) {
-        return -1; // Error case
+// Commits every coalesced write, delete and index update (temp files, one sync, atomic renames)
+static void commitPending(void) {
+    TRACE_SPAN("commitPending", "file write");
+    int sync = (durabilityMode != DURABILITY_ASYNC);
+    int *written = trackedCalloc(pendingCount ? pendingCount : 1, sizeof(int), MEMORY_IO);
+    int syncFd = -1;
+    char path[100], tempPath[110];
+    if (written == NULL) {
+        printf("Memory allocation failed.\n");
+        exit(1);
     }
 
-    // Check if the character name matches
-    if (strcmp(character->name, characterName) == 0) {
-        // Ensure weapon is not NULL
-        if (character->weapon != NULL) {
-            struct Weapon *weapon = character->weapon;
-
-            // Handle finesse property
-            if (weapon->isFinesse == 1) {
-                dmgDice = calculateDamageDiceRoll(weapon) + calculateModifier(character->dexterity);
-            }
-            // Handle versatile property
-            else if (weapon->isVersatile == 1){
-                if (character->hasShield == 0){
-                    // Use two-handed damage dice
-                    dmgDice = calculateDamageDiceRoll(weapon) + calculateModifier(character->strength);
-                } 
-                else {
-                    // Use standard one-handed damage dice
-                    dmgDice = calculateDamageDiceRoll(weapon) + calculateModifier(character->strength);
-                }
-            }
-            // Handle standard strength-based attacks
-            else {
-                dmgDice = calculateDamageDiceRoll(weapon) + calculateModifier(character->strength);
+    // 1. Write every record to its temp file
+    for (int i = 0; i < pendingCount; i++) {
+        if (pendingWrites[i].contents == NULL) {
+            continue;
+        }
+        characterFilePath(pendingWrites[i].id, path, sizeof(path));
+        if (ensureCharacterDirectory(pendingWrites[i].id) != 0) {
+            printf("Error: Could not create the directory for '%s'.\n", path);
+            __atomic_add_fetch(&persistFailures, 1, __ATOMIC_RELEASE);
+            continue;
+        }
+        snprintf(tempPath, sizeof(tempPath), "%s.tmp", path);
+
+        int fd = open(tempPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0 || writeAll(fd, pendingWrites[i].contents, pendingWrites[i].length) != 0) {
+            printf("Error: Could not write the file '%s'.\n", tempPath);
+            __atomic_add_fetch(&persistFailures, 1, __ATOMIC_RELEASE);
+            if (fd >= 0) {
+                close(fd);
             }
-        } 
+            remove(tempPath);
+            continue;
+        }
+        if (syncFd < 0) {
+            syncFd = fd;   // Kept open to sync the whole file system once
+        }
         else {
-            return -1; // Weapon is NULL
+            close(fd);
         }
-    } 
-    else {
-        return -1; // Character name does not match
+        written[i] = 1;
     }
 
-    return dmgDice; // Return damage dealt
-}
+    // 2. One sync makes every temp file durable before any of them replace the old files
+    if (sync && syncFd >= 0) {
+#ifdef __linux__
+        syncfs(syncFd);
+#else
+        sync();
+#endif
+    }
 
-int calculateAttackRoll(struct Character *character, char *characterName){
+    // 3. Atomically replace the old files and remove deleted characters' files
+    for (int i = 0; i < pendingCount; i++) {
+        characterFilePath(pendingWrites[i].id, path, sizeof(path));
+        if (written[i]) {
+            snprintf(tempPath, sizeof(tempPath), "%s.tmp", path);
+            if (rename(tempPath, path) != 0) {
+                printf("Error: Could not replace the file '%s'.\n", path);
+                __atomic_add_fetch(&persistFailures, 1, __ATOMIC_RELEASE);
+                remove(tempPath);
+            }
+        }
+        else if (pendingWrites[i].contents == NULL) {
+            remove(path);
+        }
+        trackedFree(pendingWrites[i].contents, MEMORY_IO);
+    }
 
-    if (character == NULL || characterName == NULL || character->weapon == NULL) {
-        return -1; // Error case
+    // 4. One more sync makes the renames themselves durable
+    if (syncFd >= 0) {
+        if (sync) {
+#ifdef __linux__
+            syncfs(syncFd);
+#else
+            sync();
+#endif
+        }
+        close(syncFd);
     }
 
-    // Base roll
-    int baseRoll = rollD20();
-    int abilityModifier;
-    int isProficient = character->proficiencyModifier;
+    // 5. Index entries and tombstones are appended in one write
+    if (pendingAppendCount > 0 || pendingRemovalCount > 0) {
+        writeIndexUpdates(pendingAppends, pendingAppendCount, pendingRemovals, pendingRemovalCount);
+    }
 
-    // Determine which ability modifier to use
-    if (character->weapon->isFinesse == 1 || strcmp(character->weapon->type, "Ranged") == 0 || (strcmp(character->weapon->type, "Melee/Ranged") == 0 && character->weapon->isFinesse == 1)) {
-        abilityModifier = character->dexterity;
-    } 
-    else {
-        abilityModifier = character->strength;
+    trackedFree(written, MEMORY_IO);
+    pendingCount = 0;
+    pendingAppendCount = 0;
+    pendingRemovalCount = 0;
+    if (pendingSlots != NULL) {
+        memset(pendingSlots, -1, pendingSlotCount * sizeof(int));
     }
+}
 
-    // Calculate and return the attack roll
-    return baseRoll + calculateModifier(abilityModifier) + isProficient;
+static int hasPending(void) {
+    return pendingCount > 0 || pendingAppendCount > 0 || pendingRemovalCount > 0;
 }
 
-int calculateHealth(struct Character *character){
+// Moves everything on the queue into the pending batch, committing at flushes.
+// Returns 1 once a PERSIST_STOP has been handled.
+static int drainPersistQueue(void) {
+    struct PersistOp *op;
+    int stopping = 0;
 
-    initializeHitDie(character);
+    while ((op = popPersistOp()) != NULL) {
+        if (op == &persistStub) {
+            continue;
+        }
+        if (!hasPending()) {
+            pendingSinceMs = currentTimeMs();
+        }
 
-    if (!character || !character->class || !character->class->hitDie) {
-        printf("Error: Invalid character or class data.\n");
-        return -1; // Error
+        switch (op->type) {
+            case PERSIST_WRITE:
+            case PERSIST_DELETE: {
+                // A newer save (or a delete) replaces the one already queued
+                int i = pendingWriteFor(op->id);
+                trackedFree(pendingWrites[i].contents, MEMORY_IO);
+                pendingWrites[i].contents = op->contents;
+                pendingWrites[i].length = op->length;
+                break;
+            }
+            case PERSIST_INDEX_APPEND:
+                if (pendingAppendCount == pendingAppendCapacity) {
+                    pendingAppends = growArray(pendingAppends, &pendingAppendCapacity, sizeof(struct IndexUpdate));
+                }
+                pendingAppends[pendingAppendCount].id = op->id;
+                memcpy(pendingAppends[pendingAppendCount].name, op->name, sizeof(op->name));
+                pendingAppendCount++;
+                break;
+            case PERSIST_INDEX_REMOVE:
+                if (pendingRemovalCount == pendingRemovalCapacity) {
+                    pendingRemovals = growArray(pendingRemovals, &pendingRemovalCapacity, sizeof(int));
+                }
+                pendingRemovals[pendingRemovalCount++] = op->id;
+                break;
+            case PERSIST_FLUSH:
+            case PERSIST_STOP:
+                // These live on the stack of the thread waiting on them, so op can't be touched after the post
+                stopping |= (op->type == PERSIST_STOP);
+                commitPending();
+                if (op->done != NULL) {
+                    sem_post(op->done);
+                }
+                continue;
+        }
+        trackedFree(op, MEMORY_IO);
+    }
+    return stopping;
+}
+
+// Without a worker (before startPersistence or after stopPersistence) the caller commits inline
+static void processPersistQueue(void) {
+    drainPersistQueue();
+    if (hasPending()) {
+        commitPending();
     }
+}
 
-    int conMod = calculateModifier(character->constitution);
-    int charLVL = character->level;
-    int baseHitDie;
+// Returns -1 if commits have failed since the last time this was asked
+static int takePersistFailures(void) {
+    unsigned long long failures = __atomic_load_n(&persistFailures, __ATOMIC_ACQUIRE);
+    int failed = failures != persistReported;
+    persistReported = failures;
+    return failed ? -1 : 0;
+}
 
-    // Parse the base value of hitDie
-    if (sscanf(character->class->hitDie, "1D%d", &baseHitDie) != 1) {
-        printf("Error: Invalid hitDie format '%s'.\n", character->class->hitDie);
-        return -1; // Error
+int flushPendingWrites(void) {
+    if (!persistThreadRunning) {
+        processPersistQueue();
+        return takePersistFailures();
     }
 
-    // Calculate health based on level
-    if (charLVL > 1) {
-        return (baseHitDie + conMod) + ((baseHitDie / 2 + 1) * (charLVL - 1)) + (conMod * charLVL);
-    } 
-    else {
-        return baseHitDie + conMod;
+    // Nothing queued since the last flush means everything is already on disk
+    unsigned long long submitted = __atomic_load_n(&persistSubmitted, __ATOMIC_ACQUIRE);
+    if (submitted == __atomic_load_n(&persistFlushed, __ATOMIC_ACQUIRE)) {
+        return takePersistFailures();
+    }
+
+    struct PersistOp op;
+    sem_t done;
+    memset(&op, 0, sizeof(op));
+    op.type = PERSIST_FLUSH;
+    op.done = &done;
+    sem_init(&done, 0, 0);
+    submitPersistOp(&op);
+    while (sem_wait(&done) != 0 && errno == EINTR) {
     }
+    sem_destroy(&done);
+    __atomic_store_n(&persistFlushed, submitted, __ATOMIC_RELEASE);
+    return takePersistFailures();
 }
 
-int calculateProficiencyModifier(struct Character *character){
-    return ((character->level - 1) / 4) + 2;
+// Commits the pending batch whenever its oldest operation has waited out the group commit window
+static void *persistWorker(void *unused) {
+    (void)unused;
+    traceThreadName("persistence");
+    while (1) {
+        if (!hasPending() || durabilityMode == DURABILITY_IMMEDIATE) {
+            while (sem_wait(&persistWake) != 0 && errno == EINTR) {
+            }
+        }
+        else {
+            long long waitMs = pendingSinceMs + groupCommitWindowMs - currentTimeMs();
+            if (waitMs > 0) {
+                struct timespec until;
+                clock_gettime(CLOCK_REALTIME, &until);
+                long long waitNs = waitMs * 1000000LL + until.tv_nsec;
+                until.tv_sec += waitNs / 1000000000LL;
+                until.tv_nsec = waitNs % 1000000000LL;
+                sem_timedwait(&persistWake, &until);
+            }
+        }
+
+        if (drainPersistQueue()) {
+            return NULL;
+        }
+        if (hasPending() && currentTimeMs() >= pendingSinceMs + groupCommitWindowMs) {
+            commitPending();
+        }
+    }
 }
 
-// Display functions
-void addCharacter(struct Character **newChar){
-    int userCurrLevel;
-    //make space for new character in memory
-    struct Character *newCharacter = malloc(sizeof(struct Character));
-    if (newCharacter == NULL){
-        printf("Failed to allocate memory :(\n");
-        exit(1);
+void startPersistence(void) {
+    sem_init(&persistWake, 0, 0);
+    if (pthread_create(&persistThread, NULL, persistWorker, NULL) == 0) {
+        persistThreadRunning = 1;
+    }
+    else {
+        printf("Could not start the persistence thread, saving immediately instead.\n");
+        durabilityMode = DURABILITY_IMMEDIATE;
     }
+}
 
-    newCharacter->class = malloc(sizeof(struct Class));
-    if (newCharacter->class == NULL) {
-        printf("Failed to allocate memory for class.\n");
-        free(newCharacter);
-        exit(1);
+void stopPersistence(void) {
+    if (persistThreadRunning) {
+        struct PersistOp op;
+        memset(&op, 0, sizeof(op));
+        op.type = PERSIST_STOP;
+        submitPersistOp(&op);
+        pthread_join(persistThread, NULL);
+        persistThreadRunning = 0;
+    }
+    processPersistQueue();
+
+    trackedFree(pendingWrites, MEMORY_IO);
+    trackedFree(pendingSlots, MEMORY_IO);
+    trackedFree(pendingAppends, MEMORY_IO);
+    trackedFree(pendingRemovals, MEMORY_IO);
+    pendingWrites = NULL;
+    pendingSlots = NULL;
+    pendingAppends = NULL;
+    pendingRemovals = NULL;
+    pendingCapacity = pendingSlotCount = pendingAppendCapacity = pendingRemovalCapacity = 0;
+}
+
+void parseCommandLine(int argc, char *argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--durability=immediate") == 0) {
+            durabilityMode = DURABILITY_IMMEDIATE;
+        }
+        else if (strcmp(argv[i], "--durability=group") == 0) {
+            durabilityMode = DURABILITY_GROUP;
+        }
+        else if (strcmp(argv[i], "--durability=async") == 0) {
+            durabilityMode = DURABILITY_ASYNC;
+        }
+        else if (strncmp(argv[i], "--group-window=", 15) == 0) {
+            groupCommitWindowMs = atoi(argv[i] + 15);
+            if (groupCommitWindowMs < 0) {
+                groupCommitWindowMs = 0;
+            }
+        }
+        else if (strncmp(argv[i], "--generate=", 11) == 0) {
+            generateCount = atoi(argv[i] + 11);
+        }
+        else if (strncmp(argv[i], "--seed=", 7) == 0) {
+            generateSeed = strtoull(argv[i] + 7, NULL, 10);
+        }
+        else if (strncmp(argv[i], "--history-budget=", 17) == 0) {
+            historyBudget = (size_t)atoi(argv[i] + 17) * 1024 * 1024;
+        }
+        else if (strcmp(argv[i], "--lazy") == 0) {
+            lazyLoading = 1;
+        }
+        else if (strncmp(argv[i], "--lazy-budget=", 14) == 0) {
+            lazyLoading = 1;
+            lazyBudget = atoi(argv[i] + 14);
+            if (lazyBudget < 1) {
+                lazyBudget = 1;
+            }
+        }
+        else if (strcmp(argv[i], "--no-watch") == 0) {
+            catalogWatching = 0;
+        }
+        else if (strncmp(argv[i], "--campaign=", 11) == 0) {
+            snprintf(initialCampaign, sizeof(initialCampaign), "%s", argv[i] + 11);
+        }
+        else if (strncmp(argv[i], "--campaign-budget=", 18) == 0) {
+            campaignBudget = (size_t)atoi(argv[i] + 18) * 1024 * 1024;
+        }
+        else if (strncmp(argv[i], "--trace=", 8) == 0) {
+            snprintf(traceFileName, sizeof(traceFileName), "%s", argv[i] + 8);
+        }
+        else if (strncmp(argv[i], "--query=", 8) == 0) {
+            snprintf(startupQuery, sizeof(startupQuery), "%s", argv[i] + 8);
+        }
+        else if (strcmp(argv[i], "--check-expressions") == 0) {
+            checkingExpressions = 1;
+        }
+        else if (strncmp(argv[i], "--audit=", 8) == 0) {
+            snprintf(auditFileName, sizeof(auditFileName), "%s", argv[i] + 8);
+        }
+        else if (strcmp(argv[i], "--audit-compress") == 0) {
+            auditCompression = 1;
+        }
+        else if (strncmp(argv[i], "--audit-read=", 13) == 0) {
+            snprintf(auditReadFileName, sizeof(auditReadFileName), "%s", argv[i] + 13);
+        }
+        else if (strncmp(argv[i], "--audit-character=", 18) == 0) {
+            snprintf(auditCharacterFilter, sizeof(auditCharacterFilter), "%s", argv[i] + 18);
+        }
+        else if (strncmp(argv[i], "--audit-function=", 17) == 0) {
+            snprintf(auditFunctionFilter, sizeof(auditFunctionFilter), "%s", argv[i] + 17);
+        }
+        else {
+            printf("Unknown option '%s'.\n", argv[i]);
+            printf("Options: --durability=immediate|group|async  --group-window=<ms>  --lazy  --lazy-budget=<characters>\n");
+            printf("         --generate=<characters>  --seed=<seed>  --history-budget=<MB>  --no-watch\n");
+            printf("         --campaign=<name>  --campaign-budget=<MB>  --trace=<file>  --query=<expression>  --check-expressions\n");
+            printf("         --audit=<file>  --audit-compress  --audit-read=<file>  --audit-character=<name>  --audit-function=<name>\n\n");
+        }
     }
+}
 
-    newCharacter->armor = malloc(sizeof(struct Armor));
-    if (newCharacter->armor == NULL) {
-        printf("Failed to allocate memory for armor.\n");
-        free(newCharacter->class);
-        free(newCharacter);
+void initializeGlobalArrays(void) {
+    TRACE_SPAN("initializeGlobalArrays", "catalog");
+    int valid;
+
+    // The first epoch is used even if a file had problems (they have already been reported), except for a missing
+    // classes.txt which nothing can work without
+    latestCatalog = loadCatalog(1, &valid);
+    latestCatalog->readers = 1;
+    if (latestCatalog->classes[0][0] == NULL) {
         exit(1);
     }
+    catalog = acquireCatalog();
+}
+
+// Catalog functions
+#define CATALOG_SETTLE_MS 200  // Quiet time after the last change before a reload, so a save in progress is not read
+
+static const char *catalogFiles[] = {
+    "armors.txt", "weapons.txt", "attributes.txt", "alignments.txt", "races.txt",
+    "backgrounds.txt", "classes.txt", "classProgression.txt", "monsters.txt"
+};
+
+pthread_t catalogWatcherThread;
+int catalogWatcherRunning = 0;
+int catalogWatcherStopping = 0;
+int catalogWatchFd = -1;
 
-    newCharacter->weapon = malloc(sizeof(struct Weapon));
-    if (newCharacter->weapon == NULL) {
-        printf("Failed to allocate memory for weapon.\n");
-        free(newCharacter->armor);
-        free(newCharacter->class);
-        free(newCharacter);
+struct Catalog *loadCatalog(unsigned int epoch, int *valid) {
+    TRACE_SPAN("loadCatalog", "catalog");
+    struct Catalog *next = trackedCalloc(1, sizeof(struct Catalog), MEMORY_CATALOG);
+    if (next == NULL) {
+        printf("Memory allocation failed.\n");
         exit(1);
     }
+    next->epoch = epoch;
+
+    // Every file is loaded even after one fails so all of the problems get reported together
+    int loaded = loadArmors(next, "armors.txt") == 13;
+    loaded &= loadWeapons(next, "weapons.txt") == 31;
+    loaded &= loadFilesTo2DArray("attributes.txt", next->attributes, 6) == 6;
+    loaded &= loadFilesTo2DArray("alignments.txt", next->alignments, 9) == 9;
+    loaded &= loadFilesTo2DArray("races.txt", next->races, 10) == 10;
+    loaded &= loadFilesTo2DArray("backgrounds.txt", next->backgrounds, 16) == 16;
+    loaded &= loadClassesFromFile(next, "classes.txt") == 12;
+    loaded &= loadClassProgression(next, "classProgression.txt") > 0;
+    loaded &= loadMonsters(next, "monsters.txt") == 10;
+
+    // A class without a progression row would leave its characters without HP or proficiency
+    for (int i = 0; i < 12 && next->classes[i][0] != NULL; i++) {
+        int found = 0;
+        for (int j = 0; j < next->classProgressionCount && !found; j++) {
+            found = strcmp(next->classProgressions[j].name, next->classes[i][0]) == 0;
+        }
+        if (!found) {
+            fprintf(stderr, "Error: %s has no row in classProgression.txt.\n", next->classes[i][0]);
+            loaded = 0;
+        }
+    }
 
-    newCharacter->background = NULL;
-    newCharacter->race = NULL;
-    newCharacter->alignment = NULL;
-    newCharacter->level = 1; // Default level
-    newCharacter->hasShield = 0; // Default to no shield
-    newCharacter->speed = 30;
-    newCharacter->proficiencyModifier = 0;
-    newCharacter->HP = 0;
+    *valid = loaded;
+    return next;
+}
 
-    //prompt user to enter details for character
-    printf("For more information regarding DnD character details visit DnD Beyond\n\n");
+void freeCatalog(struct Catalog *catalog) {
+    freeArmors(catalog);
+    freeWeapons(catalog);
+    free2DArray(catalog->attributes, 6);
+    free2DArray(catalog->alignments, 9);
+    free2DArray(catalog->races, 10);
+    free2DArray(catalog->backgrounds, 16);
+    freeClasses(catalog);
+    freeClassProgression(catalog);
+    freeMonsters(catalog);
+    trackedFree(catalog, MEMORY_CATALOG);
+}
 
-    // Calls the select functions to gather information about your character
-    selectName(newCharacter);
-    userCurrLevel = selectLevel(newCharacter);
-    selectClass(newCharacter); 
-    selectSubClass(newCharacter);
-    selectBackground(newCharacter);
-    selectRace(newCharacter);
-    selectAlignment(newCharacter);
-    selectAttributes(newCharacter);
-    selectArmor(newCharacter);
-    selectWeapon(newCharacter);
-    selectShield(newCharacter);
-    newCharacter->proficiencyModifier = calculateProficiencyModifier(newCharacter);
-    newCharacter->HP = calculateHealth(newCharacter);
-    //inserts the new character at the beginning of the list
-    newCharacter->next = *newChar;
-    *newChar = newCharacter;
+struct Catalog *acquireCatalog(void) {
+    pthread_mutex_lock(&catalogLock);
+    struct Catalog *pinned = latestCatalog;
+    pinned->readers++;
+    pthread_mutex_unlock(&catalogLock);
+    return pinned;
+}
 
-    // Gets character first name or name before any spaces
-    char firstName[100];
-    sscanf(newCharacter->name, "%s", firstName);
-    // Create a dynamic file name
-    char fileName[100];
-    snprintf(fileName, sizeof(fileName), "%s.txt", firstName);
-
-    // Write character details to the file
-    FILE *characterFile = fopen(fileName, "w");
-    if (characterFile == NULL) {
-        printf("Couldn't open the file: %s\n", fileName);
-    } else {
-        writeCharacterToFile(fileName, newCharacter);
+void releaseCatalog(struct Catalog *catalog) {
+    if (catalog == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&catalogLock);
+    int unused = --catalog->readers == 0;
+    pthread_mutex_unlock(&catalogLock);
 
-        // Append the file name to index.txt
-        FILE *index = fopen("index.txt", "a");
-        if (index == NULL) {
-            printf("Couldn't open the index file.\n");
-        } 
-        else {
-            fprintf(index, "%s\n", fileName);
-            fclose(index);
+    if (unused) {
+        freeCatalog(catalog);
+    }
+}
+
+void publishCatalog(struct Catalog *next) {
+    next->readers = 1;  // Held by latestCatalog until the next epoch replaces it
+
+    pthread_mutex_lock(&catalogLock);
+    struct Catalog *replaced = latestCatalog;
+    latestCatalog = next;
+    pthread_mutex_unlock(&catalogLock);
+
+    releaseCatalog(replaced);
+}
+
+// Where each armor and weapon of the old epoch went in the current one. Saved files and history store
+// equipment by name, so entries are matched by name and survive rows being reordered or inserted. An entry
+// whose name is gone falls back to the first row, like an unknown name in a roster file.
+struct EquipmentRemap {
+    struct Catalog *old;
+    struct Armor *armors[13];
+    struct Weapon *weapons[31];
+    int removed;              // Characters (or history versions) whose equipment fell back to the first row
+};
+
+static void buildEquipmentRemap(struct Catalog *old, struct EquipmentRemap *remap) {
+    remap->old = old;
+    remap->removed = 0;
+    for (int i = 0; i < 13; i++) {
+        remap->armors[i] = old->armors[i].name != NULL ? findArmor(old->armors[i].name) : NULL;
+    }
+    for (int i = 0; i < 31; i++) {
+        remap->weapons[i] = old->weapons[i].name != NULL ? findWeapon(old->weapons[i].name) : NULL;
+    }
+}
+
+// Points an armor and weapon from the old epoch at the entries with the same name in the current one.
+// Pointers already moved (blocks shared between history versions) are left alone.
+static void remapEquipment(struct EquipmentRemap *remap, struct Armor **armor, struct Weapon **weapon) {
+    struct Catalog *old = remap->old;
+    int removed = 0;
+
+    if (*armor >= old->armors && *armor < old->armors + 13) {
+        *armor = remap->armors[*armor - old->armors];
+        if (*armor == NULL) {
+            *armor = &catalog->armors[0];
+            removed = 1;
+        }
+    }
+    if (*weapon >= old->weapons && *weapon < old->weapons + 31) {
+        *weapon = remap->weapons[*weapon - old->weapons];
+        if (*weapon == NULL) {
+            *weapon = &catalog->weapons[0];
+            removed = 1;
         }
     }
+    remap->removed += removed;
 }
 
-void displayCharacter(struct Character *character){
+static void remapCharacters(struct EquipmentRemap *remap, struct Character *head) {
+    for (struct Character *character = head; character != NULL; character = character->next) {
+        remapEquipment(remap, &character->armor, &character->weapon);
+        if (character->class != NULL && character->class->name != NULL) {
+            initializeHitDie(character);
+        }
+        if (character->history != NULL) {
+            for (int i = 0; i < character->history->count - character->history->firstInMemory; i++) {
+                struct EquipmentBlock *equipment = character->history->versions[i]->equipment;
+                remapEquipment(remap, &equipment->armor, &equipment->weapon);
+            }
+        }
+    }
+}
 
-    //check to see if list is empty
-    if(character == NULL){ 
-        printf("\nNo characters in the list...\n");
-        printf("Please enter a character first\n\n");
+void refreshCatalog(struct Character *head) {
+    pthread_mutex_lock(&catalogLock);
+    int current = catalog == latestCatalog;
+    pthread_mutex_unlock(&catalogLock);
+    if (current) {
         return;
     }
 
-    //displays all charcters
-    printf("List of characters:\n\n");
-    while(character != NULL){
-        printf("    ___________ Name: %s ___________\n\n", character->name);
-        printf("Class: %s   Level: %d   Background: %s\n\n", character->class->name, character->level, character->background);                                    //displays Class, Level, Background
-        printf("Sub Class: %s   Race: %s    Alignment: %s\n\n", character->class->subClass, character->race, character->alignment);                                                                //displays Race, Alignment
-        printf("Armor: %s   Armor Class: %d     Weapon: %s\n\n", character->armor->name, calculateArmorClass(character->dexterity, character->armor->name, character->hasShield), character->weapon->name);   //displays Armor, Armor Class, Weapon
-        printf("Total HP: %d    Proficiency Modifier: %d\n\n", character->HP, character->proficiencyModifier);
-        printf("Strength\nAbility Score: %d\nModifier: %d\n\n", character->strength, calculateModifier(character->strength));                          //displays Strength
-        printf("Dexterity\nAbility Score: %d\nModifier: %d\n\n", character->dexterity, calculateModifier(character->dexterity));                       //displays Dexterity 
-        printf("Constitution\nAbility Score: %d\nModifier: %d\n\n", character->constitution, calculateModifier(character->constitution));              //displays Constitution
-        printf("Intelligence\nAbility Score: %d\nModifier: %d\n\n", character->intelligence, calculateModifier(character->intelligence));              //displays Intelligence
-        printf("Wisdom\nAbility Score: %d\nModifier: %d\n\n", character->wisdom, calculateModifier(character->wisdom));                                //displays Wisdom
-        printf("Charisma\nAbility Score: %d\nModifier: %d\n\n", character->charisma, calculateModifier(character->charisma));                          //displays Charisma
-        character = character->next;
+    struct Catalog *old = catalog;
+    struct EquipmentRemap remap;
+    catalog = acquireCatalog();
+    buildEquipmentRemap(old, &remap);
+
+    // Campaigns switched away from still point into the old epoch too (the first one is current)
+    remapCharacters(&remap, head);
+    for (struct Campaign *campaign = campaigns != NULL ? campaigns->next : NULL; campaign != NULL; campaign = campaign->next) {
+        remapCharacters(&remap, campaign->characters);
+    }
+
+    // Nothing on this thread points into the old epoch any more
+    releaseCatalog(old);
+    printf("The catalog files changed and have been reloaded (epoch %u).\n", catalog->epoch);
+    if (remap.removed > 0) {
+        printf("%d character version(s) used armor or a weapon that is no longer listed and now use %s or %s.\n",
+               remap.removed, catalog->armors[0].name, catalog->weapons[0].name);
     }
+    printf("\n");
 }
 
-//Searches for a character by name
-void searchCharacter(struct Character *character, char *searchCharacterName){
-    int ifFound = 0;
+static int isCatalogFile(const char *name) {
+    for (int i = 0; i < (int)(sizeof(catalogFiles) / sizeof(catalogFiles[0])); i++) {
+        if (strcmp(name, catalogFiles[i]) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
 
-    while(character != NULL){
-        if (strcmp(character->name, searchCharacterName) == 0){
-            printf("\n    ___________ Name: %s ___________\n\n", character->name);
-            printf("Class: %s   Level: %d   Background: %s\n\n", character->class->name, character->level, character->background);                                    //displays Class, Level, Background
-            printf("Sub Class: %s   Race: %s    Alignment: %s\n\n", character->class->subClass, character->race, character->alignment);                                                                //displays Race, Alignment
-            printf("Armor: %s   Armor Class: %d     Weapon: %s\n\n", character->armor->name, calculateArmorClass(character->dexterity, character->armor->name, character->hasShield), character->weapon->name);   //displays Armor, Armor Class, Weapon
-            printf("Total HP: %d    Proficiency Modifier: %d\n\n", character->HP, character->proficiencyModifier);
-            printf("Strength\nAbility Score: %d\nModifier: %d\n\n", character->strength, calculateModifier(character->strength));                          //displays Strength
-            printf("Dexterity\nAbility Score: %d\nModifier: %d\n\n", character->dexterity, calculateModifier(character->dexterity));                       //displays Dexterity 
-            printf("Constitution\nAbility Score: %d\nModifier: %d\n\n", character->constitution, calculateModifier(character->constitution));              //displays Constitution
-            printf("Intelligence\nAbility Score: %d\nModifier: %d\n\n", character->intelligence, calculateModifier(character->intelligence));              //displays Intelligence
-            printf("Wisdom\nAbility Score: %d\nModifier: %d\n\n", character->wisdom, calculateModifier(character->wisdom));                                //displays Wisdom
-            printf("Charisma\nAbility Score: %d\nModifier: %d\n\n", character->charisma, calculateModifier(character->charisma));
-            ifFound = 1;
-            break;
+// Parses the catalog files into the next epoch and publishes it if every file loaded cleanly
+static void reloadCatalog(void) {
+    int valid;
+
+    pthread_mutex_lock(&catalogLock);
+    unsigned int epoch = latestCatalog->epoch + 1;
+    pthread_mutex_unlock(&catalogLock);
+
+    struct Catalog *next = loadCatalog(epoch, &valid);
+    if (!valid) {
+        fprintf(stderr, "The catalog files changed but did not load cleanly, so the current catalog is kept.\n");
+        freeCatalog(next);
+        return;
+    }
+    publishCatalog(next);
+}
+
+static void *catalogWatcher(void *unused) {
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    struct pollfd watch = {catalogWatchFd, POLLIN, 0};
+    int changed = 0;
+
+    (void)unused;
+    traceThreadName("catalog watcher");
+    while (!__atomic_load_n(&catalogWatcherStopping, __ATOMIC_ACQUIRE)) {
+        // The short timeout is only there so the thread notices it is being stopped
+        int ready = poll(&watch, 1, changed ? CATALOG_SETTLE_MS : 250);
+
+        if (ready > 0) {
+            ssize_t length = read(catalogWatchFd, buffer, sizeof(buffer));
+            for (char *at = buffer; length > 0 && at < buffer + length; ) {
+                struct inotify_event *event = (struct inotify_event *)at;
+                if (event->len > 0 && isCatalogFile(event->name)) {
+                    changed = 1;
+                }
+                at += sizeof(struct inotify_event) + event->len;
+            }
+        }
+        else if (ready == 0 && changed) {
+            changed = 0;
+            reloadCatalog();
         }
-        character = character->next;
     }
+    return NULL;
+}
 
-    if(ifFound != 1){
-        printf("\nYour character could not found :(\n\n");
+void startCatalogWatcher(void) {
+    if (!catalogWatching) {
+        return;
+    }
+
+    // Editors often save by writing a new file and renaming it over the old one, so watch for both
+    catalogWatchFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (catalogWatchFd < 0 || inotify_add_watch(catalogWatchFd, ".", IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        perror("Could not watch the catalog files");
+        if (catalogWatchFd >= 0) {
+            close(catalogWatchFd);
+            catalogWatchFd = -1;
+        }
+        return;
+    }
+    if (pthread_create(&catalogWatcherThread, NULL, catalogWatcher, NULL) == 0) {
+        catalogWatcherRunning = 1;
     }
 }
 
-//Updates details of your character
-void updateCharacter(struct Character *updatedCharacter, char *updateCharacterName){
+void stopCatalogWatcher(void) {
+    if (catalogWatcherRunning) {
+        __atomic_store_n(&catalogWatcherStopping, 1, __ATOMIC_RELEASE);
+        pthread_join(catalogWatcherThread, NULL);
+        catalogWatcherRunning = 0;
+    }
+    if (catalogWatchFd >= 0) {
+        close(catalogWatchFd);
+        catalogWatchFd = -1;
+    }
+}
 
-    while (updatedCharacter != NULL){
-        if (strcmp(updatedCharacter->name, updateCharacterName) == 0){
-            int choice;
-            printf("Found character: %s\n", updateCharacterName);
-            printf("Choose which part of your character you want to update:\n");
+// Armor functions
+const char *armorRequirement(struct Armor *armor) {
+    // Check specific strength requirements for heavy armor types
 
-            do {
-                printf("\n1. Level\n2. Class\n3. Subclass\n4. Background\n5. Race\n6. Alignment\n7. Attributes\n8. Armor\n9. Weapon\n10. Shield\n11. Save and Exit\n");
-                printf("Enter your choice: ");
-                scanf("%d", &choice);
+    if (strcmp(armor->name, "Chain Mail Armor") == 0) {
+        return "13 Strength";
+    } 
+    else if (strcmp(armor->name, "Splint Armor") == 0 || strcmp(armor->name, "Plate Armor") == 0) {
+        return "15 Strength";
+    } 
+    else {
+        return " --------- "; // No strength requirement for other armors
+    }
+}
 
-                switch (choice) {
-                    case 1:
-                        selectLevel(updatedCharacter);
-                        if(strcmp(updatedCharacter->class->subClass, "N/A") == 0 && updatedCharacter->level > 2){
-                            selectSubClass(updatedCharacter);
-                        }
-                        if(updatedCharacter->level < 3){
-                            selectSubClass(updatedCharacter);
-                        }
-                        updatedCharacter->HP = calculateHealth(updatedCharacter);
-                        updatedCharacter->proficiencyModifier = calculateProficiencyModifier(updatedCharacter);
-                        break;
-                    case 2:
-                        selectClass(updatedCharacter);
-                        selectSubClass(updatedCharacter);
-                        break;
-                    case 3:
-                        selectSubClass(updatedCharacter);
-                        break;
-                    case 4:
-                        selectBackground(updatedCharacter);
-                        break;
-                    case 5:
-                        selectRace(updatedCharacter);
-                        break;
-                    case 6:
-                        selectAlignment(updatedCharacter);
-                        break;
-                    case 7:
-                        selectAttributes(updatedCharacter);
-                        break;
-                    case 8:
-                        selectArmor(updatedCharacter);
-                        break;
-                    case 9:
-                        selectWeapon(updatedCharacter);
-                        break;
-                    case 10:
-                        selectShield(updatedCharacter);
-                        break;
-                    case 11:
-                        printf("Exiting update menu...\n");
-                        break;
-                    default:
-                        printf("Invalid choice. Please try again.\n");
-                }
-            } while (choice != 11);
+const char *armorStealth(struct Armor *armor) {
+    return (armor->stealthDisadvantage == 1) ? "Disadvantage" : " --------- ";
+}
+
+// Returns the Strength score needed to wear the armor (0 if there is no requirement)
+int armorStrengthRequirement(struct Armor *armor) {
+    return atoi(armorRequirement(armor));
+}
+
+// Returns the catalog entry for an armor name, or NULL if it is not in armors.txt
+struct Armor *findArmor(const char *armorName) {
+    for (int i = 0; i < 13; i++) {
+        if (catalog->armors[i].name != NULL && strcmp(catalog->armors[i].name, armorName) == 0) {
+            return &catalog->armors[i];
+        }
+    }
+    return NULL;
+}
+
+// Weapon functions
+const char *weaponFinesse(struct Weapon *weapon) {
+    return (weapon->isFinesse == 1) ? "  Finesse  " : "Not Finesse";
+}
+
+const char *weaponVersatile(struct Weapon *weapon) {
+    return (weapon->isVersatile == 1) ? "  Versatile  " : "Not Versatile";
+}
+
+const char *weaponRange(struct Weapon *weapon) {
+    static char rangeStr[20]; // Use a static buffer for returning the string
+    if (weapon->range[0] == 0 && weapon->range[1] == 0) {
+        return "Melee";
+    } 
+    else {
+        // Format the range into a string
+        snprintf(rangeStr, sizeof(rangeStr), "%d/%d", weapon->range[0], weapon->range[1]);
+        return rangeStr;
+    }
+}
+
+// Returns the catalog entry for a weapon name, or NULL if it is not in weapons.txt
+struct Weapon *findWeapon(const char *weaponName) {
+    for (int i = 0; i < 31; i++) {
+        if (catalog->weapons[i].name != NULL && strcmp(catalog->weapons[i].name, weaponName) == 0) {
+            return &catalog->weapons[i];
+        }
+    }
+    return NULL;
+}
+
+//Selecting functions (adding/updating character data)
+void selectName (struct Character *head, struct Character *character) {
+    int validInput = 0;
+    char userName[25];
+
+    inputBuffer();
+    while (!validInput) {   
+        printf("Enter your character's name: ");
+        fgets(userName, 25, stdin); // Get user input
+        userName[strcspn(userName, "\n")] = '\0';  // Check if the input has a newline character and remove it 
+        validInput = isValidName(userName);
+        if (validInput && characterNameExists(head, userName)) {
+            printf("A character named '%s' already exists, please choose another name.\n\n", userName);
+            validInput = 0;
+        }
+    }
+    strcpy(character->name, userName);
+    printf("\nYour character's name is: %s\n\n", character->name);
+}
+
+int selectLevel(struct Character *character) {
+    int usersLevel, validInput = 0;
+
+    while (!validInput) {
+        printf("Enter your character's level (1-20): ");
+        validInput = isValidInput(&usersLevel, 1, 20);  // Validate the input range
+    }
+
+    character->level = usersLevel;  // Set the character's level after validating
+
+    printf("Your character is level: %d\n\n", character->level);
+    return usersLevel;  // Output the selected level
+}
+
+void selectClass(struct Character *character){
+
+    int usersClass;
+    int validInput = 0;
+    char tempClass[50];
+
+    if (character->class == NULL) {
+        character->class = trackedMalloc(sizeof(struct Class), MEMORY_ROSTER);
+        if (!character->class) {
+            fprintf(stderr, "Memory allocation failed!\n");
+            exit(EXIT_FAILURE);
+        }
+    } 
+
+    character->class->name = NULL;
+    character->class->hitDie = 0;
+    character->class->progression = NULL;
+    
+    // Display Class options
+    printf("Enter your character's class:\n");
+    for(int i = 0; i < 12; i++){
+        printf("%d. %s\n", i + 1, catalog->classes[i][0]);
+    }
+
+    // Input validation loop
+    while(!validInput){
+        printf("Enter your Choice: ");
+        validInput = isValidInput(&usersClass, 1, 12);  // Validate the input range
+    }
+
+    // Set class name
+    strcpy(tempClass, catalog->classes[usersClass - 1][0]);
+    if (character->class->name) {
+        trackedFree(character->class->name, MEMORY_ROSTER); // Free old memory if allocated
+    }
+    character->class->name = trackedMalloc(strlen(tempClass) + 1, MEMORY_ROSTER);
+
+    if (!character->class->name) {
+        fprintf(stderr, "Memory allocation failed!\n");
+        exit(EXIT_FAILURE);
+    }
+    strcpy(character->class->name, tempClass);
+
+    printf("You selected: %s\n\n", character->class->name);
+
+    initializeHitDie(character);
+}
+
+// Looks up the hit die for the character's class in the class progression table
+void initializeHitDie(struct Character *character){
+    character->class->progression = findClassProgression(character->class->name);
+    character->class->hitDie = character->class->progression ? character->class->progression->hitDie : -1;
+}
+
+// Returns the progression table row for a class name, or NULL if the class is not in classProgression.txt
+struct ClassProgression *findClassProgression(const char *className) {
+    for (int i = 0; i < catalog->classProgressionCount; i++) {
+        if (strcmp(catalog->classProgressions[i].name, className) == 0) {
+            return &catalog->classProgressions[i];
+        }
+    }
+    return NULL;
+}
+
+// Returns the level the character's class unlocks its subclass at (3 if the class has no progression row)
+int subClassUnlockLevel(struct Character *character) {
+    if (character->class->progression == NULL) {
+        initializeHitDie(character);
+    }
+    return character->class->progression ? character->class->progression->subClassLevel : 3;
+}
+
+void selectSubClass(struct Character *character){
+    int usersSubClass, usersChoice = 0;
+    int validInput = 0;
+    int usersClass = -1;
+    char tempSubClass[50];
+
+    if(character->level < subClassUnlockLevel(character)){
+        printf("Reach level %d to unlock Sub Classes.\n\n", subClassUnlockLevel(character));
+        strcpy(tempSubClass, "N/A");
+        character->class->subClass = trackedMalloc(strlen(tempSubClass) + 1, MEMORY_ROSTER);
+        strcpy(character->class->subClass, tempSubClass);
+        return;
+    }
+
+    // Display sub class options
+    printf("Enter your character's sub class:\n");
+    
+    // Display sub classes and finds users current class
+    for(int i = 0; i < 13; i++){
+        if(strcmp(character->class->name, catalog->classes[i][0]) == 0){
+            for(int j = 1; j < 5; j++){
+                usersClass = i;
+                printf("%d. %s\n", j, catalog->classes[usersClass][j]);
+            }
+            break;
+        }
+    }
+    
+    // If users class is not found
+    if (usersClass == -1) {
+        printf("Error: Class not found. Please ensure your character's class is valid.\n");
+        character->class->subClass = trackedMalloc(strlen("N/A") + 1, MEMORY_ROSTER);
+        strcpy(character->class->subClass, "N/A");
+        return;
+    }
+
+    // Input validation loop
+    while(!validInput){
+        printf("Enter your Choice: ");
+        validInput = isValidInput(&usersChoice, 1, 4);  // Validate the input range
+    }
+
+    strcpy(tempSubClass, catalog->classes[usersClass][usersChoice]);
+    if (character->class->subClass) {
+        trackedFree(character->class->subClass, MEMORY_ROSTER); // Free old memory if allocated
+    }
+    character->class->subClass = trackedMalloc(strlen(tempSubClass) + 1, MEMORY_ROSTER);
+
+    if (!character->class->subClass) {
+        fprintf(stderr, "Memory allocation failed!\n");
+        exit(EXIT_FAILURE);
+    }
+    
+    strcpy(character->class->subClass, tempSubClass);
+    printf("You selected: %s\n\n", character->class->subClass);
+}
+
+void selectBackground(struct Character *character){
+    int usersBackground;
+    int validInput = 0;
+
+    // Display background options
+    printf("Enter your character's background:\n");
+    for(int i = 0; i < 16; i++){
+        printf("%d. %s\n", i + 1, catalog->backgrounds[i]);
+    }
+
+    // Input validation loop
+    while(!validInput){
+        printf("Enter your Choice: ");
+        validInput = isValidInput(&usersBackground, 1, 16);  // Validate the input range
+    }
+
+    // Free existing memory for background if already allocated
+    if (character->background != NULL) {
+        trackedFree(character->background, MEMORY_ROSTER);
+    }
+
+    // Allocate memory and copy the selected background
+    character->background = trackedMalloc(strlen(catalog->backgrounds[usersBackground - 1]) + 1, MEMORY_ROSTER);
+    if (character->background == NULL) {
+        fprintf(stderr, "Memory allocation failed for background.\n");
+        exit(1);
+    }
+
+    strcpy(character->background, catalog->backgrounds[usersBackground - 1]);
+    printf("You selected: %s\n\n", character->background);
+}
+
+void selectRace(struct Character *character){
+    int usersRace;
+    int validInput = 0;
+
+    // Display race options
+    printf("Enter your characters race:\n");
+    for(int i = 0; i < 10; i++){
+        printf("%d. %s\n", i + 1, catalog->races[i]);
+    }
+
+    // Input validation loop
+    while(!validInput){
+        printf("Enter your Choice: ");
+        validInput = isValidInput(&usersRace, 1, 10);  // Validate the input range
+    }
+
+    // Free existing memory for background if already allocated
+    if (character->race != NULL) {
+        trackedFree(character->race, MEMORY_ROSTER);
+    }
+
+    // Allocate memory and copy the selected background
+    character->race = trackedMalloc(strlen(catalog->races[usersRace - 1]) + 1, MEMORY_ROSTER);
+    if (character->race == NULL) {
+        fprintf(stderr, "Memory allocation failed for background.\n");
+        exit(1);
+    }
+
+    strcpy(character->race, catalog->races[usersRace - 1]);
+    printf("You selected: %s\n\n", character->race);
+}
+
+void selectAlignment(struct Character *character){
+    int usersAlignment;
+    int validInput = 0;
+
+    // Display alignment options
+    printf("Enter your character's alignment:\n");
+    for (int i = 0; i < 9; i++) {
+        printf("%d. %s\n", i + 1, catalog->alignments[i]);
+    }
+
+    // Input validation loop
+    while(!validInput){
+        printf("Enter your Choice: ");
+        validInput = isValidInput(&usersAlignment, 1, 9);  // Validate the input range
+    }
+
+    // Free existing memory for background if already allocated
+    if (character->alignment != NULL) {
+        trackedFree(character->alignment, MEMORY_ROSTER);
+    }
+
+    // Allocate memory and copy the selected background
+    character->alignment = trackedMalloc(strlen(catalog->alignments[usersAlignment - 1]) + 1, MEMORY_ROSTER);
+    if (character->alignment == NULL) {
+        fprintf(stderr, "Memory allocation failed for background.\n");
+        exit(1);
+    }
+
+    strcpy(character->alignment, catalog->alignments[usersAlignment - 1]);
+    printf("You selected: %s\n\n", character->alignment);
+}
+
+void selectAttributes(struct Character *character){
+    int userChoice;
+
+    for(int i = 0; i < 6; i++){ 
+        int validInput = 0;
+        while(!validInput){
+            printf("Enter your character's %s value (8-20): ", catalog->attributes[i]);
+            validInput = isValidInput(&userChoice, 8, 20);  // Validate the input range
+        }
+        switch(i){
+            case 0: 
+                character->strength = userChoice;
+                break;
+            case 1: 
+                character->dexterity = userChoice;
+                break;
+            case 2: 
+                character->constitution = userChoice;
+                break;
+            case 3: 
+                character->intelligence = userChoice;
+                break;
+            case 4: 
+                character->wisdom = userChoice;
+                break;
+            case 5: 
+                character->charisma = userChoice;
+                break;
+            default: 
+                printf("Error in attribute selection.\n");
+                return;
+        }
+        printf("Your character has %d %s!\n", userChoice, catalog->attributes[i]);
+        validInput = 1;
+    }
+}
+    
+void selectArmor(struct Character *character) {
+    int usersArmor;
+    int validInput, strCheck = 0;
+        // Display armor menu
+        printf("Select Your Armor:\n");
+        printf("-------------------------------------------------------------------------------------\n");
+        printf("   %-22s |   %-6s |  %-3s | %-8s |    %-10s| %-15s\n", "Name", "Type", "AC", "Dex Mod.", "Stealth", "Requirements");
+        printf("-------------------------------------------------------------------------------------\n");
+        //prints armor from armors array
+        for ( int i = 0; i < 9; i++) {
+            printf("%d. %-22s |  %-7s |  %-3d |    %-5d | %-12s | %-15s\n", i + 1, catalog->armors[i].name, catalog->armors[i].type, catalog->armors[i].baseAC, calculateModifier(character->dexterity), armorStealth(&catalog->armors[i]), armorRequirement(&catalog->armors[i]));
+        }
+        for (int i = 9; i < 13; i++) {
+            printf("%d. %-21s |  %-7s |  %-3d |    %-5d | %-12s | %-15s\n", i + 1, catalog->armors[i].name, catalog->armors[i].type, catalog->armors[i].baseAC, calculateModifier(character->dexterity), armorStealth(&catalog->armors[i]), armorRequirement(&catalog->armors[i]));
+        }
+        printf("-------------------------------------------------------------------------------------\n");
+        
+        do {
+            printf("Enter your choice: ");
+            validInput = isValidInput(&usersArmor, 1, 13);  // Validate the input range
+            if (validInput) {  // Proceed only if the input is valid
+                const char *requirement = armorRequirement(&catalog->armors[usersArmor - 1]);
+
+                // Check strength requirement
+                if ((strcmp(requirement, "13 Strength") == 0 && character->strength < 13) || (strcmp(requirement, "15 Strength") == 0 && character->strength < 15)) {
+                    printf("\nYou do not have enough strength to wield this armor! Please try again.\n\n");
+                    strCheck = 0;  // Reset flag
+                } else {
+                    strCheck = 1;  // Strength requirement satisfied
+                }
+            }
+        } while (!validInput || !strCheck);
+
+    // Assign selected armor
+    character->armor = &catalog->armors[usersArmor - 1];
+    printf("You selected: %s\n\n", character->armor->name);
+}
+
+void selectWeapon(struct Character *character){
+    int usersWeapon;
+    int validInput = 0;
+
+        // Display weapon menu
+        printf("Select Your Weapon(s):\n");
+        printf("----------------------------------------------------------------------------------------------------------\n");
+        printf(" %-19s |      %-9s |   %-10s | %-8s |    %-5s    |    %-5s    | %-10s \n", "Name", "Type", "DMG type", "DMG dice", "Finesse", "Versitile", "Range");
+        printf("----------------------------------------------------------------------------------------------------------\n");
+        //prints weapons from the weapons array
+        for ( int i = 0; i < 9; i++) {
+            printf("%d.  %-16s |  %-13s |  %-11s |    %-5s |   %-5s |  %-6s  | %-10s \n", i + 1, catalog->weapons[i].name, catalog->weapons[i].type, catalog->weapons[i].damageType, catalog->weapons[i].damageDice, weaponFinesse(&catalog->weapons[i]), weaponVersatile(&catalog->weapons[i]), weaponRange(&catalog->weapons[i]));
+        }
+        for (int i = 9; i < 31; i++) {
+            printf("%d.  %-15s |  %-13s |  %-11s |    %-5s |   %-5s |  %-6s  | %-10s \n", i + 1, catalog->weapons[i].name, catalog->weapons[i].type, catalog->weapons[i].damageType, catalog->weapons[i].damageDice, weaponFinesse(&catalog->weapons[i]), weaponVersatile(&catalog->weapons[i]), weaponRange(&catalog->weapons[i]));
+        }
+        printf("----------------------------------------------------------------------------------------------------------\n");
+
+        while (!validInput){
+            printf("Enter your choice: ");
+            validInput = isValidInput(&usersWeapon, 1, 31);  // Validate the input range
+        }
+
+    // Assign selected armor
+    character->weapon = &catalog->weapons[usersWeapon - 1];
+    printf("You selected: %s\n\n", character->weapon->name);
+}
+
+void selectShield(struct Character *character){
+    int usersShield, validInput = 0; 
+
+    printf("Is your character holding a shield? (1: yes | 0: no)\n");
+    // Input validation loop
+    while(!validInput){
+        printf("Enter your Choice: ");
+        validInput = isValidInput(&usersShield, 0, 1);  // Validate the input range
+    }
+
+    character->hasShield = usersShield;
+
+    if(usersShield == 1){
+        printf("Your character is now holding a shield!\n\n");
+    }
+    else{
+        printf("Your character is not holding a shield!\n\n");
+    }
+}
+
+// Calculate functions
+// Returns the modifer associated with your character attribute
+int calculateModifier(int attribute){
+    return (attribute - 10) / 2;
+}
+
+// Returns your characters armor class number
+int calculateArmorClass(int dexterity, const char *armorName, int hasShield) {
+    int shieldBonus = hasShield ? 2 : 0;            // +2 AC if the character has a shield
+    int maxDex = 0;                                 // Default max dex modifier
+
+    // Find the armor in the armors array
+    struct Armor *selectedArmor = NULL;
+    for (int i = 0; i < 13; i++) {
+        if (strcmp(catalog->armors[i].name, armorName) == 0) {
+            selectedArmor = &catalog->armors[i];
+            break;
+        }
+    }
+    // If armor is not found, return a default value
+    if (!selectedArmor) {
+        printf("Invalid armor type: %s\n", armorName);
+        return 10; // Default unarmored AC
+    }
+
+    // Apply max dexterity bonus if required
+    if (selectedArmor->requiresDexCap == 1 && calculateModifier(dexterity) > selectedArmor->maxDexBonus) {
+        maxDex = selectedArmor->maxDexBonus;
+    }
+    if(selectedArmor->maxDexBonus == -1){
+        maxDex = calculateModifier(dexterity);
+    }
+    //if the armor is of "Heavy" type then AC gets 0 dexterity bonus
+    if(strcmp(selectedArmor->type, "Heavy") == 0){
+        maxDex = 0;
+    }
+
+    // Calculate the final AC
+    int armorClass = selectedArmor->baseAC + maxDex + shieldBonus;
+    return armorClass;
+}
+
+int calculateRollModifier(struct Character *head, char *diceCharacterName, int numChoice){
+    //check to see if list is empty
+    if(head == NULL){ 
+        return -1; //indicates error
+    }
+    //puts all characters modifiers in an array
+    int *attributes[] = {
+        &head->strength, &head->dexterity,
+        &head->constitution, &head->intelligence,
+        &head->wisdom, &head->charisma
+    };  
+    //checks to make sure the character entered exists
+    if (strcmp(head->name, diceCharacterName) != 0){
+        return -1; //not found -1 indicating error
+    }
+    //validates numChoice, anything else rolls without a modifier
+    int modifier = 0;
+    if(numChoice >= 1 && numChoice <= 6){
+        modifier = calculateModifier(*attributes[numChoice - 1]);
+    }
+    //returns the baseRoll + your character modifier of choice
+    auditBegin(AUDIT_ROLL_MODIFIER, head);
+    int roll = rollD20() + modifier;
+    auditEnd(modifier, roll);
+    return roll;
+}
+
+int calculateDamageRoll(struct Character *character, char *characterName) {
+    struct AttackAction action;
+    struct AttackResult result;
+
+    // Check if character or characterName is NULL
+    if (character == NULL || characterName == NULL) {
+        return -1; // Error case
+    }
+
+    // Check if the character name matches
+    if (strcmp(character->name, characterName) != 0) {
+        return -1; // Character name does not match
+    }
+
+    // The action picks the ability modifier and the versatile two-handed dice
+    if (buildAttackAction(character, 0, ROLL_NORMAL, &action) != 0) {
+        return -1; // Weapon is NULL or has unknown dice
+    }
+
+    // One ordinary hit: roll the damage dice without an attack roll
+    auditBegin(AUDIT_DAMAGE_ROLL, character);
+    result.damage = action.damageBonus;
+    for (int d = 0; d < action.damageCount; d++) {
+        result.damage += rollDie(action.damageSides);
+    }
+    // Like every hit resolved by resolveAttackAction, a hit deals at least 1
+    result.damage = result.damage > 1 ? result.damage : 1;
+    auditEnd(action.damageBonus, result.damage);
+
+    return result.damage; // Return damage dealt
+}
+
+int calculateAttackRoll(struct Character *character, char *characterName){
+    struct AttackAction action;
+    struct AttackResult result;
+
+    if (character == NULL || characterName == NULL || character->weapon == NULL) {
+        return -1; // Error case
+    }
+    if (buildAttackAction(character, 0, ROLL_NORMAL, &action) != 0) {
+        return -1;
+    }
+
+    // A single attack, returning the roll plus modifier and proficiency
+    action.attacks = 1;
+    auditBegin(AUDIT_ATTACK_ROLL, character);
+    resolveAttackAction(&action, NULL, &result);
+    auditEnd(action.attackBonus, result.rolls[0].total);
+    return result.rolls[0].total;
+}
+
+int calculateHealth(struct Character *character){
+
+    if (!character || !character->class || !character->class->name) {
+        printf("Error: Invalid character or class data.\n");
+        return -1; // Error
+    }
+
+    if (character->class->progression == NULL) {
+        initializeHitDie(character);
+    }
+    struct ClassProgression *progression = character->class->progression;
+    if (progression == NULL || character->level < 1 || character->level > MAX_LEVEL) {
+        printf("Error: No hit die for class '%s' at level %d.\n", character->class->name, character->level);
+        return -1; // Error
+    }
+
+    // Base HP comes from the table, Constitution adds its modifier once per level
+    return progression->baseHP[character->level] + calculateModifier(character->constitution) * character->level;
+}
+
+int calculateProficiencyModifier(struct Character *character){
+    if (character->class != NULL && character->class->progression == NULL && character->class->name != NULL) {
+        initializeHitDie(character);
+    }
+    if (character->class != NULL && character->class->progression != NULL && character->level >= 1 && character->level <= MAX_LEVEL) {
+        return character->class->progression->proficiency[character->level];
+    }
+    return ((character->level - 1) / 4) + 2;
+}
+
+// Display functions
+void addCharacter(struct Character **newChar){
+    TRACE_SPAN("Add a character", "menu");
+    int userCurrLevel;
+    //make space for new character in memory
+    struct Character *newCharacter = trackedMalloc(sizeof(struct Character), MEMORY_ROSTER);
+    if (newCharacter == NULL){
+        printf("Failed to allocate memory :(\n");
+        exit(1);
+    }
+    newCharacter->rollStats = NULL;
+    newCharacter->history = NULL;
+
+    newCharacter->class = trackedMalloc(sizeof(struct Class), MEMORY_ROSTER);
+    if (newCharacter->class == NULL) {
+        printf("Failed to allocate memory for class.\n");
+        trackedFree(newCharacter, MEMORY_ROSTER);
+        exit(1);
+    }
+
+    // Armor and weapon point into the catalog once they are selected
+    newCharacter->armor = NULL;
+    newCharacter->weapon = NULL;
+    newCharacter->background = NULL;
+    newCharacter->race = NULL;
+    newCharacter->alignment = NULL;
+    newCharacter->level = 1; // Default level
+    newCharacter->hasShield = 0; // Default to no shield
+    newCharacter->speed = 30;
+    newCharacter->proficiencyModifier = 0;
+    newCharacter->HP = 0;
+    newCharacter->isLoaded = 1;
+    newCharacter->lastUsed = 0;
+    loadedCharacterCount++;
+
+    //prompt user to enter details for character
+    printf("For more information regarding DnD character details visit DnD Beyond\n\n");
+
+    // Calls the select functions to gather information about your character
+    selectName(*newChar, newCharacter);
+    userCurrLevel = selectLevel(newCharacter);
+    selectClass(newCharacter); 
+    selectSubClass(newCharacter);
+    selectBackground(newCharacter);
+    selectRace(newCharacter);
+    selectAlignment(newCharacter);
+    selectAttributes(newCharacter);
+    selectArmor(newCharacter);
+    selectWeapon(newCharacter);
+    selectShield(newCharacter);
+    newCharacter->proficiencyModifier = calculateProficiencyModifier(newCharacter);
+    newCharacter->HP = calculateHealth(newCharacter);
+    newCharacter->id = nextCharacterId++;
+    //inserts the new character at the beginning of the list
+    newCharacter->next = *newChar;
+    *newChar = newCharacter;
+    nameFilterAdd(*newChar, newCharacter->name);
+
+    // Write character details to its roster file and add it to index.txt
+    if (saveCharacter(newCharacter) == 0) {
+        printf("Character data successfully saved.\n\n");
+        appendIndexEntry(newCharacter);
+    }
+}
+
+void displayCharacter(struct Character *character){
+    TRACE_SPAN("Display all characters", "menu");
+
+    //check to see if list is empty
+    if(character == NULL){ 
+        printf("\nNo characters in the list...\n");
+        printf("Please enter a character first\n\n");
+        return;
+    }
+
+    //displays all charcters
+    printf("List of characters:\n\n");
+    while(character != NULL){
+        if (ensureLoaded(character) != 0) {
+            character = character->next;
+            continue;
+        }
+        printf("    ___________ Name: %s ___________\n\n", character->name);
+        printf("Class: %s   Level: %d   Background: %s\n\n", character->class->name, character->level, character->background);                                    //displays Class, Level, Background
+        printf("Sub Class: %s   Race: %s    Alignment: %s\n\n", character->class->subClass, character->race, character->alignment);                                                                //displays Race, Alignment
+        printf("Armor: %s   Armor Class: %d     Weapon: %s\n\n", character->armor->name, calculateArmorClass(character->dexterity, character->armor->name, character->hasShield), character->weapon->name);   //displays Armor, Armor Class, Weapon
+        printf("Total HP: %d    Proficiency Modifier: %d\n\n", character->HP, character->proficiencyModifier);
+        printf("Strength\nAbility Score: %d\nModifier: %d\n\n", character->strength, calculateModifier(character->strength));                          //displays Strength
+        printf("Dexterity\nAbility Score: %d\nModifier: %d\n\n", character->dexterity, calculateModifier(character->dexterity));                       //displays Dexterity 
+        printf("Constitution\nAbility Score: %d\nModifier: %d\n\n", character->constitution, calculateModifier(character->constitution));              //displays Constitution
+        printf("Intelligence\nAbility Score: %d\nModifier: %d\n\n", character->intelligence, calculateModifier(character->intelligence));              //displays Intelligence
+        printf("Wisdom\nAbility Score: %d\nModifier: %d\n\n", character->wisdom, calculateModifier(character->wisdom));                                //displays Wisdom
+        printf("Charisma\nAbility Score: %d\nModifier: %d\n\n", character->charisma, calculateModifier(character->charisma));                          //displays Charisma
+        character = character->next;
+    }
+}
+
+//Searches for a character by name
+void searchCharacter(struct Character *character, char *searchCharacterName){
+    TRACE_SPAN("Search for a character", "menu");
+    int ifFound = 0;
+
+    // Most misses are answered by the name filter without walking the roster
+    if (!nameFilterContains(searchCharacterName)) {
+        character = NULL;
+    }
+    while(character != NULL){
+        if (strcmp(character->name, searchCharacterName) == 0 && ensureLoaded(character) == 0){
+            printf("\n    ___________ Name: %s ___________\n\n", character->name);
+            printf("Class: %s   Level: %d   Background: %s\n\n", character->class->name, character->level, character->background);                                    //displays Class, Level, Background
+            printf("Sub Class: %s   Race: %s    Alignment: %s\n\n", character->class->subClass, character->race, character->alignment);                                                                //displays Race, Alignment
+            printf("Armor: %s   Armor Class: %d     Weapon: %s\n\n", character->armor->name, calculateArmorClass(character->dexterity, character->armor->name, character->hasShield), character->weapon->name);   //displays Armor, Armor Class, Weapon
+            printf("Total HP: %d    Proficiency Modifier: %d\n\n", character->HP, character->proficiencyModifier);
+            printf("Strength\nAbility Score: %d\nModifier: %d\n\n", character->strength, calculateModifier(character->strength));                          //displays Strength
+            printf("Dexterity\nAbility Score: %d\nModifier: %d\n\n", character->dexterity, calculateModifier(character->dexterity));                       //displays Dexterity 
+            printf("Constitution\nAbility Score: %d\nModifier: %d\n\n", character->constitution, calculateModifier(character->constitution));              //displays Constitution
+            printf("Intelligence\nAbility Score: %d\nModifier: %d\n\n", character->intelligence, calculateModifier(character->intelligence));              //displays Intelligence
+            printf("Wisdom\nAbility Score: %d\nModifier: %d\n\n", character->wisdom, calculateModifier(character->wisdom));                                //displays Wisdom
+            printf("Charisma\nAbility Score: %d\nModifier: %d\n\n", character->charisma, calculateModifier(character->charisma));
+            ifFound = 1;
+            break;
+        }
+        character = character->next;
+    }
+
+    if(ifFound != 1){
+        printf("\nYour character could not found :(\n\n");
+    }
+}
+
+//Updates details of your character
+void updateCharacter(struct Character *updatedCharacter, char *updateCharacterName){
+    TRACE_SPAN("Update a character", "menu");
+
+    while (updatedCharacter != NULL){
+        if (strcmp(updatedCharacter->name, updateCharacterName) == 0 && ensureLoaded(updatedCharacter) == 0){
+            int choice;
+            printf("Found character: %s\n", updateCharacterName);
+            printf("Choose which part of your character you want to update:\n");
+            beginHistory(updatedCharacter);
+
+            do {
+                printf("\n1. Level\n2. Class\n3. Subclass\n4. Background\n5. Race\n6. Alignment\n7. Attributes\n8. Armor\n9. Weapon\n10. Shield\n");
+                printf("11. Undo\n12. Redo\n13. History\n14. Save and Exit\n");
+                printf("Enter your choice: ");
+                scanf("%d", &choice);
+
+                switch (choice) {
+                    case 1:
+                        selectLevel(updatedCharacter);
+                        if(strcmp(updatedCharacter->class->subClass, "N/A") == 0 && updatedCharacter->level >= subClassUnlockLevel(updatedCharacter)){
+                            selectSubClass(updatedCharacter);
+                        }
+                        if(updatedCharacter->level < subClassUnlockLevel(updatedCharacter)){
+                            selectSubClass(updatedCharacter);
+                        }
+                        updatedCharacter->HP = calculateHealth(updatedCharacter);
+                        updatedCharacter->proficiencyModifier = calculateProficiencyModifier(updatedCharacter);
+                        break;
+                    case 2:
+                        selectClass(updatedCharacter);
+                        selectSubClass(updatedCharacter);
+                        break;
+                    case 3:
+                        selectSubClass(updatedCharacter);
+                        break;
+                    case 4:
+                        selectBackground(updatedCharacter);
+                        break;
+                    case 5:
+                        selectRace(updatedCharacter);
+                        break;
+                    case 6:
+                        selectAlignment(updatedCharacter);
+                        break;
+                    case 7:
+                        selectAttributes(updatedCharacter);
+                        break;
+                    case 8:
+                        selectArmor(updatedCharacter);
+                        break;
+                    case 9:
+                        selectWeapon(updatedCharacter);
+                        break;
+                    case 10:
+                        selectShield(updatedCharacter);
+                        break;
+                    case 11:
+                        if (undoVersion(updatedCharacter) == 0) {
+                            printf("Undone, %s is back at version %d.\n", updatedCharacter->name, updatedCharacter->history->current + 1);
+                        }
+                        else {
+                            printf("Nothing to undo.\n");
+                        }
+                        break;
+                    case 12:
+                        if (redoVersion(updatedCharacter) == 0) {
+                            printf("Redone, %s is at version %d.\n", updatedCharacter->name, updatedCharacter->history->current + 1);
+                        }
+                        else {
+                            printf("Nothing to redo.\n");
+                        }
+                        break;
+                    case 13:
+                        historyMenu(updatedCharacter);
+                        break;
+                    case 14:
+                        printf("Exiting update menu...\n");
+                        break;
+                    default:
+                        printf("Invalid choice. Please try again.\n");
+                }
+                // Every change becomes a new version
+                if (choice >= 1 && choice <= 10) {
+                    recordVersion(updatedCharacter);
+                }
+            } while (choice != 14);
+
+            // Update the roster file for the character
+            if (saveCharacter(updatedCharacter) != 0) {
+                printf("Failed to update the file for character: %s\n", updateCharacterName);
+                return;
+            }
+            printf("Character data successfully saved.\n\n");
+            return;
+        }
+        updatedCharacter = updatedCharacter->next;
+    }
+
+    printf("Character could not be found :( \n\n");
+}
+
+//Deletes a character from the list
+void deleteCharacter(struct Character **character, char *deleteCharacterName){
+    TRACE_SPAN("Delete a character", "menu");
+    struct Character *prev = NULL;
+    struct Character *temp = *character;
+    int userChoice;
+    int validInput = 0;
+
+    // Find the character in the list
+    while(temp != NULL && strcmp(temp->name, deleteCharacterName) != 0){
+        prev = temp;
+        temp = temp->next;
+    }
+
+    // If character not found
+    if(temp == NULL){
+        printf("Your character could not be found :(\n\n");
+        return;
+    }
+
+    printf("Are you sure you want to delete '%s'?\n", temp->name);
+    printf("1. Yes\n");
+    printf("2. No\n");
+
+    while(!validInput){
+        printf("Enter your choice: ");
+        scanf("%d", &userChoice);
+
+        if(userChoice == 1 || userChoice == 2){
+            validInput = 1;
+        } else {
+            printf("Invalid choice, please try again...\n\n");
+        }
+    }
+
+    if(userChoice == 2){
+        printf("\nDeletion canceled. '%s' was not deleted.\n\n", temp->name);
+        return;
+    }
+
+    // Delete the character's roster file (memory-only generated characters never had one)
+    int deletedId = temp->id;
+    if (deletedId > 0) {
+        if(deleteCharacterFile(deletedId) == 0){
+            printf("File for '%s' has been deleted.\n", temp->name);
+        } else {
+            printf("Error deleting file for '%s'.\n", temp->name);
+        }
+    }
+
+    // Remove the character from the linked list
+    if(prev == NULL){
+        *character = temp->next;  // The character is at the head of the list
+    } else {
+        prev->next = temp->next;  // Bypass the character to remove it
+    }
+
+    // Free the memory occupied by the character
+    nameFilterRemove(temp->name);
+    if (temp->isLoaded) {
+        loadedCharacterCount--;
+    }
+    freeCharacter(temp);
+
+    // Update the index.txt file
+    if (deletedId > 0) {
+        removeIndexEntry(deletedId);
+    }
+
+    printf("\nYour character has been deleted...\n\n");
+}
+
+void levelUpCharacter(struct Character *character, char *levelCharacterName){
+    TRACE_SPAN("Level up a character", "menu");
+    int userChoice;
+    int validInput = 0;
+    character = findCharacter(character, levelCharacterName);
+    if (character != NULL){
+        printf("Are you sure you want to level up '%s'?\n", character->name);
+        printf("1. Yes\n");
+        printf("2. No\n");
+        
+        while(!validInput){
+            printf("Enter your Choice: ");
+            scanf("%d", &userChoice);
+
+            if(userChoice != 1 && userChoice != 2) {
+                printf("Invalid choice, please try again...\n\n");
+            } 
+            else{
+                validInput = 1;
+            }
+        }
+    if(userChoice == 1){
+        beginHistory(character);
+        character->level++;
+        printf("\n'%s' has leveled up! New level: %d\n\n", character->name, character->level);
+        character->HP = calculateHealth(character);
+        if(character->level == subClassUnlockLevel(character)){
+            printf("You have reached level %d! It's time to choose a subclass for '%s'.\n", character->level, character->name);
+            selectSubClass(character);
+        }
+        character->proficiencyModifier = calculateProficiencyModifier(character);
+        recordVersion(character);
+
+        // Update the character's roster file
+        if (saveCharacter(character) == 0) {
+            printf("Character data successfully saved.\n\n");
+        }
+        return;
+    }
+    }
+    else {
+        printf("Error: Character not found...\n\n");
+    }
+}
+
+// Dice rolling functions
+//generates a random number between 1 & 20
+int rollD20(void){
+    auditBegin(AUDIT_ROLL_D20, rollingCharacter);
+    int roll = rollDie(20);
+    auditEnd(0, roll);
+    return roll;
+}
+//generates a random number between 1 & 12
+int rollD12(void){
+    return rollDie(12);
+}
+//generates a random number between 1 & 10
+int rollD10(void){
+    return rollDie(10);
+}
+//generates a random number between 1 & 8
+int rollD8(void){
+    return rollDie(8);
+}
+//generates a random number between 1 & 6
+int rollD6(void){
+    return rollDie(6);
+}
+//generates a random number between 1 & 4
+int rollD4(void){
+    return rollDie(4);
+}
+// Parallel functions
+// Slice of a parallelFor range handed to one worker thread
+struct ParallelTask {
+    void (*work)(int begin, int end, void *arg);
+    void *arg;
+    int begin;
+    int end;
+    struct Catalog *catalog;  // Caller's epoch, which stays pinned until parallelFor returns
+};
+
+static void *parallelTaskRunner(void *taskArg) {
+    struct ParallelTask *task = taskArg;
+    catalog = task->catalog;
+    traceThreadName("parallelFor worker");
+    TRACE_SPAN("parallelFor slice", "parallel");
+    task->work(task->begin, task->end, task->arg);
+    return NULL;
+}
+
+int workerThreadCount(void) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1) {
+        return 1;
+    }
+    return cpus > 64 ? 64 : (int)cpus;
+}
+
+void parallelFor(int count, void (*work)(int begin, int end, void *arg), void *arg) {
+    int threadCount = workerThreadCount();
+
+    if (count <= 0) {
+        return;
+    }
+    if (threadCount > count) {
+        threadCount = count;
+    }
+    // Small ranges are not worth the thread start up cost
+    if (threadCount == 1 || count < 64) {
+        TRACE_SPAN("parallelFor slice", "parallel");
+        work(0, count, arg);
+        return;
+    }
+
+    pthread_t threads[64];
+    struct ParallelTask tasks[64];
+    int chunk = (count + threadCount - 1) / threadCount;
+    int started = 0;
+
+    for (int i = 0; i < threadCount; i++) {
+        tasks[i].work = work;
+        tasks[i].arg = arg;
+        tasks[i].catalog = catalog;
+        tasks[i].begin = i * chunk;
+        tasks[i].end = (i + 1) * chunk < count ? (i + 1) * chunk : count;
+        if (tasks[i].begin >= tasks[i].end) {
+            break;
+        }
+        // Run the slice on this thread if a worker could not be started
+        if (pthread_create(&threads[i], NULL, parallelTaskRunner, &tasks[i]) != 0) {
+            TRACE_SPAN("parallelFor slice", "parallel");
+            work(tasks[i].begin, tasks[i].end, arg);
+            tasks[i].begin = tasks[i].end;
+        }
+        started = i + 1;
+    }
+
+    for (int i = 0; i < started; i++) {
+        if (tasks[i].begin < tasks[i].end) {
+            pthread_join(threads[i], NULL);
+        }
+    }
+}
+// Filter expression functions
+enum ExpressionType {
+    TYPE_NUMBER,
+    TYPE_STRING
+};
+
+// Every field an expression can name, numbers first
+enum ExpressionField {
+    FIELD_LEVEL, FIELD_STRENGTH, FIELD_DEXTERITY, FIELD_CONSTITUTION, FIELD_INTELLIGENCE, FIELD_WISDOM,
+    FIELD_CHARISMA, FIELD_SPEED, FIELD_ARMOR_CLASS, FIELD_HP, FIELD_PROFICIENCY, FIELD_SHIELD,
+    FIELD_ATTACK_BONUS, FIELD_ATTACKS, FIELD_CRIT_RANGE,
+    FIELD_ARMOR_BASE_AC, FIELD_ARMOR_MAX_DEX_BONUS, FIELD_ARMOR_STEALTH_DISADVANTAGE,
+    FIELD_WEAPON_FINESSE, FIELD_WEAPON_VERSATILE, FIELD_WEAPON_TWO_HANDED, FIELD_WEAPON_LIGHT,
+    FIELD_WEAPON_HEAVY, FIELD_WEAPON_REACH, FIELD_WEAPON_RANGE,
+    FIELD_NAME, FIELD_CLASS, FIELD_SUBCLASS, FIELD_BACKGROUND, FIELD_RACE, FIELD_ALIGNMENT,
+    FIELD_ARMOR_NAME, FIELD_ARMOR_TYPE, FIELD_WEAPON_NAME, FIELD_WEAPON_TYPE, FIELD_WEAPON_DAMAGE_TYPE,
+    FIELD_WEAPON_DAMAGE_DICE
+};
+
+static const struct {
+    const char *name;
+    enum ExpressionField field;
+} expressionFields[] = {
+    { "level", FIELD_LEVEL }, { "strength", FIELD_STRENGTH }, { "dexterity", FIELD_DEXTERITY },
+    { "constitution", FIELD_CONSTITUTION }, { "intelligence", FIELD_INTELLIGENCE }, { "wisdom", FIELD_WISDOM },
+    { "charisma", FIELD_CHARISMA }, { "speed", FIELD_SPEED }, { "armorClass", FIELD_ARMOR_CLASS },
+    { "hp", FIELD_HP }, { "proficiency", FIELD_PROFICIENCY }, { "shield", FIELD_SHIELD },
+    { "attackBonus", FIELD_ATTACK_BONUS }, { "attacks", FIELD_ATTACKS }, { "critRange", FIELD_CRIT_RANGE },
+    { "armor.baseAC", FIELD_ARMOR_BASE_AC }, { "armor.maxDexBonus", FIELD_ARMOR_MAX_DEX_BONUS },
+    { "armor.stealthDisadvantage", FIELD_ARMOR_STEALTH_DISADVANTAGE },
+    { "weapon.finesse", FIELD_WEAPON_FINESSE }, { "weapon.versatile", FIELD_WEAPON_VERSATILE },
+    { "weapon.twoHanded", FIELD_WEAPON_TWO_HANDED }, { "weapon.light", FIELD_WEAPON_LIGHT },
+    { "weapon.heavy", FIELD_WEAPON_HEAVY }, { "weapon.reach", FIELD_WEAPON_REACH }, { "weapon.range", FIELD_WEAPON_RANGE },
+    { "name", FIELD_NAME }, { "class", FIELD_CLASS }, { "subclass", FIELD_SUBCLASS },
+    { "background", FIELD_BACKGROUND }, { "race", FIELD_RACE }, { "alignment", FIELD_ALIGNMENT },
+    { "armor.name", FIELD_ARMOR_NAME }, { "armor.type", FIELD_ARMOR_TYPE }, { "weapon.name", FIELD_WEAPON_NAME },
+    { "weapon.type", FIELD_WEAPON_TYPE }, { "weapon.damageType", FIELD_WEAPON_DAMAGE_TYPE },
+    { "weapon.damageDice", FIELD_WEAPON_DAMAGE_DICE }
+};
+#define EXPRESSION_FIELD_COUNT ((int)(sizeof(expressionFields) / sizeof(expressionFields[0])))
+
+static enum ExpressionType fieldType(enum ExpressionField field) {
+    return field >= FIELD_NAME ? TYPE_STRING : TYPE_NUMBER;
+}
+
+// The Armor Class a character has with their current equipment (armorClass itself is not kept up to date)
+static int equippedArmorClass(struct Character *character) {
+    if (character->armor != NULL) {
+        return calculateArmorClass(character->dexterity, character->armor->name, character->hasShield);
+    }
+    return 10 + calculateModifier(character->dexterity) + (character->hasShield ? 2 : 0);
+}
+
+// Characters without armor or a weapon read 0 for those fields
+static int numberField(struct Character *character, int field) {
+    struct Armor *armor = character->armor;
+    struct Weapon *weapon = character->weapon;
+
+    switch (field) {
+        case FIELD_LEVEL:          return character->level;
+        case FIELD_STRENGTH:       return character->strength;
+        case FIELD_DEXTERITY:      return character->dexterity;
+        case FIELD_CONSTITUTION:   return character->constitution;
+        case FIELD_INTELLIGENCE:   return character->intelligence;
+        case FIELD_WISDOM:         return character->wisdom;
+        case FIELD_CHARISMA:       return character->charisma;
+        case FIELD_SPEED:          return character->speed;
+        case FIELD_ARMOR_CLASS:    return equippedArmorClass(character);
+        case FIELD_HP:             return character->HP;
+        case FIELD_PROFICIENCY:    return character->proficiencyModifier;
+        case FIELD_SHIELD:         return character->hasShield;
+        case FIELD_ATTACK_BONUS:   return weapon ? weaponAbilityModifier(character, weapon) + character->proficiencyModifier : 0;
+        case FIELD_ATTACKS:        return attacksPerAction(character);
+        case FIELD_CRIT_RANGE:     return criticalRange(character);
+        case FIELD_ARMOR_BASE_AC:  return armor ? armor->baseAC : 0;
+        case FIELD_ARMOR_MAX_DEX_BONUS:          return armor ? armor->maxDexBonus : 0;
+        case FIELD_ARMOR_STEALTH_DISADVANTAGE:   return armor ? armor->stealthDisadvantage : 0;
+        case FIELD_WEAPON_FINESSE:     return weapon ? weapon->isFinesse : 0;
+        case FIELD_WEAPON_VERSATILE:   return weapon ? weapon->isVersatile : 0;
+        case FIELD_WEAPON_TWO_HANDED:  return weapon ? weapon->isTwoHanded : 0;
+        case FIELD_WEAPON_LIGHT:       return weapon ? weapon->isLight : 0;
+        case FIELD_WEAPON_HEAVY:       return weapon ? weapon->isHeavy : 0;
+        case FIELD_WEAPON_REACH:       return weapon ? weapon->isReach : 0;
+        case FIELD_WEAPON_RANGE:       return weapon ? weapon->range[1] : 0;
+        default:                       return 0;
+    }
+}
+
+// Characters without armor or a weapon read "" for those fields
+static const char *stringField(struct Character *character, int field) {
+    struct Armor *armor = character->armor;
+    struct Weapon *weapon = character->weapon;
+    const char *value;
+
+    switch (field) {
+        case FIELD_NAME:               value = character->name; break;
+        case FIELD_CLASS:              value = character->class->name; break;
+        case FIELD_SUBCLASS:           value = character->class->subClass; break;
+        case FIELD_BACKGROUND:         value = character->background; break;
+        case FIELD_RACE:               value = character->race; break;
+        case FIELD_ALIGNMENT:          value = character->alignment; break;
+        case FIELD_ARMOR_NAME:         value = armor ? armor->name : NULL; break;
+        case FIELD_ARMOR_TYPE:         value = armor ? armor->type : NULL; break;
+        case FIELD_WEAPON_NAME:        value = weapon ? weapon->name : NULL; break;
+        case FIELD_WEAPON_TYPE:        value = weapon ? weapon->type : NULL; break;
+        case FIELD_WEAPON_DAMAGE_TYPE: value = weapon ? weapon->damageType : NULL; break;
+        case FIELD_WEAPON_DAMAGE_DICE: value = weapon ? weapon->damageDice : NULL; break;
+        default:                       value = NULL; break;
+    }
+    return value != NULL ? value : "";
+}
+
+static int compareResult(int compare, int difference) {
+    switch (compare) {
+        case COMPARE_EQUAL:         return difference == 0;
+        case COMPARE_NOT_EQUAL:     return difference != 0;
+        case COMPARE_LESS:          return difference < 0;
+        case COMPARE_LESS_EQUAL:    return difference <= 0;
+        case COMPARE_GREATER:       return difference > 0;
+        default:                    return difference >= 0;
+    }
+}
+
+void printFilterFields(void) {
+    printf("\nNumbers:");
+    for (int i = 0; i < EXPRESSION_FIELD_COUNT; i++) {
+        if (fieldType(expressionFields[i].field) == TYPE_NUMBER) {
+            printf(" %s", expressionFields[i].name);
+        }
+    }
+    printf("\nStrings:");
+    for (int i = 0; i < EXPRESSION_FIELD_COUNT; i++) {
+        if (fieldType(expressionFields[i].field) == TYPE_STRING) {
+            printf(" %s", expressionFields[i].name);
+        }
+    }
+    printf("\nOperators: == != < <= > >= && || ! ( )   Strings go in quotes and compare without regard to case.\n\n");
+}
+
+// Compiler state: a recursive descent parser over source that emits straight into the program
+struct ExpressionCompiler {
+    const char *source;
+    const char *at;           // Next character to read
+    struct FilterExpression *expression;
+    int depth;                // Values on the stack at this point of the program
+    char *message;
+    size_t messageSize;
+    int failed;
+};
+
+// The operand most recently parsed, kept back so a comparison with a literal can become one instruction
+struct ExpressionOperand {
+    enum ExpressionType type;
+    int isField;              // 1 if the operand is a field that has not been emitted yet
+    int isLiteral;            // 1 if the operand is a literal that has not been emitted yet
+    int field;
+    int value;                // Number, or offset of the string in strings
+};
+
+static void compileError(struct ExpressionCompiler *compiler, const char *reason) {
+    if (!compiler->failed) {
+        snprintf(compiler->message, compiler->messageSize, "%s at column %d.", reason, (int)(compiler->at - compiler->source) + 1);
+        compiler->failed = 1;
+    }
+}
+
+static void skipSpaces(struct ExpressionCompiler *compiler) {
+    while (isspace((unsigned char)*compiler->at)) {
+        compiler->at++;
+    }
+}
+
+// Consumes token if it comes next
+static int acceptToken(struct ExpressionCompiler *compiler, const char *token) {
+    skipSpaces(compiler);
+    size_t length = strlen(token);
+    if (strncmp(compiler->at, token, length) != 0) {
+        return 0;
+    }
+    // "<" is not the start of "<=", nor "!" of "!="
+    if (length == 1 && (token[0] == '<' || token[0] == '>' || token[0] == '!') && compiler->at[1] == '=') {
+        return 0;
+    }
+    compiler->at += length;
+    return 1;
+}
+
+static int emit(struct ExpressionCompiler *compiler, int op, int compare, int field, int operand, int stackChange) {
+    struct FilterExpression *expression = compiler->expression;
+    if (expression->length == EXPRESSION_MAX_CODE) {
+        compileError(compiler, "Expression is too long");
+        return 0;
+    }
+    compiler->depth += stackChange;
+    if (compiler->depth > EXPRESSION_STACK_SIZE) {
+        compileError(compiler, "Expression is nested too deeply");
+    }
+
+    struct ExpressionInstruction *instruction = &expression->code[expression->length];
+    instruction->op = (unsigned char)op;
+    instruction->compare = (unsigned char)compare;
+    instruction->field = (short)field;
+    instruction->operand = operand;
+    return expression->length++;
+}
+
+// Emits an operand that was held back for a possible fused comparison
+static void emitOperand(struct ExpressionCompiler *compiler, struct ExpressionOperand *operand) {
+    if (operand->isField) {
+        emit(compiler, operand->type == TYPE_NUMBER ? OP_NUMBER_FIELD : OP_STRING_FIELD, 0, operand->field, 0, 1);
+    }
+    else if (operand->isLiteral) {
+        emit(compiler, operand->type == TYPE_NUMBER ? OP_PUSH_NUMBER : OP_PUSH_STRING, 0, 0, operand->value, 1);
+    }
+    operand->isField = 0;
+    operand->isLiteral = 0;
+}
+
+static void compileOr(struct ExpressionCompiler *compiler);
+
+static void compileOperand(struct ExpressionCompiler *compiler, struct ExpressionOperand *operand) {
+    memset(operand, 0, sizeof(*operand));
+    skipSpaces(compiler);
+    const char *at = compiler->at;
+
+    if (acceptToken(compiler, "(")) {
+        compileOr(compiler);
+        if (!acceptToken(compiler, ")")) {
+            compileError(compiler, "Expected ')'");
+        }
+        operand->type = TYPE_NUMBER;
+    }
+    else if (*at == '"' || *at == '\'') {
+        struct FilterExpression *expression = compiler->expression;
+        const char *end = strchr(at + 1, *at);
+        if (end == NULL) {
+            compileError(compiler, "Unterminated string");
+            return;
+        }
+        int length = (int)(end - at - 1);
+        if (expression->stringsUsed + length + 1 > EXPRESSION_MAX_STRINGS) {
+            compileError(compiler, "Too much quoted text");
+            return;
+        }
+        operand->type = TYPE_STRING;
+        operand->isLiteral = 1;
+        operand->value = expression->stringsUsed;
+        memcpy(expression->strings + expression->stringsUsed, at + 1, length);
+        expression->strings[expression->stringsUsed + length] = '\0';
+        expression->stringsUsed += length + 1;
+        compiler->at = end + 1;
+    }
+    else if (isdigit((unsigned char)*at) || (*at == '-' && isdigit((unsigned char)at[1]))) {
+        char *end;
+        long value = strtol(at, &end, 10);
+        if (value < -1000000000L || value > 1000000000L) {
+            compileError(compiler, "Number is out of range");
+            return;
+        }
+        operand->type = TYPE_NUMBER;
+        operand->isLiteral = 1;
+        operand->value = (int)value;
+        compiler->at = end;
+    }
+    else if (isalpha((unsigned char)*at)) {
+        const char *end = at;
+        while (isalnum((unsigned char)*end) || *end == '.' || *end == '_') {
+            end++;
+        }
+        for (int i = 0; i < EXPRESSION_FIELD_COUNT; i++) {
+            if (strlen(expressionFields[i].name) == (size_t)(end - at) && strncmp(expressionFields[i].name, at, end - at) == 0) {
+                operand->type = fieldType(expressionFields[i].field);
+                operand->isField = 1;
+                operand->field = expressionFields[i].field;
+                compiler->at = end;
+                return;
+            }
+        }
+        compileError(compiler, "Unknown field");
+    }
+    else {
+        compileError(compiler, "Expected a field, number or quoted string");
+    }
+}
+
+static void compileComparison(struct ExpressionCompiler *compiler) {
+    static const struct {
+        const char *token;
+        enum ExpressionCompare compare;
+        enum ExpressionCompare mirrored;    // Same test with the operands swapped
+    } operators[] = {
+        { "==", COMPARE_EQUAL, COMPARE_EQUAL }, { "!=", COMPARE_NOT_EQUAL, COMPARE_NOT_EQUAL },
+        { "<=", COMPARE_LESS_EQUAL, COMPARE_GREATER_EQUAL }, { ">=", COMPARE_GREATER_EQUAL, COMPARE_LESS_EQUAL },
+        { "<", COMPARE_LESS, COMPARE_GREATER }, { ">", COMPARE_GREATER, COMPARE_LESS }
+    };
+    struct ExpressionOperand left, right;
+
+    compileOperand(compiler, &left);
+    int which = -1;
+    for (int i = 0; i < 6 && which < 0; i++) {
+        if (acceptToken(compiler, operators[i].token)) {
+            which = i;
+        }
+    }
+    if (which < 0) {
+        if (left.type == TYPE_STRING) {
+            compileError(compiler, "A string has to be compared with something");
+        }
+        emitOperand(compiler, &left);
+        return;
+    }
+
+    // A parenthesized right side emits its own code, so the left side has to be on the stack first
+    const char *rightStart = compiler->at;
+    if (acceptToken(compiler, "(")) {
+        compiler->at = rightStart;
+        emitOperand(compiler, &left);
+    }
+    compileOperand(compiler, &right);
+    if (compiler->failed) {
+        return;
+    }
+    if (left.type != right.type) {
+        compiler->at = rightStart;
+        compileError(compiler, "Cannot compare a number with a string");
+        return;
+    }
+
+    int fusedOp = left.type == TYPE_NUMBER ? OP_NUMBER_FIELD_COMPARE : OP_STRING_FIELD_COMPARE;
+    if (left.isField && right.isLiteral) {
+        emit(compiler, fusedOp, operators[which].compare, left.field, right.value, 1);
+    }
+    else if (left.isLiteral && right.isField) {
+        emit(compiler, fusedOp, operators[which].mirrored, right.field, left.value, 1);
+    }
+    else {
+        emitOperand(compiler, &left);
+        emitOperand(compiler, &right);
+        emit(compiler, left.type == TYPE_NUMBER ? OP_COMPARE_NUMBERS : OP_COMPARE_STRINGS, operators[which].compare, 0, 0, -1);
+    }
+}
+
+static void compileUnary(struct ExpressionCompiler *compiler) {
+    if (acceptToken(compiler, "!")) {
+        compileUnary(compiler);
+        emit(compiler, OP_NOT, 0, 0, 0, 0);
+    }
+    else {
+        compileComparison(compiler);
+    }
+}
+
+// a && b && c: each jump leaves the false value as the result, otherwise drops it and tries the next
+static void compileAnd(struct ExpressionCompiler *compiler) {
+    int jumps[EXPRESSION_MAX_CODE], jumpCount = 0;
+
+    compileUnary(compiler);
+    while (!compiler->failed && acceptToken(compiler, "&&")) {
+        jumps[jumpCount++] = emit(compiler, OP_JUMP_IF_FALSE, 0, 0, 0, -1);
+        compileUnary(compiler);
+    }
+    for (int i = 0; i < jumpCount; i++) {
+        compiler->expression->code[jumps[i]].operand = compiler->expression->length;
+    }
+}
+
+static void compileOr(struct ExpressionCompiler *compiler) {
+    int jumps[EXPRESSION_MAX_CODE], jumpCount = 0;
+
+    compileAnd(compiler);
+    while (!compiler->failed && acceptToken(compiler, "||")) {
+        jumps[jumpCount++] = emit(compiler, OP_JUMP_IF_TRUE, 0, 0, 0, -1);
+        compileAnd(compiler);
+    }
+    for (int i = 0; i < jumpCount; i++) {
+        compiler->expression->code[jumps[i]].operand = compiler->expression->length;
+    }
+}
+
+int compileFilterExpression(const char *source, struct FilterExpression *expression, char *message, size_t messageSize) {
+    struct ExpressionCompiler compiler = { source, source, expression, 0, message, messageSize, 0 };
+
+    expression->length = 0;
+    expression->stringsUsed = 0;
+    snprintf(expression->source, sizeof(expression->source), "%s", source);
+
+    compileOr(&compiler);
+    skipSpaces(&compiler);
+    if (!compiler.failed && *compiler.at != '\0') {
+        compileError(&compiler, "Unexpected text");
+    }
+    if (compiler.failed) {
+        expression->length = 0;
+        return -1;
+    }
+    return 0;
+}
+
+int checkFilterExpressions(void) {
+    static const struct {
+        const char *source;
+        int expected;
+    } checks[] = {
+        { "level == 3", 1 }, { "3 == level", 1 }, { "level < 10", 1 }, { "10 < level", 0 },
+        { "level < strength", 1 }, { "strength < level", 0 }, { "1 < 2", 1 }, { "2 < 1", 0 },
+        // Parenthesized right sides, on their own and after a field or a literal
+        { "10 < (level)", 0 }, { "level < (10)", 1 }, { "level > (strength)", 0 }, { "strength > (level)", 1 },
+        { "(level) < 10", 1 }, { "(strength) < (level)", 0 }, { "level <= (level)", 1 }, { "strength >= (level < 10)", 1 },
+        { "!(level > 5) && strength == 10", 1 }, { "level > 5 || strength == 10", 1 }, { "level > 5 || strength != 10", 0 },
+        { "name == \"Check\"", 1 }, { "\"check\" == name", 1 }, { "name != \"Check\" || level == 3", 1 }
+    };
+    struct Character character;
+    struct FilterExpression expression;
+    char message[200];
+    int failures = 0;
+
+    memset(&character, 0, sizeof(character));
+    snprintf(character.name, sizeof(character.name), "Check");
+    character.level = 3;
+    character.strength = 10;
+
+    for (size_t i = 0; i < sizeof(checks) / sizeof(checks[0]); i++) {
+        if (compileFilterExpression(checks[i].source, &expression, message, sizeof(message)) != 0) {
+            printf("FAIL %-32s %s\n", checks[i].source, message);
+            failures++;
+        }
+        else if (evaluateFilterExpression(&expression, &character) != checks[i].expected) {
+            printf("FAIL %-32s should be %s\n", checks[i].source, checks[i].expected ? "true" : "false");
+            failures++;
+        }
+    }
+    printf("%d of %d expression checks passed.\n", (int)(sizeof(checks) / sizeof(checks[0])) - failures, (int)(sizeof(checks) / sizeof(checks[0])));
+    return failures;
+}
+
+int evaluateFilterExpression(const struct FilterExpression *expression, struct Character *character) {
+    int numbers[EXPRESSION_STACK_SIZE];
+    const char *strings[EXPRESSION_STACK_SIZE];
+    int top = -1;
+
+    for (int pc = 0; pc < expression->length; pc++) {
+        const struct ExpressionInstruction *instruction = &expression->code[pc];
+        switch (instruction->op) {
+            case OP_PUSH_NUMBER:
+                numbers[++top] = instruction->operand;
+                break;
+            case OP_PUSH_STRING:
+                strings[++top] = expression->strings + instruction->operand;
+                break;
+            case OP_NUMBER_FIELD:
+                numbers[++top] = numberField(character, instruction->field);
+                break;
+            case OP_STRING_FIELD:
+                strings[++top] = stringField(character, instruction->field);
+                break;
+            case OP_COMPARE_NUMBERS:
+                top--;
+                numbers[top] = compareResult(instruction->compare, (numbers[top] > numbers[top + 1]) - (numbers[top] < numbers[top + 1]));
+                break;
+            case OP_COMPARE_STRINGS:
+                top--;
+                numbers[top] = compareResult(instruction->compare, strcasecmp(strings[top], strings[top + 1]));
+                break;
+            case OP_NUMBER_FIELD_COMPARE: {
+                int value = numberField(character, instruction->field);
+                numbers[++top] = compareResult(instruction->compare, (value > instruction->operand) - (value < instruction->operand));
+                break;
+            }
+            case OP_STRING_FIELD_COMPARE:
+                numbers[++top] = compareResult(instruction->compare,
+                                               strcasecmp(stringField(character, instruction->field), expression->strings + instruction->operand));
+                break;
+            case OP_NOT:
+                numbers[top] = !numbers[top];
+                break;
+            case OP_JUMP_IF_FALSE:
+                if (numbers[top] == 0) {
+                    pc = instruction->operand - 1;
+                }
+                else {
+                    top--;
+                }
+                break;
+            case OP_JUMP_IF_TRUE:
+                if (numbers[top] != 0) {
+                    pc = instruction->operand - 1;
+                }
+                else {
+                    top--;
+                }
+                break;
+        }
+    }
+    return top >= 0 && numbers[top] != 0;
+}
+
+void readFilterExpression(struct FilterExpression *expression) {
+    char line[256], message[200];
+
+    expression->length = 0;
+    inputBuffer();
+    while (1) {
+        printf("Enter a filter expression (e.g. level >= 5 && armor.type == \"Light\"), or leave it blank: ");
+        if (fgets(line, sizeof(line), stdin) == NULL) {
+            return;
+        }
+        if (strchr(line, '\n') == NULL && !feof(stdin)) {
+            inputBuffer();
+            printf("That expression is too long.\n\n");
+            continue;
+        }
+        line[strcspn(line, "\n")] = '\0';
+
+        const char *start = line;
+        while (isspace((unsigned char)*start)) {
+            start++;
+        }
+        if (*start == '\0') {
+            return;
+        }
+        if (compileFilterExpression(start, expression, message, sizeof(message)) == 0) {
+            return;
+        }
+        printf("Error: %s\n\n", message);
+    }
+}
+
+// Bulk functions
+void selectCharacterFilter(struct CharacterFilter *filter) {
+    int userChoice;
+    int validInput = 0;
+
+    filter->className[0] = '\0';
+    filter->race[0] = '\0';
+
+    // Class filter
+    printf("Only include characters of class:\n");
+    printf("0. Any class\n");
+    for (int i = 0; i < 12; i++) {
+        printf("%d. %s\n", i + 1, catalog->classes[i][0]);
+    }
+    while (!validInput) {
+        printf("Enter your Choice: ");
+        validInput = isValidInput(&userChoice, 0, 12);
+    }
+    if (userChoice > 0) {
+        snprintf(filter->className, sizeof(filter->className), "%s", catalog->classes[userChoice - 1][0]);
+    }
+
+    // Race filter
+    validInput = 0;
+    printf("Only include characters of race:\n");
+    printf("0. Any race\n");
+    for (int i = 0; i < 10; i++) {
+        printf("%d. %s\n", i + 1, catalog->races[i]);
+    }
+    while (!validInput) {
+        printf("Enter your Choice: ");
+        validInput = isValidInput(&userChoice, 0, 10);
+    }
+    if (userChoice > 0) {
+        snprintf(filter->race, sizeof(filter->race), "%s", catalog->races[userChoice - 1]);
+    }
+
+    // Level range
+    validInput = 0;
+    while (!validInput) {
+        printf("Enter the lowest level to include (1-20): ");
+        validInput = isValidInput(&filter->minLevel, 1, 20);
+    }
+    validInput = 0;
+    while (!validInput) {
+        printf("Enter the highest level to include (%d-20): ", filter->minLevel);
+        validInput = isValidInput(&filter->maxLevel, filter->minLevel, 20);
+    }
+
+    readFilterExpression(&filter->expression);
+}
+
+int characterMatchesFilter(struct Character *character, struct CharacterFilter *filter) {
+    if (character->level < filter->minLevel || character->level > filter->maxLevel) {
+        return 0;
+    }
+    if (filter->className[0] != '\0' && strcmp(character->class->name, filter->className) != 0) {
+        return 0;
+    }
+    if (filter->race[0] != '\0' && strcmp(character->race, filter->race) != 0) {
+        return 0;
+    }
+    if (filter->expression.length > 0 && !evaluateFilterExpression(&filter->expression, character)) {
+        return 0;
+    }
+    return 1;
+}
+
+// Shared state for the filter workers
+struct FilterMatch {
+    struct Character **candidates;
+    struct CharacterFilter *filter;
+    unsigned char *matches;
+};
+
+static void filterMatchWorker(int begin, int end, void *arg) {
+    struct FilterMatch *match = arg;
+    for (int i = begin; i < end; i++) {
+        match->matches[i] = characterMatchesFilter(match->candidates[i], match->filter);
+    }
+}
+
+struct Character **collectMatchingCharacters(struct Character *head, struct CharacterFilter *filter, int *count) {
+    int capacity = 16;
+    struct Character **matches = trackedMalloc(capacity * sizeof(struct Character *), MEMORY_WORK);
+    if (matches == NULL) {
+        printf("Memory allocation failed.\n");
+        exit(1);
+    }
+
+    // Loading has to walk the list in order, the filter itself runs across worker threads
+    int candidates = 0;
+    for (struct Character *character = head; character != NULL; character = character->next) {
+        if (ensureLoaded(character) != 0) {
+            continue;
+        }
+        if (candidates == capacity) {
+            capacity *= 2;
+            struct Character **grown = trackedRealloc(matches, capacity * sizeof(struct Character *), MEMORY_WORK);
+            if (grown == NULL) {
+                printf("Memory allocation failed.\n");
+                exit(1);
+            }
+            matches = grown;
+        }
+        matches[candidates++] = character;
+    }
+
+    struct FilterMatch match = { matches, filter, trackedMalloc(candidates + 1, MEMORY_WORK) };
+    if (match.matches == NULL) {
+        printf("Memory allocation failed.\n");
+        exit(1);
+    }
+    parallelFor(candidates, filterMatchWorker, &match);
+
+    *count = 0;
+    for (int i = 0; i < candidates; i++) {
+        if (match.matches[i]) {
+            matches[(*count)++] = matches[i];
+        }
+    }
+    trackedFree(match.matches, MEMORY_WORK);
+    return matches;
+}
+
+void queryCharacters(struct Character *head, const char *source) {
+    TRACE_SPAN("queryCharacters", "roster");
+    struct CharacterFilter filter = { .className = "", .race = "", .minLevel = 1, .maxLevel = MAX_LEVEL };
+    char message[200];
+    int count;
+
+    if (compileFilterExpression(source, &filter.expression, message, sizeof(message)) != 0) {
+        printf("Error: %s\n\n", message);
+        return;
+    }
+
+    struct Character **matches = collectMatchingCharacters(head, &filter, &count);
+    int shown = count < 50 ? count : 50;
+    for (int i = 0; i < shown; i++) {
+        printf("%-24s Level %-2d %s (%s)\n", matches[i]->name, matches[i]->level, matches[i]->class->name, matches[i]->race);
+    }
+    if (shown < count) {
+        printf("... and %d more\n", count - shown);
+    }
+    printf("\n%d character(s) match %s\n\n", count, filter.expression.source);
+    trackedFree(matches, MEMORY_WORK);
+}
+
+void queryCharactersMenu(struct Character *head) {
+    TRACE_SPAN("Query characters", "menu");
+    struct FilterExpression expression;
+
+    printFilterFields();
+    readFilterExpression(&expression);
+    if (expression.length == 0) {
+        printf("\nNo expression given.\n\n");
+        return;
+    }
+    queryCharacters(head, expression.source);
+}
+
+// Shared state for the bulk level up workers
+struct BulkLevelUp {
+    struct Character **batch;
+    enum SubClassPolicy policy;
+    int *needsSubClass;       // Set to 1 for characters that reached their subclass level and still need a subclass
+};
+
+static void replaceString(char **field, const char *value) {
+    trackedFree(*field, MEMORY_ROSTER);
+    *field = trackedStrdup(value, MEMORY_ROSTER);
+    if (*field == NULL) {
+        fprintf(stderr, "Memory allocation failed!\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void bulkLevelUpWorker(int begin, int end, void *arg) {
+    struct BulkLevelUp *bulk = arg;
+
+    for (int i = begin; i < end; i++) {
+        struct Character *character = bulk->batch[i];
+
+        character->level++;
+        character->HP = calculateHealth(character);
+        character->proficiencyModifier = calculateProficiencyModifier(character);
+
+        if (character->level == subClassUnlockLevel(character) && strcmp(character->class->subClass, "N/A") == 0) {
+            if (bulk->policy == SUBCLASS_FIRST_OPTION) {
+                for (int j = 0; j < 12; j++) {
+                    if (strcmp(character->class->name, catalog->classes[j][0]) == 0) {
+                        replaceString(&character->class->subClass, catalog->classes[j][1]);
+                        break;
+                    }
+                }
+            }
+            else if (bulk->policy == SUBCLASS_PROMPT) {
+                bulk->needsSubClass[i] = 1;
+            }
+        }
+    }
+}
+
+void bulkLevelUpCharacters(struct Character *head) {
+    TRACE_SPAN("Bulk level up", "menu");
+    struct CharacterFilter filter;
+    int count, policy, userChoice;
+    int validInput = 0;
+
+    selectCharacterFilter(&filter);
+    // Level 20 characters cannot level up any further
+    if (filter.maxLevel > 19) {
+        filter.maxLevel = 19;
+    }
+
+    struct Character **batch = collectMatchingCharacters(head, &filter, &count);
+    if (count == 0) {
+        printf("\nNo characters match that filter.\n\n");
+        trackedFree(batch, MEMORY_WORK);
+        return;
+    }
+
+    printf("\nWhat should happen when a character reaches their subclass level without a subclass?\n");
+    printf("1. Leave the subclass unset\n");
+    printf("2. Assign the first subclass for their class\n");
+    printf("3. Ask me for each character\n");
+    while (!validInput) {
+        printf("Enter your Choice: ");
+        validInput = isValidInput(&policy, 1, 3);
+    }
+
+    printf("Are you sure you want to level up %d character(s)?\n", count);
+    printf("1. Yes\n");
+    printf("2. No\n");
+    validInput = 0;
+    while (!validInput) {
+        printf("Enter your Choice: ");
+        validInput = isValidInput(&userChoice, 1, 2);
+    }
+    if (userChoice == 2) {
+        printf("\nBulk level up canceled.\n\n");
+        trackedFree(batch, MEMORY_WORK);
+        return;
+    }
+
+    struct BulkLevelUp bulk;
+    bulk.batch = batch;
+    bulk.policy = policy;
+    bulk.needsSubClass = trackedCalloc(count, sizeof(int), MEMORY_WORK);
+    if (bulk.needsSubClass == NULL) {
+        printf("Memory allocation failed.\n");
+        exit(1);
+    }
+
+    beginHistories(batch, count);
+    parallelFor(count, bulkLevelUpWorker, &bulk);
+
+    // Subclass prompts have to happen one at a time on this thread
+    for (int i = 0; i < count; i++) {
+        if (bulk.needsSubClass[i]) {
+            printf("\n'%s' has reached level %d! It's time to choose a subclass.\n", batch[i]->name, batch[i]->level);
+            trackedFree(batch[i]->class->subClass, MEMORY_ROSTER);
+            batch[i]->class->subClass = NULL;
+            selectSubClass(batch[i]);
+        }
+    }
+
+    printf("\n%d character(s) have leveled up!\n", count);
+    recordVersions(batch, count);
+    writeCharactersToFiles(batch, count);
+
+    trackedFree(bulk.needsSubClass, MEMORY_WORK);
+    trackedFree(batch, MEMORY_WORK);
+}
+
+// Shared state for the bulk update workers
+struct BulkUpdate {
+    struct Character **batch;
+    enum BulkField field;
+    struct Character *values;  // Template character holding the new value
+    int attribute;             // Attribute index (0-5) for BULK_FIELD_ATTRIBUTE
+    int attributeValue;        // New score for BULK_FIELD_ATTRIBUTE
+    int *skipped;              // Set to 1 for characters the update could not be applied to
+};
+
+static void bulkUpdateWorker(int begin, int end, void *arg) {
+    struct BulkUpdate *bulk = arg;
+
+    for (int i = begin; i < end; i++) {
+        struct Character *character = bulk->batch[i];
+
+        switch (bulk->field) {
+            case BULK_FIELD_LEVEL:
+                character->level = bulk->values->level;
+                // Characters dropping below the subclass level lose their subclass
+                if (character->level < subClassUnlockLevel(character)) {
+                    replaceString(&character->class->subClass, "N/A");
+                }
+                character->HP = calculateHealth(character);
+                character->proficiencyModifier = calculateProficiencyModifier(character);
+                break;
+            case BULK_FIELD_BACKGROUND:
+                replaceString(&character->background, bulk->values->background);
+                break;
+            case BULK_FIELD_RACE:
+                replaceString(&character->race, bulk->values->race);
+                break;
+            case BULK_FIELD_ALIGNMENT:
+                replaceString(&character->alignment, bulk->values->alignment);
+                break;
+            case BULK_FIELD_ATTRIBUTE: {
+                int *scores[] = {
+                    &character->strength, &character->dexterity,
+                    &character->constitution, &character->intelligence,
+                    &character->wisdom, &character->charisma
+                };
+                *scores[bulk->attribute] = bulk->attributeValue;
+                if (bulk->attribute == 2) {
+                    character->HP = calculateHealth(character);
+                }
+                break;
+            }
+            case BULK_FIELD_WEAPON:
+                character->weapon = bulk->values->weapon;
+                if (character->weapon->isTwoHanded == 1 && character->hasShield == 1) {
+                    character->hasShield = 0;
+                }
+                break;
+            case BULK_FIELD_SHIELD: {
+                // Two-handed weapons leave no hand free for a shield
+                struct Weapon *weapon = findWeapon(character->weapon->name);
+                if (bulk->values->hasShield == 1 && weapon != NULL && weapon->isTwoHanded == 1) {
+                    bulk->skipped[i] = 1;
+                    break;
+                }
+                character->hasShield = bulk->values->hasShield;
+                break;
+            }
+        }
+    }
+}
+
+void bulkUpdateCharacters(struct Character *head) {
+    TRACE_SPAN("Bulk update", "menu");
+    struct CharacterFilter filter;
+    struct Character values;
+    int count, field, userChoice;
+    int validInput = 0;
+
+    selectCharacterFilter(&filter);
+    struct Character **batch = collectMatchingCharacters(head, &filter, &count);
+    if (count == 0) {
+        printf("\nNo characters match that filter.\n\n");
+        trackedFree(batch, MEMORY_WORK);
+        return;
+    }
+
+    printf("\nChoose which field to update on %d character(s):\n", count);
+    printf("1. Level\n2. Background\n3. Race\n4. Alignment\n5. Attribute\n6. Weapon\n7. Shield\n");
+    while (!validInput) {
+        printf("Enter your Choice: ");
+        validInput = isValidInput(&field, 1, 7);
+    }
+
+    memset(&values, 0, sizeof(values));
+    struct BulkUpdate bulk;
+    bulk.batch = batch;
+    bulk.field = field;
+    bulk.values = &values;
+    bulk.attribute = 0;
+    bulk.attributeValue = 0;
+
+    // Reuse the select functions on a template character to get the new value
+    switch (field) {
+        case BULK_FIELD_LEVEL:
+            selectLevel(&values);
+            break;
+        case BULK_FIELD_BACKGROUND:
+            selectBackground(&values);
+            break;
+        case BULK_FIELD_RACE:
+            selectRace(&values);
+            break;
+        case BULK_FIELD_ALIGNMENT:
+            selectAlignment(&values);
+            break;
+        case BULK_FIELD_ATTRIBUTE:
+            printf("Choose which attribute to set:\n");
+            for (int i = 0; i < 6; i++) {
+                printf("%d. %s\n", i + 1, catalog->attributes[i]);
+            }
+            validInput = 0;
+            while (!validInput) {
+                printf("Enter your Choice: ");
+                validInput = isValidInput(&bulk.attribute, 1, 6);
+            }
+            bulk.attribute--;
+            validInput = 0;
+            while (!validInput) {
+                printf("Enter the new %s value (8-20): ", catalog->attributes[bulk.attribute]);
+                validInput = isValidInput(&bulk.attributeValue, 8, 20);
+            }
+            break;
+        case BULK_FIELD_WEAPON:
+            selectWeapon(&values);
+            break;
+        case BULK_FIELD_SHIELD:
+            selectShield(&values);
+            break;
+    }
+
+    printf("Are you sure you want to update %d character(s)?\n", count);
+    printf("1. Yes\n");
+    printf("2. No\n");
+    validInput = 0;
+    while (!validInput) {
+        printf("Enter your Choice: ");
+        validInput = isValidInput(&userChoice, 1, 2);
+    }
+
+    if (userChoice == 1) {
+        bulk.skipped = trackedCalloc(count, sizeof(int), MEMORY_WORK);
+        if (bulk.skipped == NULL) {
+            printf("Memory allocation failed.\n");
+            exit(1);
+        }
+
+        beginHistories(batch, count);
+        parallelFor(count, bulkUpdateWorker, &bulk);
+        recordVersions(batch, count);
+
+        int skippedCount = 0;
+        for (int i = 0; i < count; i++) {
+            if (bulk.skipped[i]) {
+                printf("Skipped '%s': a two-handed weapon cannot be used with a shield.\n", batch[i]->name);
+                skippedCount++;
+            }
+        }
+        printf("\n%d character(s) have been updated!\n", count - skippedCount);
+        writeCharactersToFiles(batch, count);
+        trackedFree(bulk.skipped, MEMORY_WORK);
+    }
+    else {
+        printf("\nBulk update canceled.\n\n");
+    }
+
+    trackedFree(values.background, MEMORY_ROSTER);
+    trackedFree(values.race, MEMORY_ROSTER);
+    trackedFree(values.alignment, MEMORY_ROSTER);
+    trackedFree(batch, MEMORY_WORK);
+}
+
+void writeCharactersToFiles(struct Character **batch, int count) {
+    TRACE_SPAN("writeCharactersToFiles", "file write");
+    int written = 0;
+
+    for (int i = 0; i < count; i++) {
+        if (saveCharacter(batch[i]) == 0) {
+            written++;
+        }
+    }
+    // Commit the whole batch as one group
+    flushPendingWrites();
+
+    printf("Saved %d of %d character file(s).\n\n", written, count);
+}
+
+// Random number functions
+void rngSeed(struct Rng *rng, unsigned long long seed) {
+    // splitmix64 spreads nearby seeds (e.g. one per encounter) into unrelated states
+    seed += 0x9E3779B97F4A7C15ULL;
+    seed = (seed ^ (seed >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    seed = (seed ^ (seed >> 27)) * 0x94D049BB133111EBULL;
+    rng->state = (seed ^ (seed >> 31)) | 1;
+}
+
+// xorshift64* generator
+unsigned long long rngNext(struct Rng *rng) {
+    rng->state ^= rng->state >> 12;
+    rng->state ^= rng->state << 25;
+    rng->state ^= rng->state >> 27;
+    return rng->state * 0x2545F4914F6CDD1DULL;
+}
+
+int rngRoll(struct Rng *rng, int sides) {
+    // Reject the top sliver of values that would make low faces more likely
+    unsigned long long limit = 0xFFFFFFFFFFFFFFFFULL - (0xFFFFFFFFFFFFFFFFULL % sides) - 1;
+    unsigned long long value;
+    do {
+        value = rngNext(rng);
+    } while (value > limit);
+    return (int)(value % sides) + 1;
+}
+
+int parseDice(const char *dice, int *count, int *sides) {
+    if (dice == NULL || sscanf(dice, "%d%*[dD]%d", count, sides) != 2 || *count < 1 || *sides < 1) {
+        return -1;
+    }
+    return 0;
+}
+
+// Encounter functions
+void characterCombatant(struct Character *character, struct Combatant *combatant) {
+    memset(combatant, 0, sizeof(*combatant));
+    snprintf(combatant->name, sizeof(combatant->name), "%s", character->name);
+    combatant->team = 0;
+    combatant->dexModifier = calculateModifier(character->dexterity);
+    combatant->armorClass = calculateArmorClass(character->dexterity, character->armor->name, character->hasShield);
+    combatant->maxHP = character->HP;
+    if (buildAttackAction(character, 0, ROLL_NORMAL, &combatant->action) != 0) {
+        combatant->action.attacks = 1;
+        combatant->action.critRange = 20;
+        combatant->action.damageCount = 1;
+        combatant->action.damageSides = 4;
+    }
+}
+
+void monsterCombatant(struct Monster *monster, struct Combatant *combatant) {
+    memset(combatant, 0, sizeof(*combatant));
+    snprintf(combatant->name, sizeof(combatant->name), "%s", monster->name);
+    combatant->team = 1;
+    combatant->dexModifier = calculateModifier(monster->dexterity);
+    combatant->armorClass = monster->armorClass;
+    combatant->maxHP = monster->HP;
+    combatant->action.attacks = 1;
+    combatant->action.advantage = ROLL_NORMAL;
+    combatant->action.attackBonus = monster->attackBonus;
+    combatant->action.critRange = 20;
+    combatant->action.damageBonus = monster->damageBonus;
+    if (parseDice(monster->damageDice, &combatant->action.damageCount, &combatant->action.damageSides) != 0) {
+        combatant->action.damageCount = 1;
+        combatant->action.damageSides = 4;
+    }
+}
+
+// Binary max-heap of combatant indexes ordered by initiative, then DEX modifier
+struct InitiativeQueue {
+    int items[MAX_COMBATANTS];
+    int count;
+    const struct Combatant *combatants;
+};
+
+static int initiativeBefore(const struct InitiativeQueue *queue, int a, int b) {
+    const struct Combatant *first = &queue->combatants[a];
+    const struct Combatant *second = &queue->combatants[b];
+    if (first->initiative != second->initiative) {
+        return first->initiative > second->initiative;
+    }
+    if (first->dexModifier != second->dexModifier) {
+        return first->dexModifier > second->dexModifier;
+    }
+    return a < b;
+}
+
+static void initiativePush(struct InitiativeQueue *queue, int index) {
+    int child = queue->count++;
+    queue->items[child] = index;
+    while (child > 0) {
+        int parent = (child - 1) / 2;
+        if (!initiativeBefore(queue, queue->items[child], queue->items[parent])) {
+            break;
+        }
+        int swap = queue->items[child];
+        queue->items[child] = queue->items[parent];
+        queue->items[parent] = swap;
+        child = parent;
+    }
+}
+
+static int initiativePop(struct InitiativeQueue *queue) {
+    int top = queue->items[0];
+    queue->items[0] = queue->items[--queue->count];
+
+    int parent = 0;
+    while (1) {
+        int left = parent * 2 + 1, right = left + 1, best = parent;
+        if (left < queue->count && initiativeBefore(queue, queue->items[left], queue->items[best])) {
+            best = left;
+        }
+        if (right < queue->count && initiativeBefore(queue, queue->items[right], queue->items[best])) {
+            best = right;
+        }
+        if (best == parent) {
+            break;
+        }
+        int swap = queue->items[parent];
+        queue->items[parent] = queue->items[best];
+        queue->items[best] = swap;
+        parent = best;
+    }
+    return top;
+}
+
+// Picks the living opponent with the fewest HP left, or -1 if the other team is down
+static int chooseTarget(const struct Combatant *combatants, int count, int team) {
+    int target = -1;
+    for (int i = 0; i < count; i++) {
+        if (combatants[i].team != team && combatants[i].HP > 0 && (target == -1 || combatants[i].HP < combatants[target].HP)) {
+            target = i;
+        }
+    }
+    return target;
+}
+
+struct EncounterResult runEncounter(const struct Encounter *encounter, struct Rng *rng, int verbose) {
+    struct Combatant combatants[MAX_COMBATANTS];
+    struct InitiativeQueue queue;
+    struct EncounterResult result = { -1, 0 };
+    int count = encounter->count;
+
+    memcpy(combatants, encounter->combatants, count * sizeof(struct Combatant));
+    for (int i = 0; i < count; i++) {
+        combatants[i].HP = combatants[i].maxHP;
+        combatants[i].initiative = rngRoll(rng, 20) + combatants[i].dexModifier;
+        if (verbose) {
+            printf("%s rolls %d for initiative.\n", combatants[i].name, combatants[i].initiative);
+        }
+    }
+    queue.combatants = combatants;
+
+    for (int round = 1; round <= MAX_ROUNDS; round++) {
+        result.rounds = round;
+        if (verbose) {
+            printf("\n--- Round %d ---\n", round);
+        }
+
+        // Everyone still standing acts in initiative order
+        queue.count = 0;
+        for (int i = 0; i < count; i++) {
+            if (combatants[i].HP > 0) {
+                initiativePush(&queue, i);
+            }
+        }
+
+        while (queue.count > 0) {
+            int attacker = initiativePop(&queue);
+            if (combatants[attacker].HP <= 0) {
+                continue;   // Dropped earlier this round
+            }
+
+            int target = chooseTarget(combatants, count, combatants[attacker].team);
+            if (target == -1) {
+                result.winner = combatants[attacker].team;
+                return result;
+            }
+
+            // Every attack in the action goes at the same target
+            struct AttackAction action = combatants[attacker].action;
+            struct AttackResult attack;
+            action.targetAC = combatants[target].armorClass;
+            resolveAttackAction(&action, rng, &attack);
+            combatants[target].HP -= attack.damage;
+
+            if (verbose) {
+                for (int a = 0; a < attack.attacks; a++) {
+                    struct AttackRoll *roll = &attack.rolls[a];
+                    if (!roll->hit) {
+                        printf("%s attacks %s and misses (%d).\n", combatants[attacker].name, combatants[target].name, roll->total);
+                    }
+                    else {
+                        printf("%s %s %s for %d damage.\n", combatants[attacker].name, roll->critical ? "critically hits" : "hits",
+                               combatants[target].name, roll->damage);
+                    }
+                }
+                if (attack.hits > 0) {
+                    printf("%s has %d HP left.\n", combatants[target].name, combatants[target].HP > 0 ? combatants[target].HP : 0);
+                }
+            }
+        }
+
+        // Check for a winner at the end of the round
+        int partyStanding = 0, monstersStanding = 0;
+        for (int i = 0; i < count; i++) {
+            if (combatants[i].HP > 0) {
+                if (combatants[i].team == 0) {
+                    partyStanding = 1;
+                }
+                else {
+                    monstersStanding = 1;
+                }
+            }
+        }
+        if (!partyStanding || !monstersStanding) {
+            result.winner = partyStanding ? 0 : (monstersStanding ? 1 : -1);
+            return result;
+        }
+    }
+    return result;
+}
+
+// Work-stealing scheduler: each worker owns a range of encounter numbers and steals half of
+// another worker's remaining range when its own runs out
+#define STEAL_CHUNK 64        // Encounters a worker takes from its own range at a time
+
+struct EncounterWorker {
+    pthread_mutex_t lock;
+    int next;                 // Next encounter number in this worker's range
+    int end;                  // One past the last encounter number in this worker's range
+    long long partyWins;
+    long long monsterWins;
+    long long draws;
+    long long totalRounds;
+};
+
+struct EncounterSimulation {
+    const struct Encounter *encounter;
+    struct EncounterWorker *workers;
+    int workerCount;
+    unsigned long long seed;
+};
+
+struct EncounterThread {
+    struct EncounterSimulation *simulation;
+    int worker;
+};
+
+// Takes up to STEAL_CHUNK encounters from the front of a worker's range
+static int takeEncounters(struct EncounterWorker *worker, int *begin, int *end) {
+    pthread_mutex_lock(&worker->lock);
+    *begin = worker->next;
+    *end = worker->next + STEAL_CHUNK < worker->end ? worker->next + STEAL_CHUNK : worker->end;
+    worker->next = *end;
+    pthread_mutex_unlock(&worker->lock);
+    return *begin < *end;
+}
+
+// Moves the back half of the busiest other worker's range into this worker's range
+static int stealEncounters(struct EncounterSimulation *simulation, int thief) {
+    for (int attempt = 1; attempt < simulation->workerCount; attempt++) {
+        struct EncounterWorker *victim = &simulation->workers[(thief + attempt) % simulation->workerCount];
+
+        pthread_mutex_lock(&victim->lock);
+        int remaining = victim->end - victim->next;
+        if (remaining > 1) {
+            int middle = victim->next + remaining / 2;
+            int stolenEnd = victim->end;
+            victim->end = middle;
+            pthread_mutex_unlock(&victim->lock);
+
+            struct EncounterWorker *self = &simulation->workers[thief];
+            pthread_mutex_lock(&self->lock);
+            self->next = middle;
+            self->end = stolenEnd;
+            pthread_mutex_unlock(&self->lock);
+            return 1;
+        }
+        pthread_mutex_unlock(&victim->lock);
+    }
+    return 0;
+}
+
+static void *encounterWorkerThread(void *arg) {
+    struct EncounterThread *thread = arg;
+    struct EncounterSimulation *simulation = thread->simulation;
+    struct EncounterWorker *self = &simulation->workers[thread->worker];
+    struct Rng rng;
+    int begin, end;
+
+    traceThreadName("encounter worker");
+    TRACE_SPAN("encounter worker", "parallel");
+
+    while (1) {
+        if (!takeEncounters(self, &begin, &end)) {
+            if (!stealEncounters(simulation, thread->worker)) {
+                break;   // Every range is empty
+            }
+            continue;
+        }
+        for (int i = begin; i < end; i++) {
+            // Seeding by encounter number keeps results the same however the work was split
+            rngSeed(&rng, simulation->seed + (unsigned long long)i);
+            struct EncounterResult result = runEncounter(simulation->encounter, &rng, 0);
+
+            if (result.winner == 0) {
+                self->partyWins++;
+            }
+            else if (result.winner == 1) {
+                self->monsterWins++;
+            }
+            else {
+                self->draws++;
+            }
+            self->totalRounds += result.rounds;
+        }
+    }
+    return NULL;
+}
+
+void simulateEncounters(const struct Encounter *encounter, int simulations, unsigned long long seed) {
+    TRACE_SPAN("simulateEncounters", "stats");
+    struct EncounterSimulation simulation;
+    int workerCount = workerThreadCount();
+    pthread_t threads[64];
+    struct EncounterThread threadArgs[64];
+
+    if (workerCount > simulations) {
+        workerCount = simulations;
+    }
+    simulation.encounter = encounter;
+    simulation.workerCount = workerCount;
+    simulation.seed = seed;
+    simulation.workers = trackedCalloc(workerCount, sizeof(struct EncounterWorker), MEMORY_WORK);
+    if (simulation.workers == NULL) {
+        printf("Memory allocation failed.\n");
+        exit(1);
+    }
+
+    // Start every worker with an even share, stealing evens out encounters that run long
+    int share = simulations / workerCount, extra = simulations % workerCount, start = 0;
+    for (int i = 0; i < workerCount; i++) {
+        pthread_mutex_init(&simulation.workers[i].lock, NULL);
+        simulation.workers[i].next = start;
+        start += share + (i < extra ? 1 : 0);
+        simulation.workers[i].end = start;
+    }
+
+    struct timespec started, finished;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+
+    int running = 0;
+    for (int i = 0; i < workerCount; i++) {
+        threadArgs[i].simulation = &simulation;
+        threadArgs[i].worker = i;
+        if (pthread_create(&threads[i], NULL, encounterWorkerThread, &threadArgs[i]) != 0) {
+            break;
+        }
+        running++;
+    }
+    // Whatever could not get a thread is picked up here (or stolen by the threads that did start)
+    if (running < workerCount) {
+        for (int i = running; i < workerCount; i++) {
+            threadArgs[i].simulation = &simulation;
+            threadArgs[i].worker = i;
+            encounterWorkerThread(&threadArgs[i]);
+        }
+    }
+    for (int i = 0; i < running; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &finished);
+    double seconds = (finished.tv_sec - started.tv_sec) + (finished.tv_nsec - started.tv_nsec) / 1e9;
+
+    long long partyWins = 0, monsterWins = 0, draws = 0, totalRounds = 0;
+    for (int i = 0; i < workerCount; i++) {
+        partyWins += simulation.workers[i].partyWins;
+        monsterWins += simulation.workers[i].monsterWins;
+        draws += simulation.workers[i].draws;
+        totalRounds += simulation.workers[i].totalRounds;
+        pthread_mutex_destroy(&simulation.workers[i].lock);
+    }
+    trackedFree(simulation.workers, MEMORY_WORK);
+
+    printf("\nSimulated %d encounter(s) on %d thread(s) in %.3f seconds (seed %llu)\n", simulations, workerCount, seconds, seed);
+    printf("Party wins:   %6.2f%%\n", 100.0 * partyWins / simulations);
+    printf("Monster wins: %6.2f%%\n", 100.0 * monsterWins / simulations);
+    printf("Draws:        %6.2f%%\n", 100.0 * draws / simulations);
+    printf("Average rounds: %.2f\n\n", (double)totalRounds / simulations);
+}
+
+void encounterMenu(struct Character *head) {
+    TRACE_SPAN("Encounter simulator", "menu");
+    struct Encounter encounter;
+    char userCharacter[25];
+    int userChoice, validInput;
+
+    encounter.count = 0;
+
+    // Build the party from character names
+    printf("\nEnter the names of the characters in the party (leave blank to finish).\n");
+    inputBuffer();
+    while (encounter.count < MAX_COMBATANTS - 1) {
+        printf("Party member: ");
+        if (fgets(userCharacter, sizeof(userCharacter), stdin) == NULL) {
+            break;
+        }
+        userCharacter[strcspn(userCharacter, "\n")] = '\0';
+        if (userCharacter[0] == '\0') {
+            break;
+        }
+
+        struct Character *character = findCharacter(head, userCharacter);
+        if (character == NULL) {
+            printf("Your character could not be found :(\n");
+            continue;
+        }
+        characterCombatant(character, &encounter.combatants[encounter.count++]);
+        printf("%s joins the party.\n", character->name);
+    }
+    if (encounter.count == 0) {
+        printf("\nThe party needs at least one character.\n\n");
+        return;
+    }
+    int partySize = encounter.count;
+
+    // Add monsters
+    do {
+        printf("\nChoose a monster to add (0 to finish):\n");
+        printf("   %-16s | AC | HP  | Attack | Damage\n", "Name");
+        for (int i = 0; i < 10; i++) {
+            printf("%2d. %-15s | %-2d | %-3d |   +%-2d  | %s+%d\n", i + 1, catalog->monsters[i].name, catalog->monsters[i].armorClass, catalog->monsters[i].HP,
+                   catalog->monsters[i].attackBonus, catalog->monsters[i].damageDice, catalog->monsters[i].damageBonus);
+        }
+        validInput = 0;
+        while (!validInput) {
+            printf("Enter your Choice: ");
+            validInput = isValidInput(&userChoice, 0, 10);
+        }
+        if (userChoice > 0) {
+            int howMany;
+            validInput = 0;
+            while (!validInput) {
+                printf("How many? (1-%d): ", MAX_COMBATANTS - encounter.count);
+                validInput = isValidInput(&howMany, 1, MAX_COMBATANTS - encounter.count);
+            }
+            for (int i = 0; i < howMany; i++) {
+                struct Combatant *monster = &encounter.combatants[encounter.count++];
+                monsterCombatant(&catalog->monsters[userChoice - 1], monster);
+                if (howMany > 1) {
+                    // At most MAX_COMBATANTS copies, so the number never needs more than three digits
+                    snprintf(monster->name, sizeof(monster->name), "%.20s %hhu", catalog->monsters[userChoice - 1].name, (unsigned char)(i + 1));
+                }
+            }
+        }
+    } while (userChoice != 0 && encounter.count < MAX_COMBATANTS);
+
+    if (encounter.count == partySize) {
+        printf("\nThe encounter needs at least one monster.\n\n");
+        return;
+    }
+
+    printf("\n1. Play one encounter turn by turn\n");
+    printf("2. Simulate many encounters\n");
+    validInput = 0;
+    while (!validInput) {
+        printf("Enter your Choice: ");
+        validInput = isValidInput(&userChoice, 1, 2);
+    }
+
+    if (userChoice == 1) {
+        struct Rng rng;
+        rngSeed(&rng, drawDiceSeed());
+        struct EncounterResult result = runEncounter(&encounter, &rng, 1);
+        if (result.winner == 0) {
+            printf("\nThe party wins after %d round(s)!\n\n", result.rounds);
+        }
+        else if (result.winner == 1) {
+            printf("\nThe monsters win after %d round(s)...\n\n", result.rounds);
+        }
+        else {
+            printf("\nNo one is left standing after %d round(s).\n\n", result.rounds);
+        }
+        return;
+    }
+
+    int simulations, seed;
+    validInput = 0;
+    while (!validInput) {
+        printf("How many encounters should be simulated? (1-10000000): ");
+        validInput = isValidInput(&simulations, 1, 10000000);
+    }
+    validInput = 0;
+    while (!validInput) {
+        printf("Enter a seed (0 for a random seed): ");
+        validInput = isValidInput(&seed, 0, 2147483647);
+    }
+    simulateEncounters(&encounter, simulations, seed ? (unsigned long long)seed : drawDiceSeed());
+}
+
+// Equipment optimizer functions
+int weaponAbilityModifier(struct Character *character, struct Weapon *weapon) {
+    int strength = calculateModifier(character->strength);
+    int dexterity = calculateModifier(character->dexterity);
+
+    if (weapon->isFinesse == 1) {
+        return strength > dexterity ? strength : dexterity;
+    }
+    if (strcmp(weapon->type, "Ranged") == 0) {
+        return dexterity;
+    }
+    return strength;
+}
+
+double expectedWeaponDamage(struct Character *character, struct Weapon *weapon, int hasShield, int targetAC) {
+    int diceCount, diceSides;
+    // Versatile weapons use their two-handed dice when the other hand is free
+    const char *dice = (weapon->isVersatile == 1 && !hasShield) ? weapon->twoHandDamage : weapon->damageDice;
+    if (parseDice(dice, &diceCount, &diceSides) != 0) {
+        return 0.0;
+    }
+
+    int modifier = weaponAbilityModifier(character, weapon);
+    int attackBonus = modifier + character->proficiencyModifier;
+
+    // A natural 1 always misses and a natural 20 always hits
+    int neededRoll = targetAC - attackBonus;
+    if (neededRoll < 2) {
+        neededRoll = 2;
+    }
+    if (neededRoll > 20) {
+        neededRoll = 20;
+    }
+    double hitChance = (21 - neededRoll) / 20.0;
+    double critChance = 1 / 20.0;
+
+    // Hits deal at least 1, the same floor resolveAttackAction uses
+    double damage = (hitChance - critChance) * averageHitDamage(diceCount, diceSides, modifier)
+                  + critChance * averageHitDamage(diceCount * 2, diceSides, modifier);
+    return damage * attacksPerAction(character);
+}
+
+static double loadoutScore(const struct LoadoutGoal *goal, int armorClass, double expectedDamage) {
+    switch (goal->objective) {
+        case OBJECTIVE_ARMOR_CLASS:
+            return armorClass + expectedDamage / 1000.0;   // Damage only breaks ties
+        case OBJECTIVE_DAMAGE:
+            return expectedDamage + armorClass / 1000.0;   // AC only breaks ties
+        default:
+            return goal->acWeight * armorClass + goal->damageWeight * expectedDamage;
+    }
+}
+
+// Inserts a loadout into a best-first list of at most k entries
+static void insertLoadout(struct Loadout *best, int *found, int k, const struct Loadout *loadout) {
+    int position = *found < k ? (*found)++ : k;
+    if (position == k && loadout->score <= best[k - 1].score) {
+        return;
+    }
+    if (position == k) {
+        position = k - 1;
+    }
+    while (position > 0 && best[position - 1].score < loadout->score) {
+        best[position] = best[position - 1];
+        position--;
+    }
+    best[position] = *loadout;
+}
+
+int optimizeLoadout(struct Character *character, const struct LoadoutGoal *goal, struct Loadout *best, int k) {
+    TRACE_SPAN("optimizeLoadout", "stats");
+    double damage[31][2];         // Expected damage per weapon, without and with a shield
+    double bestDamage[2] = { -1.0, -1.0 };
+    int found = 0;
+
+    // Weapon damage does not depend on armor, so work it out once per shield choice
+    for (int w = 0; w < 31; w++) {
+        for (int shield = 0; shield < 2; shield++) {
+            // Two-handed weapons leave no hand free for a shield
+            if (shield && catalog->weapons[w].isTwoHanded == 1) {
+                damage[w][shield] = -1.0;
+                continue;
+            }
+            damage[w][shield] = expectedWeaponDamage(character, &catalog->weapons[w], shield, goal->targetAC);
+            if (damage[w][shield] > bestDamage[shield]) {
+                bestDamage[shield] = damage[w][shield];
+            }
+        }
+    }
+
+    for (int a = 0; a < 13; a++) {
+        if (character->strength < armorStrengthRequirement(&catalog->armors[a])) {
+            continue;
+        }
+        for (int shield = 0; shield < 2; shield++) {
+            int armorClass = calculateArmorClass(character->dexterity, catalog->armors[a].name, shield);
+
+            // Skip every weapon if even the best one could not make the list
+            if (found == k && loadoutScore(goal, armorClass, bestDamage[shield]) <= best[k - 1].score) {
+                continue;
+            }
+
+            for (int w = 0; w < 31; w++) {
+                if (damage[w][shield] < 0) {
+                    continue;
+                }
+                struct Loadout loadout = { a, w, shield, armorClass, damage[w][shield], 0.0 };
+                loadout.score = loadoutScore(goal, armorClass, damage[w][shield]);
+                insertLoadout(best, &found, k, &loadout);
+            }
+        }
+    }
+    return found;
+}
+
+// Shared state for optimizing every character in the roster
+struct RosterOptimization {
+    struct Character **characters;
+    const struct LoadoutGoal *goal;
+    struct Loadout *best;     // Best loadout for each character
+    int *found;               // 1 if the character has any legal loadout
+};
+
+static void rosterOptimizationWorker(int begin, int end, void *arg) {
+    struct RosterOptimization *optimization = arg;
+    for (int i = begin; i < end; i++) {
+        optimization->found[i] = optimizeLoadout(optimization->characters[i], optimization->goal, &optimization->best[i], 1);
+    }
+}
+
+static void printLoadout(int rank, const struct Loadout *loadout) {
+    printf("%2d. %-22s | %-15s | %-6s | AC %-2d | %5.2f dmg/round | score %.2f\n", rank, catalog->armors[loadout->armor].name, catalog->weapons[loadout->weapon].name,
+           loadout->hasShield ? "Shield" : "------", loadout->armorClass, loadout->expectedDamage, loadout->score);
+}
+
+static void equipLoadout(struct Character *character, const struct Loadout *loadout) {
+    character->armor = &catalog->armors[loadout->armor];
+    character->weapon = &catalog->weapons[loadout->weapon];
+    character->hasShield = loadout->hasShield;
+}
+
+void equipmentOptimizerMenu(struct Character *head) {
+    TRACE_SPAN("Equipment optimizer", "menu");
+    struct LoadoutGoal goal;
+    int userChoice, validInput = 0;
+
+    printf("\nRank loadouts by:\n");
+    printf("1. Armor Class\n");
+    printf("2. Expected damage per round\n");
+    printf("3. Weighted Armor Class and damage\n");
+    while (!validInput) {
+        printf("Enter your Choice: ");
+        validInput = isValidInput(&userChoice, 1, 3);
+    }
+    goal.objective = userChoice;
+    goal.acWeight = 1.0;
+    goal.damageWeight = 1.0;
+
+    validInput = 0;
+    while (!validInput) {
+        printf("Enter the target's Armor Class for expected damage (5-30): ");
+        validInput = isValidInput(&goal.targetAC, 5, 30);
+    }
+    if (goal.objective == OBJECTIVE_WEIGHTED) {
+        int weight;
+        validInput = 0;
+        while (!validInput) {
+            printf("How many points of damage per round is one point of AC worth? (0-10): ");
+            validInput = isValidInput(&weight, 0, 10);
+        }
+        goal.acWeight = weight;
+    }
+
+    printf("\n1. Optimize one character\n");
+    printf("2. Optimize every character\n");
+    validInput = 0;
+    while (!validInput) {
+        printf("Enter your Choice: ");
+        validInput = isValidInput(&userChoice, 1, 2);
+    }
+
+    if (userChoice == 1) {
+        char userCharacter[25];
+        struct Loadout best[10];
+
+        getCharacterName(userCharacter, "Enter the name of the character to optimize: ");
+        struct Character *character = findCharacter(head, userCharacter);
+        if (character == NULL) {
+            printf("\nYour character could not found :(\n\n");
+            return;
+        }
+
+        int found = optimizeLoadout(character, &goal, best, 10);
+        printf("\nBest loadouts for %s:\n", character->name);
+        for (int i = 0; i < found; i++) {
+            printLoadout(i + 1, &best[i]);
+        }
+        if (found == 0) {
+            printf("No legal loadouts found.\n\n");
+            return;
+        }
+
+        printf("\nEquip the best loadout? (1: yes | 0: no)\n");
+        validInput = 0;
+        while (!validInput) {
+            printf("Enter your Choice: ");
+            validInput = isValidInput(&userChoice, 0, 1);
+        }
+        if (userChoice == 1) {
+            equipLoadout(character, &best[0]);
+            writeCharactersToFiles(&character, 1);
+        }
+        return;
+    }
+
+    struct CharacterFilter everyone = { .className = "", .race = "", .minLevel = 1, .maxLevel = MAX_LEVEL };
+    struct RosterOptimization optimization;
+    int count;
+
+    optimization.characters = collectMatchingCharacters(head, &everyone, &count);
+    if (count == 0) {
+        printf("\nNo characters in the list...\n\n");
+        trackedFree(optimization.characters, MEMORY_WORK);
+        return;
+    }
+    optimization.goal = &goal;
+    optimization.best = trackedMalloc(count * sizeof(struct Loadout), MEMORY_WORK);
+    optimization.found = trackedMalloc(count * sizeof(int), MEMORY_WORK);
+    if (optimization.best == NULL || optimization.found == NULL) {
+        printf("Memory allocation failed.\n");
+        exit(1);
+    }
+
+    struct timespec started, finished;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    parallelFor(count, rosterOptimizationWorker, &optimization);
+    clock_gettime(CLOCK_MONOTONIC, &finished);
+
+    int shown = count < 50 ? count : 50;
+    for (int i = 0; i < shown; i++) {
+        if (optimization.found[i]) {
+            printf("%-24s ", optimization.characters[i]->name);
+            printLoadout(1, &optimization.best[i]);
+        }
+    }
+    if (shown < count) {
+        printf("... and %d more\n", count - shown);
+    }
+    printf("\nOptimized %d character(s) in %.3f seconds.\n", count,
+           (finished.tv_sec - started.tv_sec) + (finished.tv_nsec - started.tv_nsec) / 1e9);
+
+    printf("\nEquip every character with their best loadout? (1: yes | 0: no)\n");
+    validInput = 0;
+    while (!validInput) {
+        printf("Enter your Choice: ");
+        validInput = isValidInput(&userChoice, 0, 1);
+    }
+    if (userChoice == 1) {
+        int equipped = 0;
+        for (int i = 0; i < count; i++) {
+            if (optimization.found[i]) {
+                equipLoadout(optimization.characters[i], &optimization.best[i]);
+                optimization.characters[equipped++] = optimization.characters[i];
+            }
+        }
+        writeCharactersToFiles(optimization.characters, equipped);
+    }
+
+    trackedFree(optimization.best, MEMORY_WORK);
+    trackedFree(optimization.found, MEMORY_WORK);
+    trackedFree(optimization.characters, MEMORY_WORK);
+}
+
+// Ability score functions
+static const int pointBuyCost[8] = { 0, 1, 2, 3, 4, 5, 7, 9 };   // Cost of scores 8 through 15
+static const int standardArray[6] = { 15, 14, 13, 12, 10, 8 };
+
+// Appends every ordering of six scores to the list (Heap's algorithm)
+static void addPermutations(int values[6], struct AbilityAllocation *allocations, int *count) {
+    int counters[6] = { 0 };
+    int i = 0;
+
+    for (int a = 0; a < 6; a++) {
+        allocations[*count].scores[a] = values[a];
+    }
+    (*count)++;
+
+    while (i < 6) {
+        if (counters[i] < i) {
+            int swapWith = (i % 2 == 0) ? 0 : counters[i];
+            int swap = values[swapWith];
+            values[swapWith] = values[i];
+            values[i] = swap;
+            for (int a = 0; a < 6; a++) {
+                allocations[*count].scores[a] = values[a];
+            }
+            (*count)++;
+            counters[i]++;
+            i = 0;
+        }
+        else {
+            counters[i] = 0;
+            i++;
+        }
+    }
+}
+
+// Rolls 4d6 and drops the lowest die
+static int rollAbilityScore(struct Rng *rng) {
+    int lowest = 7, total = 0;
+    for (int d = 0; d < 4; d++) {
+        int roll = rngRoll(rng, 6);
+        total += roll;
+        if (roll < lowest) {
+            lowest = roll;
+        }
+    }
+    return total - lowest;
+}
+
+int enumerateAllocations(enum AllocationMethod method, struct Rng *rng, struct AbilityAllocation **allocations) {
+    int count = 0;
+
+    if (method == ALLOCATION_POINT_BUY) {
+        // 8^6 combinations is the most there can be before the 27 point budget is applied
+        *allocations = trackedMalloc(262144 * sizeof(struct AbilityAllocation), MEMORY_WORK);
+        if (*allocations == NULL) {
+            printf("Memory allocation failed.\n");
+            exit(1);
+        }
+        int scores[6];
+        for (int combination = 0; combination < 262144; combination++) {
+            int cost = 0, rest = combination;
+            for (int a = 0; a < 6; a++) {
+                scores[a] = rest % 8;
+                rest /= 8;
+                cost += pointBuyCost[scores[a]];
+            }
+            // Only keep allocations that spend the whole budget, leftover points never help
+            if (cost != 27) {
+                continue;
+            }
+            for (int a = 0; a < 6; a++) {
+                (*allocations)[count].scores[a] = scores[a] + 8;
+            }
+            count++;
+        }
+        return count;
+    }
+
+    int values[6];
+    *allocations = trackedMalloc(720 * sizeof(struct AbilityAllocation), MEMORY_WORK);
+    if (*allocations == NULL) {
+        printf("Memory allocation failed.\n");
+        exit(1);
+    }
+    for (int a = 0; a < 6; a++) {
+        values[a] = (method == ALLOCATION_STANDARD_ARRAY) ? standardArray[a] : rollAbilityScore(rng);
+    }
+    addPermutations(values, *allocations, &count);
+    return count;
+}
+
+// Shared state for scoring allocations across worker threads
+struct AllocationRanking {
+    struct Character *build;
+    struct AbilityAllocation *allocations;
+    const struct AllocationWeights *weights;
+    int targetAC;
+};
+
+static void allocationRankingWorker(int begin, int end, void *arg) {
+    struct AllocationRanking *ranking = arg;
+    struct Character character = *ranking->build;    // Private copy to try the scores on
+    struct Class characterClass = *ranking->build->class;
+    character.class = &characterClass;
+
+    for (int i = begin; i < end; i++) {
+        struct AbilityAllocation *allocation = &ranking->allocations[i];
+        character.strength = allocation->scores[0];
+        character.dexterity = allocation->scores[1];
+        character.constitution = allocation->scores[2];
+        character.intelligence = allocation->scores[3];
+        character.wisdom = allocation->scores[4];
+        character.charisma = allocation->scores[5];
+
+        // Armor the character is not strong enough for rules the allocation out
+        if (character.strength < armorStrengthRequirement(character.armor)) {
+            allocation->score = -1e9;
+            continue;
+        }
+
+        allocation->armorClass = calculateArmorClass(character.dexterity, character.armor->name, character.hasShield);
+        allocation->HP = calculateHealth(&character);
+        allocation->attackBonus = weaponAbilityModifier(&character, character.weapon) + character.proficiencyModifier;
+        allocation->expectedDamage = expectedWeaponDamage(&character, character.weapon, character.hasShield, ranking->targetAC);
+        allocation->score = ranking->weights->armorClass * allocation->armorClass + ranking->weights->HP * allocation->HP
+                          + ranking->weights->attackBonus * allocation->attackBonus + ranking->weights->damage * allocation->expectedDamage;
+    }
+}
+
+int rankAllocations(struct Character *build, struct AbilityAllocation *allocations, int count, const struct AllocationWeights *weights, int targetAC, struct AbilityAllocation *best, int k) {
+    struct AllocationRanking ranking = { build, allocations, weights, targetAC };
+    int found = 0;
+
+    parallelFor(count, allocationRankingWorker, &ranking);
+
+    // Keep the k best in a small sorted list
+    for (int i = 0; i < count; i++) {
+        if (allocations[i].score <= -1e9 || (found == k && allocations[i].score <= best[k - 1].score)) {
+            continue;
+        }
+        int position = found < k ? found++ : k - 1;
+        while (position > 0 && best[position - 1].score < allocations[i].score) {
+            best[position] = best[position - 1];
+            position--;
+        }
+        best[position] = allocations[i];
+    }
+    return found;
+}
+
+static void printAllocation(int rank, const struct AbilityAllocation *allocation) {
+    printf("%2d. STR %-2d DEX %-2d CON %-2d INT %-2d WIS %-2d CHA %-2d | AC %-2d | HP %-3d | Attack +%-2d | %5.2f dmg/round | score %.2f\n", rank,
+           allocation->scores[0], allocation->scores[1], allocation->scores[2], allocation->scores[3], allocation->scores[4], allocation->scores[5],
+           allocation->armorClass, allocation->HP, allocation->attackBonus, allocation->expectedDamage, allocation->score);
+}
+
+void abilityScorePlannerMenu(void) {
+    TRACE_SPAN("Ability score planner", "menu");
+    struct Character build;
+    struct Class buildClass;
+    struct AllocationWeights weights;
+    struct AbilityAllocation *allocations;
+    struct AbilityAllocation best[10];
+    struct Rng rng;
+    int method, classChoice, focus, targetAC, validInput = 0;
+
+    printf("\nChoose how ability scores are generated:\n");
+    printf("1. Point buy (27 points)\n");
+    printf("2. Standard array (15, 14, 13, 12, 10, 8)\n");
+    printf("3. Rolled (4d6, drop the lowest)\n");
+    while (!validInput) {
+        printf("Enter your Choice: ");
+        validInput = isValidInput(&method, 1, 3);
+    }
+
+    printf("\nChoose the class to plan for:\n");
+    printf("0. Every class\n");
+    for (int i = 0; i < 12; i++) {
+        printf("%d. %s\n", i + 1, catalog->classes[i][0]);
+    }
+    validInput = 0;
+    while (!validInput) {
+        printf("Enter your Choice: ");
+        validInput = isValidInput(&classChoice, 0, 12);
+    }
+
+    // The select functions fill in the template, with 20 Strength so no armor is hidden
+    memset(&build, 0, sizeof(build));
+    memset(&buildClass, 0, sizeof(buildClass));
+    build.class = &buildClass;
+    build.strength = 20;
+    build.dexterity = 10;
+    selectLevel(&build);
+    selectArmor(&build);
+    selectWeapon(&build);
+    selectShield(&build);
+    if (build.hasShield && build.weapon->isTwoHanded == 1) {
+        printf("A two-handed weapon cannot be used with a shield, planning without the shield.\n");
+        build.hasShield = 0;
+    }
+
+    validInput = 0;
+    while (!validInput) {
+        printf("Enter the target's Armor Class for expected damage (5-30): ");
+        validInput = isValidInput(&targetAC, 5, 30);
+    }
+
+    printf("\nWhat should the scores favour?\n");
+    printf("1. Balanced\n2. Offense\n3. Defense\n");
+    validInput = 0;
+    while (!validInput) {
+        printf("Enter your Choice: ");
+        validInput = isValidInput(&focus, 1, 3);
+    }
+    weights.armorClass = (focus == 3) ? 3.0 : 1.0;
+    weights.HP = (focus == 3) ? 0.5 : 0.2;
+    weights.attackBonus = (focus == 2) ? 2.0 : 1.0;
+    weights.damage = (focus == 2) ? 3.0 : 1.0;
+
+    rngSeed(&rng, drawDiceSeed());
+    int count = enumerateAllocations(method, &rng, &allocations);
+    if (method == ALLOCATION_ROLLED) {
+        printf("\nYou rolled: %d, %d, %d, %d, %d, %d\n", allocations[0].scores[0], allocations[0].scores[1], allocations[0].scores[2],
+               allocations[0].scores[3], allocations[0].scores[4], allocations[0].scores[5]);
+    }
+
+    struct timespec started, finished;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+
+    int firstClass = classChoice ? classChoice - 1 : 0;
+    int lastClass = classChoice ? classChoice - 1 : 11;
+    for (int c = firstClass; c <= lastClass; c++) {
+        buildClass.name = catalog->classes[c][0];
+        buildClass.progression = NULL;
+        initializeHitDie(&build);
+        build.proficiencyModifier = calculateProficiencyModifier(&build);
+
+        int found = rankAllocations(&build, allocations, count, &weights, targetAC, best, classChoice ? 10 : 1);
+        printf("\nBest of %d allocation(s) for a level %d %s:\n", count, build.level, buildClass.name);
+        for (int i = 0; i < found; i++) {
+            printAllocation(i + 1, &best[i]);
+        }
+        if (found == 0) {
+            printf("No allocation can wear %s.\n", build.armor->name);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &finished);
+    printf("\nRanked in %.3f seconds.\n\n", (finished.tv_sec - started.tv_sec) + (finished.tv_nsec - started.tv_nsec) / 1e9);
+    trackedFree(allocations, MEMORY_WORK);
+}
+
+// Character generator functions
+static const char *nameStarts[] = { "Ar", "Bel", "Cor", "Da", "El", "Fen", "Gor", "Hal", "Is", "Jor", "Ka", "Lor", "Mor", "Nim", "Or", "Per", "Quin", "Ro", "Syl", "Tor", "Ul", "Val", "Wyn", "Zan" };
+static const char *nameEnds[] = { "a", "an", "ara", "dor", "en", "eth", "ia", "ic", "in", "is", "ith", "on", "or", "os", "ric", "wen", "wyn", "us" };
+static const char *surnames[] = { "Stone", "Oak", "Ash", "Brook", "Vale", "Frost", "Flint", "Thorn", "Reed", "Moon", "Storm", "Hill", "Wood", "Marsh", "Black", "Bright" };
+
+#define PICK(rng, list) list[rngRoll(rng, sizeof(list) / sizeof(list[0])) - 1]
+
+static char *copyCatalogString(const char *value) {
+    char *copy = trackedStrdup(value, MEMORY_ROSTER);
+    if (copy == NULL) {
+        printf("Memory allocation failed.\n");
+        exit(1);
+    }
+    return copy;
+}
+
+void generateCharacter(struct Rng *rng, int id, struct Character *character) {
+    memset(character, 0, sizeof(*character));
+    character->id = id;
+    // At most 14 characters of name, so IDs up to 9 digits (8 for memory-only ones) still fit
+    if (id > 0) {
+        snprintf(character->name, sizeof(character->name), "%s%s %s %d", PICK(rng, nameStarts), PICK(rng, nameEnds), PICK(rng, surnames), id);
+    }
+    else {
+        snprintf(character->name, sizeof(character->name), "%s%s %s #%d", PICK(rng, nameStarts), PICK(rng, nameEnds), PICK(rng, surnames), -id);
+    }
+
+    character->class = trackedMalloc(sizeof(struct Class), MEMORY_ROSTER);
+    if (character->class == NULL) {
+        printf("Memory allocation failed.\n");
+        exit(1);
+    }
+    int classIndex = rngRoll(rng, 12) - 1;
+    character->level = rngRoll(rng, MAX_LEVEL);
+    character->class->name = copyCatalogString(catalog->classes[classIndex][0]);
+    character->class->progression = NULL;
+    initializeHitDie(character);
+
+    // Subclasses only exist once the class unlocks them
+    if (character->level >= subClassUnlockLevel(character)) {
+        character->class->subClass = copyCatalogString(catalog->classes[classIndex][rngRoll(rng, 4)]);
+    }
+    else {
+        character->class->subClass = copyCatalogString("N/A");
+    }
+    character->background = copyCatalogString(catalog->backgrounds[rngRoll(rng, 16) - 1]);
+    character->race = copyCatalogString(catalog->races[rngRoll(rng, 10) - 1]);
+    character->alignment = copyCatalogString(catalog->alignments[rngRoll(rng, 9) - 1]);
+
+    // 4d6 drop the lowest, raised to the 8 minimum selectAttributes allows
+    int *scores[] = {
+        &character->strength, &character->dexterity,
+        &character->constitution, &character->intelligence,
+        &character->wisdom, &character->charisma
+    };
+    for (int a = 0; a < 6; a++) {
+        int score = rollAbilityScore(rng);
+        *scores[a] = score < 8 ? 8 : score;
+    }
+
+    // Re-pick armor until the character is strong enough to wear it (Unarmored always qualifies)
+    do {
+        character->armor = &catalog->armors[rngRoll(rng, 13) - 1];
+    } while (character->strength < armorStrengthRequirement(character->armor));
+    character->weapon = &catalog->weapons[rngRoll(rng, 31) - 1];
+    character->hasShield = (character->weapon->isTwoHanded == 1) ? 0 : rngRoll(rng, 2) - 1;
+
+    character->speed = 30;
+    character->proficiencyModifier = calculateProficiencyModifier(character);
+    character->HP = calculateHealth(character);
+    character->isLoaded = 1;
+}
+
+// Shared state for the generator workers
+struct CharacterGeneration {
+    struct Character **characters;
+    unsigned long long seed;
+    int firstId;
+    int idStep;               // 1 for saved characters, -1 for memory-only ones
+};
+
+static void characterGenerationWorker(int begin, int end, void *arg) {
+    struct CharacterGeneration *generation = arg;
+    struct Rng rng;
+
+    for (int i = begin; i < end; i++) {
+        struct Character *character = trackedMalloc(sizeof(struct Character), MEMORY_ROSTER);
+        if (character == NULL) {
+            printf("Memory allocation failed.\n");
+            exit(1);
+        }
+        // Seeding by position keeps the roster the same however the work was split
+        rngSeed(&rng, generation->seed + (unsigned long long)i);
+        generateCharacter(&rng, generation->firstId + i * generation->idStep, character);
+        generation->characters[i] = character;
+    }
+}
+
+// Saves new characters to the roster and index in chunks, each chunk is one group commit and one index append.
+// Saved characters are released to their id and name and loaded again on first use, like --lazy.
+static void saveNewCharacters(struct Character **characters, int count) {
+    const int chunk = 4096;
+
+    for (int first = 0; first < count; first += chunk) {
+        int last = first + chunk < count ? first + chunk : count;
+
+        for (int i = first; i < last; i++) {
+            saveCharacter(characters[i]);
+            appendIndexEntry(characters[i]);
+        }
+        flushPendingWrites();
+
+        for (int i = first; i < last; i++) {
+            releaseCharacterDetails(characters[i]);
+        }
+    }
+}
+
+void generateCharacters(struct Character **head, int count, unsigned long long seed, int save) {
+    TRACE_SPAN("generateCharacters", "roster");
+    struct CharacterGeneration generation;
+    struct timespec started, generated, finished;
+
+    if (count <= 0) {
+        return;
+    }
+    generation.characters = trackedMalloc(count * sizeof(struct Character *), MEMORY_WORK);
+    if (generation.characters == NULL) {
+        printf("Memory allocation failed.\n");
+        exit(1);
+    }
+    generation.seed = seed;
+    // Memory-only characters are never saved, so they take IDs from their own range instead of the roster's
+    if (save) {
+        generation.firstId = nextCharacterId;
+        generation.idStep = 1;
+        nextCharacterId += count;
+    }
+    else {
+        generation.firstId = nextMemoryOnlyId;
+        generation.idStep = -1;
+        nextMemoryOnlyId -= count;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    parallelFor(count, characterGenerationWorker, &generation);
+    clock_gettime(CLOCK_MONOTONIC, &generated);
+
+    // The IDs keep generated names apart, but a character added by hand may already have one of them
+    int generatedCount = count;
+    count = dropTakenNames(*head, generation.characters, count);
+
+    if (save) {
+        saveNewCharacters(generation.characters, count);
+    }
+    else {
+        loadedCharacterCount += count;
+    }
+
+    // Link in order so the list matches the order in index.txt
+    for (int i = 0; i < count; i++) {
+        generation.characters[i]->next = *head;
+        *head = generation.characters[i];
+    }
+    nameFilterAddMany(*head, generation.characters, count);
+    clock_gettime(CLOCK_MONOTONIC, &finished);
+    trackedFree(generation.characters, MEMORY_WORK);
+
+    double generateSeconds = (generated.tv_sec - started.tv_sec) + (generated.tv_nsec - started.tv_nsec) / 1e9;
+    double totalSeconds = (finished.tv_sec - started.tv_sec) + (finished.tv_nsec - started.tv_nsec) / 1e9;
+    printf("Generated %d character(s) in %.3f seconds (%.0f per second, seed %llu).\n", generatedCount, generateSeconds,
+           generateSeconds > 0 ? generatedCount / generateSeconds : 0.0, seed);
+    if (count < generatedCount) {
+        printf("%d of them were dropped because another character already has the name.\n", generatedCount - count);
+    }
+    if (save) {
+        printf("Saved them to the roster in %.3f seconds.\n", totalSeconds - generateSeconds);
+    }
+    printf("\n");
+}
+
+void characterGeneratorMenu(struct Character **head) {
+    TRACE_SPAN("Random character generator", "menu");
+    int count, seed, save, validInput = 0;
+
+    while (!validInput) {
+        printf("How many characters should be generated? (1-100000000): ");
+        validInput = isValidInput(&count, 1, 100000000);
+    }
+    validInput = 0;
+    while (!validInput) {
+        printf("Enter a seed (0 for a random seed): ");
+        validInput = isValidInput(&seed, 0, 2147483647);
+    }
+
+    printf("\nWhere should the characters go?\n");
+    printf("1. Memory only (not saved)\n");
+    printf("2. Roster files and index.txt\n");
+    printf("3. Packed roster file (roster.pack)\n");
+    validInput = 0;
+    while (!validInput) {
+        printf("Enter your Choice: ");
+        validInput = isValidInput(&save, 1, 3);
+    }
+
+    if (save == 3) {
+        char packPath[100];
+        campaignFilePath("roster.pack", packPath, sizeof(packPath));
+        generatePackedRoster(count, seed ? (unsigned long long)seed : drawDiceSeed(), packPath);
+        return;
+    }
+    generateCharacters(head, count, seed ? (unsigned long long)seed : drawDiceSeed(), save == 2);
+}
+
+// Roll statistics functions
+static const int dieSides[DIE_TYPES] = { 4, 6, 8, 10, 12, 20 };
+
+// Maps a number of sides to its slot in RollStats (-1 if it isn't tracked)
+static int dieIndex(int sides) {
+    switch (sides) {
+        case 4:  return 0;
+        case 6:  return 1;
+        case 8:  return 2;
+        case 10: return 3;
+        case 12: return 4;
+        case 20: return 5;
+        default: return -1;
+    }
+}
+
+int rollDie(int sides) {
+    // rand() % sides favours the low faces whenever RAND_MAX + 1 isn't a multiple of sides
+    int face = rngRoll(&diceRng, sides);
+    recordRoll(sides, face);
+    auditDie(sides, face);
+    return face;
+}
+
+unsigned long long drawDiceSeed(void) {
+    unsigned long long value = rngNext(&diceRng);
+    auditDraw(value);
+    return value;
+}
+
+void recordRoll(int sides, int face) {
+    int die = dieIndex(sides);
+    if (die < 0) {
+        return;
+    }
+    diceStats.faces[die][face]++;
+
+    if (rollingCharacter != NULL) {
+        if (rollingCharacter->rollStats == NULL) {
+            rollingCharacter->rollStats = trackedCalloc(1, sizeof(struct RollStats), MEMORY_ROSTER);
+            if (rollingCharacter->rollStats == NULL) {
+                printf("Memory allocation failed.\n");
+                exit(1);
+            }
+        }
+        rollingCharacter->rollStats->faces[die][face]++;
+    }
+}
+
+void summarizeDie(const struct RollStats *stats, int die, struct DieSummary *summary) {
+    int sides = dieSides[die];
+    double sum = 0.0, sumSquares = 0.0;
+
+    memset(summary, 0, sizeof(*summary));
+    summary->sides = sides;
+    for (int face = 1; face <= sides; face++) {
+        unsigned long long count = stats->faces[die][face];
+        summary->rolls += count;
+        sum += (double)count * face;
+        sumSquares += (double)count * face * face;
+    }
+
+    // Wilson-Hilferty approximation of the chi-square quantile at p = 0.001 (z = 3.09)
+    double degrees = sides - 1;
+    double spread = 2.0 / (9.0 * degrees);
+    summary->criticalValue = degrees * pow(1.0 - spread + 3.09 * sqrt(spread), 3);
+
+    if (summary->rolls == 0) {
+        return;
+    }
+    summary->mean = sum / summary->rolls;
+    summary->variance = sumSquares / summary->rolls - summary->mean * summary->mean;
+
+    double expected = (double)summary->rolls / sides;
+    for (int face = 1; face <= sides; face++) {
+        double difference = (double)stats->faces[die][face] - expected;
+        summary->chiSquare += difference * difference / expected;
+    }
+}
+
+void printRollStats(const struct RollStats *stats, const char *title) {
+    struct DieSummary summary;
+    int printed = 0;
+
+    printf("\n%s\n", title);
+    printf("%-5s %14s %8s %8s %9s %9s %11s %8s\n", "Die", "Rolls", "Mean", "Fair", "Variance", "Fair", "Chi-square", "Verdict");
+    for (int die = 0; die < DIE_TYPES; die++) {
+        summarizeDie(stats, die, &summary);
+        if (summary.rolls == 0) {
+            continue;
+        }
+        double fairMean = (summary.sides + 1) / 2.0;
+        double fairVariance = (summary.sides * summary.sides - 1) / 12.0;
+        printf("D%-4d %14llu %8.3f %8.3f %9.3f %9.3f %11.2f %8s\n", summary.sides, summary.rolls,
+               summary.mean, fairMean, summary.variance, fairVariance, summary.chiSquare,
+               summary.chiSquare > summary.criticalValue ? "BIASED" : "fair");
+        printed++;
+    }
+    if (printed == 0) {
+        printf("No rolls yet.\n");
+    }
+    printf("\n");
+}
+
+// Writes one row per die that has been rolled
+static void writeRollStatsRows(FILE *file, const struct RollStats *stats, const char *scope) {
+    struct DieSummary summary;
+
+    for (int die = 0; die < DIE_TYPES; die++) {
+        summarizeDie(stats, die, &summary);
+        if (summary.rolls == 0) {
+            continue;
+        }
+        fprintf(file, "%s,D%d,%llu,%.6f,%.6f,%.6f,%.6f,%s", scope, summary.sides, summary.rolls, summary.mean,
+                summary.variance, summary.chiSquare, summary.criticalValue,
+                summary.chiSquare > summary.criticalValue ? "Yes" : "No");
+        for (int face = 1; face <= 20; face++) {
+            if (face <= summary.sides) {
+                fprintf(file, ",%llu", stats->faces[die][face]);
+            }
+            else {
+                fprintf(file, ",");
+            }
+        }
+        fprintf(file, "\n");
+    }
+}
+
+int exportRollStats(struct Character *head, const char *fileName) {
+    TRACE_SPAN("exportRollStats", "file write");
+    FILE *file = fopen(fileName, "w");
+    if (file == NULL) {
+        printf("Couldn't open %s.\n", fileName);
+        return -1;
+    }
+
+    fprintf(file, "Scope,Die,Rolls,Mean,Variance,ChiSquare,CriticalValue,Biased");
+    for (int face = 1; face <= 20; face++) {
+        fprintf(file, ",Face%d", face);
+    }
+    fprintf(file, "\n");
+
+    writeRollStatsRows(file, &diceStats, "All rolls");
+    for (struct Character *current = head; current != NULL; current = current->next) {
+        if (current->rollStats != NULL) {
+            writeRollStatsRows(file, current->rollStats, current->name);
+        }
+    }
+    fclose(file);
+    return 0;
+}
+
+// Shared state for the self-test workers
+struct DiceSelfTest {
+    pthread_mutex_t lock;
+    struct RollStats totals;
+    unsigned long long seed;
+};
+
+static void diceSelfTestWorker(int begin, int end, void *arg) {
+    struct DiceSelfTest *test = arg;
+    struct RollStats *local = trackedCalloc(1, sizeof(struct RollStats), MEMORY_WORK);
+    struct Rng rng;
+
+    if (local == NULL) {
+        printf("Memory allocation failed.\n");
+        exit(1);
+    }
+    // Each slice gets its own stream so the threads never share a generator
+    rngSeed(&rng, test->seed + (unsigned long long)begin);
+
+    for (int i = begin; i < end; i++) {
+        int die = i % DIE_TYPES;
+        local->faces[die][rngRoll(&rng, dieSides[die])]++;
+    }
+
+    pthread_mutex_lock(&test->lock);
+    for (int die = 0; die < DIE_TYPES; die++) {
+        for (int face = 1; face <= 20; face++) {
+            test->totals.faces[die][face] += local->faces[die][face];
+        }
+    }
+    pthread_mutex_unlock(&test->lock);
+    trackedFree(local, MEMORY_WORK);
+}
+
+void diceSelfTest(int rolls) {
+    struct DiceSelfTest *test = trackedCalloc(1, sizeof(struct DiceSelfTest), MEMORY_WORK);
+    struct DieSummary summary;
+    struct timespec started, finished;
+    int biased = 0;
+
+    if (test == NULL) {
+        printf("Memory allocation failed.\n");
+        exit(1);
+    }
+    pthread_mutex_init(&test->lock, NULL);
+    test->seed = drawDiceSeed();
+
+    printf("Rolling %d dice...\n", rolls);
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    parallelFor(rolls, diceSelfTestWorker, test);
+    clock_gettime(CLOCK_MONOTONIC, &finished);
+
+    double seconds = (finished.tv_sec - started.tv_sec) + (finished.tv_nsec - started.tv_nsec) / 1e9;
+    printf("Finished in %.2f seconds (%.0f rolls per second).\n", seconds, seconds > 0 ? rolls / seconds : 0.0);
+    printRollStats(&test->totals, "Self-test results");
+
+    for (int die = 0; die < DIE_TYPES; die++) {
+        summarizeDie(&test->totals, die, &summary);
+        if (summary.rolls > 0 && summary.chiSquare > summary.criticalValue) {
+            biased++;
+        }
+    }
+    if (biased == 0) {
+        printf("Every die passed.\n\n");
+    }
+    else {
+        printf("%d die type(s) failed the chi-square test (a fair die fails about 1 time in 1000).\n\n", biased);
+    }
+
+    pthread_mutex_destroy(&test->lock);
+    trackedFree(test, MEMORY_WORK);
+}
+
+void rollStatsMenu(struct Character *head) {
+    TRACE_SPAN("Roll statistics", "menu");
+    char characterName[25];
+    int userChoice, rolls, validInput;
+
+    do {
+        printf("\nRoll Statistics Menu\n");
+        printf("1. Show statistics for every roll\n");
+        printf("2. Show statistics for a character\n");
+        printf("3. Export statistics to rollStats.csv\n");
+        printf("4. Run the dice self-test\n");
+        printf("5. Exit roll statistics menu\n");
+        printf("Enter your choice: ");
+        scanf("%d", &userChoice);
+
+        switch (userChoice) {
+            case 1:
+                printRollStats(&diceStats, "All rolls this session");
+                break;
+            case 2: {
+                getCharacterName(characterName, "Enter the name of your character: ");
+                struct Character *character = findCharacter(head, characterName);
+                if (character == NULL) {
+                    printf("Error: Character not found...\n\n");
+                }
+                else if (character->rollStats == NULL) {
+                    printf("%s hasn't rolled anything yet.\n\n", character->name);
+                }
+                else {
+                    printRollStats(character->rollStats, character->name);
+                }
+                break;
+            }
+            case 3:
+                if (exportRollStats(head, "rollStats.csv") == 0) {
+                    printf("Roll statistics exported to rollStats.csv\n\n");
+                }
+                break;
+            case 4:
+                validInput = 0;
+                while (!validInput) {
+                    printf("How many rolls? (1000-2000000000, 1000000000 recommended): ");
+                    validInput = isValidInput(&rolls, 1000, 2000000000);
+                }
+                diceSelfTest(rolls);
+                break;
+            case 5:
+                break;
+            default:
+                printf("\nInvalid choice, please try again...\n\n");
+                break;
+        }
+    } while (userChoice != 5);
+}
+
+// Attack functions
+int attacksPerAction(struct Character *character) {
+    const char *className = character->class->name;
+    int level = character->level;
+
+    // Fighters get more Extra Attacks than anyone else
+    if (strcmp(className, "Fighter") == 0) {
+        return level >= 20 ? 4 : (level >= 11 ? 3 : (level >= 5 ? 2 : 1));
+    }
+    if (strcmp(className, "Barbarian") == 0 || strcmp(className, "Monk") == 0 ||
+        strcmp(className, "Paladin") == 0 || strcmp(className, "Ranger") == 0) {
+        return level >= 5 ? 2 : 1;
+    }
+    if (strcmp(character->class->subClass, "College of Valor") == 0) {
+        return level >= 6 ? 2 : 1;
+    }
+    return 1;
+}
+
+int criticalRange(struct Character *character) {
+    if (strcmp(character->class->subClass, "Champion") == 0) {
+        return character->level >= 15 ? 18 : (character->level >= 3 ? 19 : 20);
+    }
+    return 20;
+}
+
+int buildAttackAction(struct Character *character, int targetAC, enum AdvantageState advantage, struct AttackAction *action) {
+    struct Weapon *weapon = character->weapon;
+    if (weapon == NULL) {
+        return -1;
+    }
+
+    // Versatile weapons use their two-handed dice when the other hand is free
+    const char *dice = (weapon->isVersatile == 1 && character->hasShield == 0) ? weapon->twoHandDamage : weapon->damageDice;
+    if (parseDice(dice, &action->damageCount, &action->damageSides) != 0) {
+        return -1;
+    }
+
+    int modifier = weaponAbilityModifier(character, weapon);
+    action->attacks = attacksPerAction(character);
+    action->advantage = advantage;
+    action->attackBonus = modifier + character->proficiencyModifier;
+    action->critRange = criticalRange(character);
+    action->damageBonus = modifier;
+    action->targetAC = targetAC;
+    return 0;
+}
+
+// Rolls from the generator when there is one, otherwise through the tracked dice
+static int attackDie(struct Rng *rng, int sides) {
+    return rng != NULL ? rngRoll(rng, sides) : rollDie(sides);
+}
+
+void resolveAttackAction(const struct AttackAction *action, struct Rng *rng, struct AttackResult *result) {
+    result->attacks = action->attacks < MAX_ATTACKS ? action->attacks : MAX_ATTACKS;
+    result->hits = 0;
+    result->criticals = 0;
+    result->damage = 0;
+
+    for (int a = 0; a < result->attacks; a++) {
+        struct AttackRoll *roll = &result->rolls[a];
+
+        roll->natural = attackDie(rng, 20);
+        if (action->advantage != ROLL_NORMAL) {
+            int second = attackDie(rng, 20);
+            if ((action->advantage == ROLL_ADVANTAGE) == (second > roll->natural)) {
+                roll->natural = second;
+            }
+        }
+        roll->total = roll->natural + action->attackBonus;
+
+        // A natural 1 always misses and a critical always hits
+        roll->critical = roll->natural >= action->critRange;
+        roll->hit = roll->natural != 1 && (roll->critical || action->targetAC <= 0 || roll->total >= action->targetAC);
+        roll->damage = 0;
+        if (!roll->hit) {
+            roll->critical = 0;
+            continue;
+        }
+
+        // A critical hit rolls the damage dice twice
+        int dice = action->damageCount * (roll->critical ? 2 : 1);
+        roll->damage = action->damageBonus;
+        for (int d = 0; d < dice; d++) {
+            roll->damage += attackDie(rng, action->damageSides);
+        }
+        if (roll->damage < 1) {
+            roll->damage = 1;
+        }
+
+        result->hits++;
+        result->criticals += roll->critical;
+        result->damage += roll->damage;
+    }
+}
+
+// Shared state for the batch workers
+struct AttackBatch {
+    const struct AttackAction *actions;
+    struct AttackResult *results;
+    unsigned long long seed;
+};
+
+static void attackBatchWorker(int begin, int end, void *arg) {
+    struct AttackBatch *batch = arg;
+    struct Rng rng;
+
+    for (int i = begin; i < end; i++) {
+        rngSeed(&rng, batch->seed + (unsigned long long)i);
+        resolveAttackAction(&batch->actions[i], &rng, &batch->results[i]);
+    }
+}
+
+void resolveAttackActions(const struct AttackAction *actions, int count, unsigned long long seed, struct AttackResult *results) {
+    struct AttackBatch batch = { actions, results, seed };
+    parallelFor(count, attackBatchWorker, &batch);
+}
+
+// Asks whether the action is rolled normally, with advantage or with disadvantage
+static enum AdvantageState selectAdvantage(void) {
+    int choice, validInput = 0;
+
+    printf("1. Normal\n");
+    printf("2. Advantage\n");
+    printf("3. Disadvantage\n");
+    while (!validInput) {
+        printf("Enter your choice: ");
+        validInput = isValidInput(&choice, 1, 3);
+    }
+    return choice == 2 ? ROLL_ADVANTAGE : (choice == 3 ? ROLL_DISADVANTAGE : ROLL_NORMAL);
+}
+
+void makeAttackAction(struct Character *character) {
+    TRACE_SPAN("Attack action", "menu");
+    struct AttackAction action;
+    struct AttackResult result;
+    int targetAC, validInput = 0;
+
+    enum AdvantageState advantage = selectAdvantage();
+    while (!validInput) {
+        printf("Enter the target's Armor Class (0 if there's no target): ");
+        validInput = isValidInput(&targetAC, 0, 30);
+    }
+    if (buildAttackAction(character, targetAC, advantage, &action) != 0) {
+        printf("%s doesn't have a weapon they can attack with.\n\n", character->name);
+        return;
+    }
+
+    auditBegin(AUDIT_ATTACK_ACTION, character);
+    resolveAttackAction(&action, NULL, &result);
+    auditEnd(action.attackBonus, result.damage);
+    for (int a = 0; a < result.attacks; a++) {
+        struct AttackRoll *roll = &result.rolls[a];
+        printf("Attack %d: You rolled %d (%d + %d)", a + 1, roll->total, roll->natural, action.attackBonus);
+        if (roll->critical) {
+            printf(", critical hit for %d damage\n", roll->damage);
+        }
+        else if (roll->hit) {
+            printf(", hit for %d damage\n", roll->damage);
+        }
+        else {
+            printf(", miss\n");
+        }
+    }
+    printf("Total damage: %d\n\n", result.damage);
+}
+
+void attackActionStatistics(struct Character *character) {
+    TRACE_SPAN("Attack action statistics", "menu");
+    struct AttackAction action;
+    int targetAC, count, validInput = 0;
+
+    enum AdvantageState advantage = selectAdvantage();
+    while (!validInput) {
+        printf("Enter the target's Armor Class (1-30): ");
+        validInput = isValidInput(&targetAC, 1, 30);
+    }
+    validInput = 0;
+    while (!validInput) {
+        printf("How many attack actions should be rolled? (1-10000000): ");
+        validInput = isValidInput(&count, 1, 10000000);
+    }
+    if (buildAttackAction(character, targetAC, advantage, &action) != 0) {
+        printf("%s doesn't have a weapon they can attack with.\n\n", character->name);
+        return;
+    }
+
+    struct AttackAction *actions = trackedMalloc(count * sizeof(struct AttackAction), MEMORY_WORK);
+    struct AttackResult *results = trackedMalloc(count * sizeof(struct AttackResult), MEMORY_WORK);
+    if (actions == NULL || results == NULL) {
+        printf("Memory allocation failed.\n");
+        exit(1);
+    }
+    for (int i = 0; i < count; i++) {
+        actions[i] = action;
+    }
+    resolveAttackActions(actions, count, drawDiceSeed(), results);
+
+    unsigned long long attacks = 0, hits = 0, criticals = 0, damage = 0;
+    for (int i = 0; i < count; i++) {
+        attacks += results[i].attacks;
+        hits += results[i].hits;
+        criticals += results[i].criticals;
+        damage += results[i].damage;
+    }
+    trackedFree(actions, MEMORY_WORK);
+    trackedFree(results, MEMORY_WORK);
+
+    printf("\n%s: %d attack(s) per action at +%d, critical on %d-20, %dd%d+%d damage vs AC %d\n", character->name,
+           action.attacks, action.attackBonus, action.critRange, action.damageCount, action.damageSides, action.damageBonus, targetAC);
+    printf("Hit rate: %.1f%%   Critical rate: %.1f%%   Average damage per action: %.2f\n\n",
+           100.0 * hits / attacks, 100.0 * criticals / attacks, (double)damage / count);
+}
+
+// Damage matrix functions
+double averageHitDamage(int count, int sides, int bonus) {
+    // Every hit deals at least 1, which only matters when the bonus can pull the lowest roll below 1
+    if (bonus + count >= 1) {
+        return count * (sides + 1) / 2.0 + bonus;
+    }
+
+    // Otherwise count the ways to roll each total
+    double ways[MAX_ATTACKS * 2 * 12 + 1] = { 1.0 };
+    if (count * sides >= (int)(sizeof(ways) / sizeof(ways[0]))) {
+        return count * (sides + 1) / 2.0 + bonus;
+    }
+    for (int d = 0; d < count; d++) {
+        for (int total = (d + 1) * sides; total >= 0; total--) {
+            double sum = 0.0;
+            for (int face = 1; face <= sides && face <= total; face++) {
+                sum += ways[total - face];
+            }
+            ways[total] = sum;
+        }
+    }
+
+    double outcomes = pow(sides, count), average = 0.0;
+    for (int total = count; total <= count * sides; total++) {
+        int damage = total + bonus;
+        average += ways[total] * (damage > 1 ? damage : 1);
+    }
+    return average / outcomes;
+}
+
+static void damageMatrixLoadWorker(int begin, int end, void *arg) {
+    struct DamageMatrix *matrix = arg;
+    struct AttackAction action;
+
+    for (int i = begin; i < end; i++) {
+        struct Character *character = matrix->characters[i];
+        struct DamageBlock *block = &matrix->blocks[i / MATRIX_LANES];
+        int lane = i % MATRIX_LANES;
+
+        matrix->classIndex[i] = -1;
+        for (int j = 0; j < 12; j++) {
+            if (strcmp(character->class->name, catalog->classes[j][0]) == 0) {
+                matrix->classIndex[i] = j;
+                break;
+            }
+        }
+
+        if (buildAttackAction(character, 0, ROLL_NORMAL, &action) != 0) {
+            continue;   // The block was zeroed, so the character deals no damage
+        }
+        block->attacks[lane] = action.attacks;
+        block->attackBonus[lane] = action.attackBonus;
+        block->critRange[lane] = action.critRange;
+        block->criticals[lane] = 21 - action.critRange;
+        block->hitDamage[lane] = averageHitDamage(action.damageCount, action.damageSides, action.damageBonus);
+        block->critDamage[lane] = averageHitDamage(action.damageCount * 2, action.damageSides, action.damageBonus);
+    }
+}
+
+// Same rules as resolveAttackAction: a natural 1 misses, a natural roll of critRange or more crits,
+// and anything in between hits when it meets the Armor Class
+static void damageMatrixWorker(int begin, int end, void *arg) {
+    struct DamageMatrix *matrix = arg;
+
+    for (int b = begin; b < end; b++) {
+        struct DamageBlock *block = &matrix->blocks[b];
+        for (int column = 0; column < MATRIX_COLUMNS; column++) {
+            float targetAC = MATRIX_MIN_AC + column;
+            for (int lane = 0; lane < MATRIX_LANES; lane++) {
+                float needed = targetAC - block->attackBonus[lane];
+                needed = needed > 2.0f ? needed : 2.0f;
+                float hits = block->critRange[lane] - needed;
+                hits = hits > 0.0f ? hits : 0.0f;
+                block->damage[column][lane] = block->attacks[lane] *
+                    (hits * block->hitDamage[lane] + block->criticals[lane] * block->critDamage[lane]) / 20.0f;
+            }
+        }
+    }
+}
+
+void buildDamageMatrix(struct DamageMatrix *matrix, struct Character **characters, int count) {
+    matrix->characters = characters;
+    matrix->count = count;
+    matrix->blockCount = (count + MATRIX_LANES - 1) / MATRIX_LANES;
+    matrix->classIndex = trackedMalloc(count * sizeof(int), MEMORY_WORK);
+    matrix->blocks = trackedCalloc(matrix->blockCount, sizeof(struct DamageBlock), MEMORY_WORK);
+    if (matrix->classIndex == NULL || matrix->blocks == NULL) {
+        printf("Memory allocation failed.\n");
+        exit(1);
+    }
+
+    parallelFor(count, damageMatrixLoadWorker, matrix);
+    parallelFor(matrix->blockCount, damageMatrixWorker, matrix);
+}
+
+int exportDamageMatrix(const struct DamageMatrix *matrix, const char *fileName) {
+    TRACE_SPAN("exportDamageMatrix", "file write");
+    FILE *file = fopen(fileName, "w");
+    if (file == NULL) {
+        printf("Couldn't open %s.\n", fileName);
+        return -1;
+    }
+    setvbuf(file, NULL, _IOFBF, 1 << 20);
+
+    fprintf(file, "Name,Class,Level,Attacks,AttackBonus,CritRange");
+    for (int column = 0; column < MATRIX_COLUMNS; column++) {
+        fprintf(file, ",AC%d", MATRIX_MIN_AC + column);
+    }
+    fprintf(file, "\n");
+
+    for (int i = 0; i < matrix->count; i++) {
+        const struct Character *character = matrix->characters[i];
+        const struct DamageBlock *block = &matrix->blocks[i / MATRIX_LANES];
+        int lane = i % MATRIX_LANES;
+
+        fprintf(file, "%s,%s,%d,%d,%d,%d", character->name, character->class->name, character->level,
+                (int)block->attacks[lane], (int)block->attackBonus[lane], (int)block->critRange[lane]);
+        for (int column = 0; column < MATRIX_COLUMNS; column++) {
+            fprintf(file, ",%.3f", block->damage[column][lane]);
+        }
+        fprintf(file, "\n");
+    }
+
+    if (fclose(file) != 0) {
+        printf("Couldn't finish writing %s.\n", fileName);
+        return -1;
+    }
+    return 0;
+}
+
+void damageMatrixMenu(struct Character *head) {
+    TRACE_SPAN("Expected damage matrix", "menu");
+    struct CharacterFilter filter;
+    struct DamageMatrix matrix;
+    int count, userChoice, validInput = 0;
+
+    selectCharacterFilter(&filter);
+    struct Character **batch = collectMatchingCharacters(head, &filter, &count);
+    if (count == 0) {
+        printf("\nNo characters match that filter.\n\n");
+        trackedFree(batch, MEMORY_WORK);
+        return;
+    }
+
+    struct timespec started, finished;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    buildDamageMatrix(&matrix, batch, count);
+    clock_gettime(CLOCK_MONOTONIC, &finished);
+
+    // Average each class's column, ready to paste into a heatmap
+    double sums[12][MATRIX_COLUMNS] = { { 0.0 } };
+    int members[12] = { 0 };
+    for (int i = 0; i < count; i++) {
+        int row = matrix.classIndex[i];
+        if (row < 0) {
+            continue;
+        }
+        members[row]++;
+        for (int column = 0; column < MATRIX_COLUMNS; column++) {
+            sums[row][column] += matrix.blocks[i / MATRIX_LANES].damage[column][i % MATRIX_LANES];
+        }
+    }
+
+    printf("\nAverage expected damage per round by target Armor Class\n");
+    printf("%-10s %8s", "Class", "Count");
+    for (int column = 0; column < MATRIX_COLUMNS; column++) {
+        printf(" %5d", MATRIX_MIN_AC + column);
+    }
+    printf("\n");
+    for (int row = 0; row < 12; row++) {
+        if (members[row] == 0) {
+            continue;
+        }
+        printf("%-10s %8d", catalog->classes[row][0], members[row]);
+        for (int column = 0; column < MATRIX_COLUMNS; column++) {
+            printf(" %5.1f", sums[row][column] / members[row]);
+        }
+        printf("\n");
+    }
+    printf("\nWorked out %d character(s) x %d Armor Classes in %.3f seconds.\n", count, MATRIX_COLUMNS,
+           (finished.tv_sec - started.tv_sec) + (finished.tv_nsec - started.tv_nsec) / 1e9);
+
+    printf("\nWrite every character's row to damageMatrix.csv? (1: yes | 0: no)\n");
+    while (!validInput) {
+        printf("Enter your Choice: ");
+        validInput = isValidInput(&userChoice, 0, 1);
+    }
+    if (userChoice == 1 && exportDamageMatrix(&matrix, "damageMatrix.csv") == 0) {
+        printf("Expected damage matrix exported to damageMatrix.csv\n");
+    }
+    printf("\n");
+
+    trackedFree(matrix.classIndex, MEMORY_WORK);
+    trackedFree(matrix.blocks, MEMORY_WORK);
+    trackedFree(batch, MEMORY_WORK);
+}
+
+// History functions
+// Fixed size on-disk form of a version, record N of a spill file is version N
+struct HistoryRecord {
+    int level;
+    int HP;
+    int proficiency;
+    int speed;
+    int hasShield;
+    unsigned char scores[6];
+    char className[50];
+    char subClass[50];
+    char background[50];
+    char race[50];
+    char alignment[50];
+    char armor[50];
+    char weapon[50];
+};
+
+// Worker threads record versions for a bulk edit at the same time, so the total is updated atomically
+static void addHistoryBytes(long bytes) {
+    __atomic_add_fetch(&historyBytes, (size_t)bytes, __ATOMIC_RELAXED);
+}
+
+static void *historyAlloc(size_t size) {
+    void *block = trackedCalloc(1, size, MEMORY_HISTORY);
+    if (block == NULL) {
+        printf("Memory allocation failed.\n");
+        exit(1);
+    }
+    addHistoryBytes((long)size);
+    return block;
+}
+
+static char *historyString(const char *value) {
+    char *copy = trackedStrdup(value ? value : "", MEMORY_HISTORY);
+    if (copy == NULL) {
+        printf("Memory allocation failed.\n");
+        exit(1);
+    }
+    addHistoryBytes((long)strlen(copy) + 1);
+    return copy;
+}
+
+static void historyFilePath(const struct CharacterHistory *history, int id, char *path, size_t size) {
+    unsigned int hash = characterIdHash(id);
+    snprintf(path, size, "%s%s/history/%02x/%02x/%d.bin", history->directory, ROSTER_DIRECTORY, (hash >> 24) & 0xff, (hash >> 16) & 0xff, id);
+}
+
+static void releaseIdentity(struct IdentityBlock *identity) {
+    if (--identity->refs > 0) {
+        return;
+    }
+    char *strings[] = { identity->className, identity->subClass, identity->background, identity->race, identity->alignment };
+    for (int i = 0; i < 5; i++) {
+        addHistoryBytes(-(long)(strlen(strings[i]) + 1));
+        trackedFree(strings[i], MEMORY_HISTORY);
+    }
+    addHistoryBytes(-(long)sizeof(*identity));
+    trackedFree(identity, MEMORY_HISTORY);
+}
+
+static void releaseVersion(struct CharacterVersion *version) {
+    releaseIdentity(version->identity);
+    if (--version->abilities->refs == 0) {
+        addHistoryBytes(-(long)sizeof(*version->abilities));
+        trackedFree(version->abilities, MEMORY_HISTORY);
+    }
+    if (--version->equipment->refs == 0) {
+        addHistoryBytes(-(long)sizeof(*version->equipment));
+        trackedFree(version->equipment, MEMORY_HISTORY);
+    }
+    addHistoryBytes(-(long)sizeof(*version));
+    trackedFree(version, MEMORY_HISTORY);
+}
+
+// Returns the in-memory copy of a version, or NULL if it has been spilled
+static struct CharacterVersion *versionInMemory(struct CharacterHistory *history, int number) {
+    if (number < history->firstInMemory || number >= history->count) {
+        return NULL;
+    }
+    return history->versions[number - history->firstInMemory];
+}
+
+static int readHistoryRecord(const struct CharacterHistory *history, int id, int number, struct HistoryRecord *record) {
+    char path[100];
+    historyFilePath(history, id, path, sizeof(path));
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return -1;
+    }
+    int found = fseek(file, (long)number * sizeof(*record), SEEK_SET) == 0 && fread(record, sizeof(*record), 1, file) == 1;
+    fclose(file);
+    return found ? 0 : -1;
+}
+
+// Fills view with version number of the character. The view borrows its strings from the version
+// (or from record if the version was spilled), so it must not be freed or outlive them.
+static int versionView(struct Character *character, int number, struct Character *view, struct Class *viewClass, struct HistoryRecord *record) {
+    struct CharacterVersion *version = versionInMemory(character->history, number);
+
+    memset(view, 0, sizeof(*view));
+    memset(viewClass, 0, sizeof(*viewClass));
+    snprintf(view->name, sizeof(view->name), "%s", character->name);
+    view->class = viewClass;
+
+    if (version != NULL) {
+        view->level = version->level;
+        view->HP = version->HP;
+        view->proficiencyModifier = version->proficiency;
+        view->speed = version->speed;
+        viewClass->name = version->identity->className;
+        viewClass->subClass = version->identity->subClass;
+        view->background = version->identity->background;
+        view->race = version->identity->race;
+        view->alignment = version->identity->alignment;
+        view->strength = version->abilities->scores[0];
+        view->dexterity = version->abilities->scores[1];
+        view->constitution = version->abilities->scores[2];
+        view->intelligence = version->abilities->scores[3];
+        view->wisdom = version->abilities->scores[4];
+        view->charisma = version->abilities->scores[5];
+        view->armor = version->equipment->armor;
+        view->weapon = version->equipment->weapon;
+        view->hasShield = version->equipment->hasShield;
+        return 0;
+    }
+
+    if (readHistoryRecord(character->history, character->id, number, record) != 0) {
+        return -1;
+    }
+    view->level = record->level;
+    view->HP = record->HP;
+    view->proficiencyModifier = record->proficiency;
+    view->speed = record->speed;
+    viewClass->name = record->className;
+    viewClass->subClass = record->subClass;
+    view->background = record->background;
+    view->race = record->race;
+    view->alignment = record->alignment;
+    view->strength = record->scores[0];
+    view->dexterity = record->scores[1];
+    view->constitution = record->scores[2];
+    view->intelligence = record->scores[3];
+    view->wisdom = record->scores[4];
+    view->charisma = record->scores[5];
+    view->armor = findArmor(record->armor);
+    view->weapon = findWeapon(record->weapon);
+    view->hasShield = record->hasShield;
+    if (view->armor == NULL) {
+        view->armor = &catalog->armors[0];
+    }
+    if (view->weapon == NULL) {
+        view->weapon = &catalog->weapons[0];
+    }
+    return 0;
+}
+
+// Builds a version of the character as it is now, sharing any block that matches previous
+static struct CharacterVersion *snapshotCharacter(struct Character *character, struct CharacterVersion *previous) {
+    struct CharacterVersion *version = historyAlloc(sizeof(struct CharacterVersion));
+    unsigned char scores[6] = {
+        character->strength, character->dexterity, character->constitution,
+        character->intelligence, character->wisdom, character->charisma
+    };
+
+    version->level = character->level;
+    version->HP = character->HP;
+    version->proficiency = character->proficiencyModifier;
+    version->speed = character->speed;
+
+    if (previous != NULL && strcmp(previous->identity->className, character->class->name) == 0 &&
+        strcmp(previous->identity->subClass, character->class->subClass) == 0 &&
+        strcmp(previous->identity->background, character->background) == 0 &&
+        strcmp(previous->identity->race, character->race) == 0 &&
+        strcmp(previous->identity->alignment, character->alignment) == 0) {
+        version->identity = previous->identity;
+    }
+    else {
+        version->identity = historyAlloc(sizeof(struct IdentityBlock));
+        version->identity->className = historyString(character->class->name);
+        version->identity->subClass = historyString(character->class->subClass);
+        version->identity->background = historyString(character->background);
+        version->identity->race = historyString(character->race);
+        version->identity->alignment = historyString(character->alignment);
+    }
+
+    if (previous != NULL && memcmp(previous->abilities->scores, scores, sizeof(scores)) == 0) {
+        version->abilities = previous->abilities;
+    }
+    else {
+        version->abilities = historyAlloc(sizeof(struct AbilityBlock));
+        memcpy(version->abilities->scores, scores, sizeof(scores));
+    }
+
+    if (previous != NULL && previous->equipment->armor == character->armor &&
+        previous->equipment->weapon == character->weapon && previous->equipment->hasShield == character->hasShield) {
+        version->equipment = previous->equipment;
+    }
+    else {
+        version->equipment = historyAlloc(sizeof(struct EquipmentBlock));
+        version->equipment->armor = character->armor;
+        version->equipment->weapon = character->weapon;
+        version->equipment->hasShield = character->hasShield;
+    }
+
+    version->identity->refs++;
+    version->abilities->refs++;
+    version->equipment->refs++;
+    return version;
+}
+
+static void appendVersion(struct CharacterHistory *history, struct CharacterVersion *version) {
+    int inMemory = history->count - history->firstInMemory;
+    if (inMemory == history->capacity) {
+        int capacity = history->capacity ? history->capacity * 2 : 4;
+        struct CharacterVersion **versions = trackedRealloc(history->versions, capacity * sizeof(struct CharacterVersion *), MEMORY_HISTORY);
+        if (versions == NULL) {
+            printf("Memory allocation failed.\n");
+            exit(1);
+        }
+        addHistoryBytes((long)(capacity - history->capacity) * (long)sizeof(struct CharacterVersion *));
+        history->versions = versions;
+        history->capacity = capacity;
+    }
+    version->number = history->count;
+    history->versions[inMemory] = version;
+    history->count++;
+}
+
+void beginHistory(struct Character *character) {
+    if (character->history != NULL) {
+        return;
+    }
+    character->history = historyAlloc(sizeof(struct CharacterHistory));
+    snprintf(character->history->directory, sizeof(character->history->directory), "%s", campaignDirectory);
+    appendVersion(character->history, snapshotCharacter(character, NULL));
+}
+
+int recordVersion(struct Character *character) {
+    if (character->history == NULL) {
+        beginHistory(character);
+        return 0;
+    }
+    struct CharacterHistory *history = character->history;
+    struct CharacterVersion *previous = versionInMemory(history, history->current);
+    struct CharacterVersion *version = snapshotCharacter(character, previous);
+
+    // Nothing changed if every block was shared and the plain fields match
+    if (previous != NULL && version->identity == previous->identity && version->abilities == previous->abilities &&
+        version->equipment == previous->equipment && version->level == previous->level && version->HP == previous->HP &&
+        version->proficiency == previous->proficiency && version->speed == previous->speed) {
+        releaseVersion(version);
+        return 0;
+    }
+
+    // A new edit after an undo drops the versions that could have been redone
+    while (history->count > history->current + 1) {
+        struct CharacterVersion *dropped = versionInMemory(history, history->count - 1);
+        if (dropped != NULL) {
+            releaseVersion(dropped);
+        }
+        history->count--;
+    }
+    if (history->firstInMemory > history->count) {
+        history->firstInMemory = history->count;
+    }
+
+    appendVersion(history, version);
+    history->current = version->number;
+    return 1;
+}
+
+static void beginHistoryWorker(int begin, int end, void *arg) {
+    struct Character **batch = arg;
+    for (int i = begin; i < end; i++) {
+        beginHistory(batch[i]);
+    }
+}
+
+static void recordVersionWorker(int begin, int end, void *arg) {
+    struct Character **batch = arg;
+    for (int i = begin; i < end; i++) {
+        recordVersion(batch[i]);
+    }
+}
+
+void beginHistories(struct Character **batch, int count) {
+    parallelFor(count, beginHistoryWorker, batch);
+}
+
+void recordVersions(struct Character **batch, int count) {
+    parallelFor(count, recordVersionWorker, batch);
+}
+
+// Copies version number into the live character
+static int applyVersion(struct Character *character, int number) {
+    struct Character view;
+    struct Class viewClass;
+    struct HistoryRecord record;
+
+    if (versionView(character, number, &view, &viewClass, &record) != 0) {
+        printf("Couldn't read version %d of %s.\n", number + 1, character->name);
+        return -1;
+    }
+    character->level = view.level;
+    character->HP = view.HP;
+    character->proficiencyModifier = view.proficiencyModifier;
+    character->speed = view.speed;
+    replaceString(&character->class->name, view.class->name);
+    replaceString(&character->class->subClass, view.class->subClass);
+    replaceString(&character->background, view.background);
+    replaceString(&character->race, view.race);
+    replaceString(&character->alignment, view.alignment);
+    initializeHitDie(character);
+    character->strength = view.strength;
+    character->dexterity = view.dexterity;
+    character->constitution = view.constitution;
+    character->intelligence = view.intelligence;
+    character->wisdom = view.wisdom;
+    character->charisma = view.charisma;
+    character->armor = view.armor;
+    character->weapon = view.weapon;
+    character->hasShield = view.hasShield;
+    character->history->current = number;
+    return 0;
+}
+
+int undoVersion(struct Character *character) {
+    if (character->history == NULL || character->history->current == 0) {
+        return -1;
+    }
+    return applyVersion(character, character->history->current - 1);
+}
+
+int redoVersion(struct Character *character) {
+    if (character->history == NULL || character->history->current + 1 >= character->history->count) {
+        return -1;
+    }
+    return applyVersion(character, character->history->current + 1);
+}
+
+void historyMenu(struct Character *character) {
+    struct CharacterHistory *history = character->history;
+    struct Character view;
+    struct Class viewClass;
+    struct HistoryRecord record;
+    int number, validInput = 0;
+
+    if (history == NULL) {
+        printf("%s has no history yet.\n", character->name);
+        return;
+    }
+
+    printf("\nHistory of %s:\n", character->name);
+    for (int i = 0; i < history->count; i++) {
+        if (versionView(character, i, &view, &viewClass, &record) != 0) {
+            printf("%3d. (couldn't be read)\n", i + 1);
+            continue;
+        }
+        printf("%3d. Level %d %s (%s), %s %s, %s, %s%s%s\n", i + 1, view.level, view.class->name, view.class->subClass,
+               view.race, view.background, view.armor->name, view.weapon->name, view.hasShield ? " and Shield" : "",
+               i == history->current ? "  <- current" : "");
+    }
+
+    while (!validInput) {
+        printf("Enter a version to show in full (0 to go back): ");
+        validInput = isValidInput(&number, 0, history->count);
+    }
+    if (number == 0) {
+        return;
+    }
+    if (versionView(character, number - 1, &view, &viewClass, &record) != 0) {
+        printf("Couldn't read version %d of %s.\n", number, character->name);
+        return;
+    }
+    printf("\n%s as of version %d:\n", character->name, number);
+    printCharacterRecord(stdout, &view);
+}
+
+// Writes every in-memory version older than the current one to the character's spill file
+static void spillHistory(struct Character *character) {
+    TRACE_SPAN("spillHistory", "file write");
+    struct CharacterHistory *history = character->history;
+    struct HistoryRecord record;
+    char path[100];
+
+    if (history == NULL || history->firstInMemory >= history->current) {
+        return;
+    }
+
+    historyFilePath(history, character->id, path, sizeof(path));
+    FILE *file = fopen(path, history->firstInMemory == 0 ? "wb" : "r+b");
+    if (file == NULL) {
+        // Parent directories are missing, create them from the top down
+        unsigned int hash = characterIdHash(character->id);
+        snprintf(path, sizeof(path), "%s%s", history->directory, ROSTER_DIRECTORY);
+        mkdir(path, 0755);
+        snprintf(path, sizeof(path), "%s%s/history", history->directory, ROSTER_DIRECTORY);
+        mkdir(path, 0755);
+        snprintf(path, sizeof(path), "%s%s/history/%02x", history->directory, ROSTER_DIRECTORY, (hash >> 24) & 0xff);
+        mkdir(path, 0755);
+        snprintf(path, sizeof(path), "%s%s/history/%02x/%02x", history->directory, ROSTER_DIRECTORY, (hash >> 24) & 0xff, (hash >> 16) & 0xff);
+        mkdir(path, 0755);
+        historyFilePath(history, character->id, path, sizeof(path));
+        file = fopen(path, "wb");
+        if (file == NULL) {
+            return;
+        }
+    }
+
+    int spilled = 0;
+    if (fseek(file, (long)history->firstInMemory * sizeof(record), SEEK_SET) == 0) {
+        while (history->firstInMemory + spilled < history->current) {
+            struct CharacterVersion *version = history->versions[spilled];
+            memset(&record, 0, sizeof(record));
+            record.level = version->level;
+            record.HP = version->HP;
+            record.proficiency = version->proficiency;
+            record.speed = version->speed;
+            record.hasShield = version->equipment->hasShield;
+            memcpy(record.scores, version->abilities->scores, sizeof(record.scores));
+            snprintf(record.className, sizeof(record.className), "%s", version->identity->className);
+            snprintf(record.subClass, sizeof(record.subClass), "%s", version->identity->subClass);
+            snprintf(record.background, sizeof(record.background), "%s", version->identity->background);
+            snprintf(record.race, sizeof(record.race), "%s", version->identity->race);
+            snprintf(record.alignment, sizeof(record.alignment), "%s", version->identity->alignment);
+            snprintf(record.armor, sizeof(record.armor), "%s", version->equipment->armor ? version->equipment->armor->name : "");
+            snprintf(record.weapon, sizeof(record.weapon), "%s", version->equipment->weapon ? version->equipment->weapon->name : "");
+            if (fwrite(&record, sizeof(record), 1, file) != 1) {
+                break;
+            }
+            spilled++;
+        }
+    }
+    if (fclose(file) != 0) {
+        spilled = 0;      // Keep everything in memory if the records might not have been written
+    }
+
+    // Drop the spilled versions from memory
+    for (int i = 0; i < spilled; i++) {
+        releaseVersion(history->versions[i]);
+    }
+    int inMemory = history->count - history->firstInMemory - spilled;
+    memmove(history->versions, history->versions + spilled, inMemory * sizeof(struct CharacterVersion *));
+    history->firstInMemory += spilled;
+}
+
+void enforceHistoryBudget(struct Character *head) {
+    if (historyBytes <= historyBudget) {
+        return;
+    }
+    for (struct Character *current = head; current != NULL && historyBytes > historyBudget; current = current->next) {
+        spillHistory(current);
+    }
+}
+
+void freeHistory(struct Character *character) {
+    struct CharacterHistory *history = character->history;
+    char path[100];
+
+    if (history == NULL) {
+        return;
+    }
+    for (int i = history->firstInMemory; i < history->count; i++) {
+        releaseVersion(history->versions[i - history->firstInMemory]);
+    }
+    if (history->firstInMemory > 0) {
+        historyFilePath(history, character->id, path, sizeof(path));
+        remove(path);
+    }
+    addHistoryBytes(-(long)(history->capacity * sizeof(struct CharacterVersion *) + sizeof(*history)));
+    trackedFree(history->versions, MEMORY_HISTORY);
+    trackedFree(history, MEMORY_HISTORY);
+    character->history = NULL;
+}
+
+// Packed roster functions
+#define PACKED_MAGIC "DNDPACK1"
+
+_Static_assert(sizeof(struct PackedCharacter) <= 32, "packed characters should stay within 32 bytes");
+
+// Returns the index of value in a catalog array, or -1
+static int catalogIndex(const char *value, char **values, int count) {
+    for (int i = 0; i < count; i++) {
+        if (strcmp(values[i], value) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static struct PackedCharacter *packedSlot(struct PackedRoster *roster) {
+    if (roster->count == roster->capacity) {
+        int capacity = roster->capacity ? roster->capacity * 2 : 1024;
+        struct PackedCharacter *characters = trackedRealloc(roster->characters, capacity * sizeof(struct PackedCharacter), MEMORY_ROSTER);
+        if (characters == NULL) {
+            printf("Memory allocation failed.\n");
+            exit(1);
+        }
+        roster->characters = characters;
+        roster->capacity = capacity;
+    }
+    return &roster->characters[roster->count];
+}
+
+static unsigned int packName(struct PackedRoster *roster, const char *name) {
+    size_t length = strlen(name) + 1;
+    if (roster->namesUsed + length > roster->namesCapacity) {
+        size_t capacity = roster->namesCapacity ? roster->namesCapacity * 2 : 16384;
+        char *names = trackedRealloc(roster->names, capacity, MEMORY_NAMES);
+        if (names == NULL) {
+            printf("Memory allocation failed.\n");
+            exit(1);
+        }
+        roster->names = names;
+        roster->namesCapacity = capacity;
+    }
+    unsigned int offset = (unsigned int)roster->namesUsed;
+    memcpy(roster->names + offset, name, length);
+    roster->namesUsed += length;
+    return offset;
+}
+
+int packCharacter(struct PackedRoster *roster, struct Character *character) {
+    struct PackedCharacter packed;
+    int classId = -1, subClassId = PACKED_NONE;
+
+    for (int i = 0; i < 12; i++) {
+        if (strcmp(catalog->classes[i][0], character->class->name) == 0) {
+            classId = i;
+            break;
+        }
+    }
+    if (classId < 0) {
+        return -1;
+    }
+    if (strcmp(character->class->subClass, "N/A") != 0) {
+        subClassId = catalogIndex(character->class->subClass, catalog->classes[classId], 5);
+        if (subClassId < 1) {
+            return -1;
+        }
+    }
+    int backgroundId = catalogIndex(character->background, catalog->backgrounds, 16);
+    int raceId = catalogIndex(character->race, catalog->races, 10);
+    int alignmentId = catalogIndex(character->alignment, catalog->alignments, 9);
+    struct Armor *armor = character->armor ? findArmor(character->armor->name) : NULL;
+    struct Weapon *weapon = character->weapon ? findWeapon(character->weapon->name) : NULL;
+    if (backgroundId < 0 || raceId < 0 || alignmentId < 0 || armor == NULL || weapon == NULL) {
+        return -1;
+    }
+
+    memset(&packed, 0, sizeof(packed));
+    packed.id = character->id;
+    packed.HP = character->HP;
+    packed.level = character->level;
+    packed.proficiency = character->proficiencyModifier;
+    packed.speed = character->speed;
+    packed.classId = classId;
+    packed.subClassId = subClassId;
+    packed.backgroundId = backgroundId;
+    packed.raceId = raceId;
+    packed.alignmentId = alignmentId;
+    packed.armorId = armor - catalog->armors;
+    packed.weaponId = weapon - catalog->weapons;
+    packed.scores[0] = character->strength;
+    packed.scores[1] = character->dexterity;
+    packed.scores[2] = character->constitution;
+    packed.scores[3] = character->intelligence;
+    packed.scores[4] = character->wisdom;
+    packed.scores[5] = character->charisma;
+    packed.hasShield = character->hasShield;
+
+    packed.nameOffset = packName(roster, character->name);
+    *packedSlot(roster) = packed;
+    roster->count++;
+    return 0;
+}
+
+static char *unpackString(const char *value) {
+    char *copy = trackedStrdup(value, MEMORY_ROSTER);
+    if (copy == NULL) {
+        printf("Memory allocation failed.\n");
+        exit(1);
+    }
+    return copy;
+}
+
+void unpackCharacter(const struct PackedRoster *roster, const struct PackedCharacter *packed, struct Character *character) {
+    memset(character, 0, sizeof(*character));
+    character->class = trackedMalloc(sizeof(struct Class), MEMORY_ROSTER);
+    if (character->class == NULL) {
+        printf("Memory allocation failed.\n");
+        exit(1);
+    }
+
+    character->id = packed->id;
+    snprintf(character->name, sizeof(character->name), "%s", roster->names + packed->nameOffset);
+    character->level = packed->level;
+    character->class->name = unpackString(catalog->classes[packed->classId][0]);
+    character->class->subClass = unpackString(packed->subClassId == PACKED_NONE ? "N/A" : catalog->classes[packed->classId][packed->subClassId]);
+    initializeHitDie(character);
+    character->background = unpackString(catalog->backgrounds[packed->backgroundId]);
+    character->race = unpackString(catalog->races[packed->raceId]);
+    character->alignment = unpackString(catalog->alignments[packed->alignmentId]);
+    character->strength = packed->scores[0];
+    character->dexterity = packed->scores[1];
+    character->constitution = packed->scores[2];
+    character->intelligence = packed->scores[3];
+    character->wisdom = packed->scores[4];
+    character->charisma = packed->scores[5];
+    character->speed = packed->speed;
+    character->armor = &catalog->armors[packed->armorId];
+    character->weapon = &catalog->weapons[packed->weaponId];
+    character->hasShield = packed->hasShield;
+    character->proficiencyModifier = packed->proficiency;
+    character->HP = packed->HP;
+    character->isLoaded = 1;
+}
+
+void freeUnpackedCharacter(struct Character *character) {
+    releaseCharacterDetails(character);
+}
+
+void freePackedRoster(struct PackedRoster *roster) {
+    trackedFree(roster->characters, MEMORY_ROSTER);
+    trackedFree(roster->names, MEMORY_NAMES);
+    memset(roster, 0, sizeof(*roster));
+}
+
+// File layout: magic, record count, record size, name bytes, the records, then the name arena
+int savePackedRoster(const struct PackedRoster *roster, const char *fileName) {
+    TRACE_SPAN("savePackedRoster", "file write");
+    char tempName[256];
+    unsigned int header[2] = { (unsigned int)roster->count, (unsigned int)sizeof(struct PackedCharacter) };
+    unsigned long long nameBytes = roster->namesUsed;
+
+    snprintf(tempName, sizeof(tempName), "%s.tmp", fileName);
+    FILE *file = fopen(tempName, "wb");
+    if (file == NULL) {
+        printf("Couldn't open %s.\n", tempName);
+        return -1;
+    }
+    int written = fwrite(PACKED_MAGIC, 8, 1, file) == 1 && fwrite(header, sizeof(header), 1, file) == 1 &&
+                  fwrite(&nameBytes, sizeof(nameBytes), 1, file) == 1 &&
+                  fwrite(roster->characters, sizeof(struct PackedCharacter), roster->count, file) == (size_t)roster->count &&
+                  fwrite(roster->names, 1, roster->namesUsed, file) == roster->namesUsed;
+    written = fflush(file) == 0 && written && fsync(fileno(file)) == 0;
+    if (fclose(file) != 0 || !written || rename(tempName, fileName) != 0) {
+        printf("Couldn't write %s.\n", fileName);
+        remove(tempName);
+        return -1;
+    }
+    return 0;
+}
+
+int loadPackedRoster(struct PackedRoster *roster, const char *fileName) {
+    TRACE_SPAN("loadPackedRoster", "roster");
+    char magic[8];
+    unsigned int header[2];
+    unsigned long long nameBytes;
+
+    memset(roster, 0, sizeof(*roster));
+    FILE *file = fopen(fileName, "rb");
+    if (file == NULL) {
+        return -1;
+    }
+    if (fread(magic, 8, 1, file) != 1 || memcmp(magic, PACKED_MAGIC, 8) != 0 || fread(header, sizeof(header), 1, file) != 1 ||
+        header[1] != sizeof(struct PackedCharacter) || fread(&nameBytes, sizeof(nameBytes), 1, file) != 1) {
+        printf("%s isn't a packed roster this program can read.\n", fileName);
+        fclose(file);
+        return -1;
+    }
+
+    // The counts have to add up to the file's size before anything is allocated from them
+    struct stat info;
+    unsigned long long headerBytes = 8 + sizeof(header) + sizeof(nameBytes);
+    unsigned long long recordBytes = (unsigned long long)header[0] * sizeof(struct PackedCharacter);
+    if (fstat(fileno(file), &info) != 0 || header[0] > INT_MAX || (unsigned long long)info.st_size < headerBytes + recordBytes ||
+        nameBytes != (unsigned long long)info.st_size - headerBytes - recordBytes) {
+        printf("%s is damaged, its record count does not match its size.\n", fileName);
+        fclose(file);
+        return -1;
+    }
+
+    roster->count = roster->capacity = (int)header[0];
+    roster->namesUsed = roster->namesCapacity = (size_t)nameBytes;
+    roster->characters = trackedMalloc((roster->count ? roster->count : 1) * sizeof(struct PackedCharacter), MEMORY_ROSTER);
+    roster->names = trackedMalloc(roster->namesUsed ? roster->namesUsed : 1, MEMORY_NAMES);
+    if (roster->characters == NULL || roster->names == NULL) {
+        printf("Memory allocation failed.\n");
+        exit(1);
+    }
+    int valid = fread(roster->characters, sizeof(struct PackedCharacter), roster->count, file) == (size_t)roster->count &&
+                fread(roster->names, 1, roster->namesUsed, file) == roster->namesUsed;
+    fclose(file);
+
+    // Every index has to point into its catalog before anything is unpacked
+    for (int i = 0; valid && i < roster->count; i++) {
+        struct PackedCharacter *packed = &roster->characters[i];
+        valid = packed->nameOffset < roster->namesUsed && memchr(roster->names + packed->nameOffset, '\0', roster->namesUsed - packed->nameOffset) != NULL &&
+                packed->classId < 12 && (packed->subClassId == PACKED_NONE || (packed->subClassId >= 1 && packed->subClassId <= 4)) &&
+                packed->backgroundId < 16 && packed->raceId < 10 && packed->alignmentId < 9 && packed->armorId < 13 && packed->weaponId < 31;
+    }
+    if (!valid) {
+        printf("%s is damaged.\n", fileName);
+        freePackedRoster(roster);
+        return -1;
+    }
+    return 0;
+}
+
+// Shared state for generating a chunk of a packed roster
+struct PackedGeneration {
+    struct Character *scratch;
+    unsigned long long seed;
+    int first;
+    int firstId;              // ID of the roster's first character
+};
+
+static void packedGenerationWorker(int begin, int end, void *arg) {
+    struct PackedGeneration *generation = arg;
+    struct Rng rng;
+
+    for (int i = begin; i < end; i++) {
+        // Seeded by position like generateCharacters, so both give the same characters for a seed
+        rngSeed(&rng, generation->seed + (unsigned long long)(generation->first + i));
+        generateCharacter(&rng, generation->firstId + generation->first + i, &generation->scratch[i]);
+    }
+}
+
+void generatePackedRoster(int count, unsigned long long seed, const char *fileName) {
+    const int chunk = 65536;
+    struct PackedRoster roster = { 0 };
+    struct PackedGeneration generation;
+    struct timespec started, finished;
+
+    generation.scratch = trackedMalloc(chunk * sizeof(struct Character), MEMORY_WORK);
+    if (generation.scratch == NULL) {
+        printf("Memory allocation failed.\n");
+        exit(1);
+    }
+    generation.seed = seed;
+    // Continue from the roster's IDs (and reserve them) so the packed characters' IDs and numbered names stay clear of it
+    generation.firstId = nextCharacterId;
+    nextCharacterId += count;
+
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    for (generation.first = 0; generation.first < count; generation.first += chunk) {
+        int size = count - generation.first < chunk ? count - generation.first : chunk;
+        parallelFor(size, packedGenerationWorker, &generation);
+
+        // Names go into the shared arena in order, so packing stays on this thread
+        for (int i = 0; i < size; i++) {
+            packCharacter(&roster, &generation.scratch[i]);
+            releaseCharacterDetails(&generation.scratch[i]);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &finished);
+    trackedFree(generation.scratch, MEMORY_WORK);
+
+    double seconds = (finished.tv_sec - started.tv_sec) + (finished.tv_nsec - started.tv_nsec) / 1e9;
+    printf("Generated %d character(s) in %.3f seconds (%.0f per second, seed %llu).\n", count, seconds,
+           seconds > 0 ? count / seconds : 0.0, seed);
+    if (savePackedRoster(&roster, fileName) == 0) {
+        printf("Saved them to %s (%.1f MB).\n", fileName,
+               (roster.count * sizeof(struct PackedCharacter) + roster.namesUsed) / (1024.0 * 1024.0));
+    }
+    printf("\n");
+    freePackedRoster(&roster);
+}
+
+static void printPackedRosterSize(const struct PackedRoster *roster, const char *fileName) {
+    size_t recordBytes = roster->count * sizeof(struct PackedCharacter);
+    printf("%s holds %d character(s): %.1f MB of records (%d bytes each) and %.1f MB of names.\n", fileName, roster->count,
+           recordBytes / (1024.0 * 1024.0), (int)sizeof(struct PackedCharacter), roster->namesUsed / (1024.0 * 1024.0));
+}
+
+void packedRosterMenu(struct Character **head) {
+    TRACE_SPAN("Packed roster tools", "menu");
+    struct PackedRoster roster;
+    struct Character character;
+    char characterName[25];
+    char packPath[100];
+    int userChoice;
+
+    campaignFilePath("roster.pack", packPath, sizeof(packPath));
+    do {
+        printf("\nPacked Roster Menu\n");
+        printf("1. Pack the roster into roster.pack\n");
+        printf("2. Find a character in roster.pack\n");
+        printf("3. Import roster.pack into the roster\n");
+        printf("4. Export the roster to roster.cols (columnar)\n");
+        printf("5. Exit packed roster menu\n");
+        printf("Enter your choice: ");
+        scanf("%d", &userChoice);
+
+        switch (userChoice) {
+            case 1: {
+                int skipped = 0;
+                memset(&roster, 0, sizeof(roster));
+                for (struct Character *current = *head; current != NULL; current = current->next) {
+                    int wasLoaded = current->isLoaded;
+                    if (ensureLoaded(current) != 0) {
+                        skipped++;
+                        continue;
+                    }
+                    if (packCharacter(&roster, current) != 0) {
+                        skipped++;
+                    }
+                    // Don't leave the whole roster loaded behind us with --lazy
+                    if (!wasLoaded) {
+                        unloadCharacter(current);
+                    }
+                }
+                if (savePackedRoster(&roster, packPath) == 0) {
+                    printPackedRosterSize(&roster, packPath);
+                }
+                if (skipped > 0) {
+                    printf("%d character(s) use something that isn't in the catalogs and weren't packed.\n", skipped);
+                }
+                freePackedRoster(&roster);
+                break;
+            }
+            case 2: {
+                if (loadPackedRoster(&roster, packPath) != 0) {
+                    printf("Couldn't read roster.pack.\n");
+                    break;
+                }
+                printPackedRosterSize(&roster, packPath);
+                getCharacterName(characterName, "Enter the name of the character: ");
+                int found = 0;
+                for (int i = 0; i < roster.count; i++) {
+                    if (strcmp(roster.names + roster.characters[i].nameOffset, characterName) == 0) {
+                        unpackCharacter(&roster, &roster.characters[i], &character);
+                        printf("\n");
+                        printCharacterRecord(stdout, &character);
+                        freeUnpackedCharacter(&character);
+                        found++;
+                    }
+                }
+                if (found == 0) {
+                    printf("Your character could not be found :(\n");
+                }
+                freePackedRoster(&roster);
+                break;
+            }
+            case 3: {
+                if (loadPackedRoster(&roster, packPath) != 0) {
+                    printf("Couldn't read roster.pack.\n");
+                    break;
+                }
+                struct Character **imported = trackedMalloc((roster.count ? roster.count : 1) * sizeof(struct Character *), MEMORY_WORK);
+                if (imported == NULL) {
+                    printf("Memory allocation failed.\n");
+                    exit(1);
+                }
+                for (int i = 0; i < roster.count; i++) {
+                    imported[i] = trackedMalloc(sizeof(struct Character), MEMORY_ROSTER);
+                    if (imported[i] == NULL) {
+                        printf("Memory allocation failed.\n");
+                        exit(1);
+                    }
+                    unpackCharacter(&roster, &roster.characters[i], imported[i]);
+                }
+
+                // Names have to stay unique, so characters the roster already has a name for are left out
+                int count = dropTakenNames(*head, imported, roster.count);
+                for (int i = 0; i < count; i++) {
+                    imported[i]->id = nextCharacterId++;
+                }
+
+                // Imported characters are saved like generated ones and linked in index order
+                saveNewCharacters(imported, count);
+                for (int i = 0; i < count; i++) {
+                    imported[i]->next = *head;
+                    *head = imported[i];
+                }
+                nameFilterAddMany(*head, imported, count);
+                printf("Imported %d character(s) from roster.pack.\n", count);
+                if (count < roster.count) {
+                    printf("%d character(s) were left out because another character already has the name.\n", roster.count - count);
+                }
+                trackedFree(imported, MEMORY_WORK);
+                freePackedRoster(&roster);
+                break;
+            }
+            case 4: {
+                struct CharacterFilter filter = { .className = "", .race = "", .minLevel = 1, .maxLevel = MAX_LEVEL };
+                char columnsPath[100];
+                int count;
+
+                readFilterExpression(&filter.expression);
+                struct Character **characters = collectMatchingCharacters(*head, &filter, &count);
+                campaignFilePath("roster.cols", columnsPath, sizeof(columnsPath));
+
+                struct timespec started, finished;
+                clock_gettime(CLOCK_MONOTONIC, &started);
+                if (exportRosterColumns(characters, count, columnsPath) == 0) {
+                    clock_gettime(CLOCK_MONOTONIC, &finished);
+                    struct stat info;
+                    double seconds = (finished.tv_sec - started.tv_sec) + (finished.tv_nsec - started.tv_nsec) / 1e9;
+                    double megabytes = stat(columnsPath, &info) == 0 ? info.st_size / (1024.0 * 1024.0) : 0.0;
+                    printf("Exported %d character(s) to roster.cols (%.1f MB) in %.3f seconds.\n", count, megabytes, seconds);
+                }
+                trackedFree(characters, MEMORY_WORK);
+                break;
+            }
+            case 5:
+                break;
+            default:
+                printf("\nInvalid choice, please try again...\n\n");
+                break;
+        }
+    } while (userChoice != 5);
+}
+
+// Columnar export functions
+enum ColumnDictionary {
+    DICTIONARY_NONE,
+    DICTIONARY_CLASS,
+    DICTIONARY_SUBCLASS,          // "N/A", then every class's four subclasses in catalog order
+    DICTIONARY_BACKGROUND,
+    DICTIONARY_RACE,
+    DICTIONARY_ALIGNMENT,
+    DICTIONARY_ARMOR,
+    DICTIONARY_WEAPON
+};
+
+#define ARMOR_CLASS_OFFSET ((size_t)-1)  // Column offset meaning "work out the Armor Class from the equipment"
+
+static const struct {
+    const char *name;
+    enum ColumnType type;
+    size_t offset;                // Offset of the int field in struct Character for number columns
+    enum ColumnDictionary dictionary;
+} rosterColumns[] = {
+    { "id", COLUMN_INT32, offsetof(struct Character, id), DICTIONARY_NONE },
+    { "name", COLUMN_STRING, 0, DICTIONARY_NONE },
+    { "level", COLUMN_UINT8, offsetof(struct Character, level), DICTIONARY_NONE },
+    { "class", COLUMN_DICTIONARY, 0, DICTIONARY_CLASS },
+    { "subclass", COLUMN_DICTIONARY, 0, DICTIONARY_SUBCLASS },
+    { "background", COLUMN_DICTIONARY, 0, DICTIONARY_BACKGROUND },
+    { "race", COLUMN_DICTIONARY, 0, DICTIONARY_RACE },
+    { "alignment", COLUMN_DICTIONARY, 0, DICTIONARY_ALIGNMENT },
+    { "strength", COLUMN_UINT8, offsetof(struct Character, strength), DICTIONARY_NONE },
+    { "dexterity", COLUMN_UINT8, offsetof(struct Character, dexterity), DICTIONARY_NONE },
+    { "constitution", COLUMN_UINT8, offsetof(struct Character, constitution), DICTIONARY_NONE },
+    { "intelligence", COLUMN_UINT8, offsetof(struct Character, intelligence), DICTIONARY_NONE },
+    { "wisdom", COLUMN_UINT8, offsetof(struct Character, wisdom), DICTIONARY_NONE },
+    { "charisma", COLUMN_UINT8, offsetof(struct Character, charisma), DICTIONARY_NONE },
+    { "speed", COLUMN_INT16, offsetof(struct Character, speed), DICTIONARY_NONE },
+    { "armorClass", COLUMN_UINT8, ARMOR_CLASS_OFFSET, DICTIONARY_NONE },
+    { "armor", COLUMN_DICTIONARY, 0, DICTIONARY_ARMOR },
+    { "weapon", COLUMN_DICTIONARY, 0, DICTIONARY_WEAPON },
+    { "shield", COLUMN_UINT8, offsetof(struct Character, hasShield), DICTIONARY_NONE },
+    { "proficiency", COLUMN_UINT8, offsetof(struct Character, proficiencyModifier), DICTIONARY_NONE },
+    { "hp", COLUMN_INT32, offsetof(struct Character, HP), DICTIONARY_NONE }
+};
+#define ROSTER_COLUMN_COUNT ((int)(sizeof(rosterColumns) / sizeof(rosterColumns[0])))
+
+static int columnWidth(enum ColumnType type) {
+    return type == COLUMN_INT32 ? 4 : (type == COLUMN_INT16 ? 2 : 1);
+}
+
+// Fills entries with a dictionary's values in code order and returns how many there are
+static int dictionaryEntries(enum ColumnDictionary dictionary, const char **entries) {
+    int count = 0;
+    switch (dictionary) {
+        case DICTIONARY_CLASS:
+            for (int i = 0; i < 12; i++) {
+                entries[count++] = catalog->classes[i][0];
+            }
+            break;
+        case DICTIONARY_SUBCLASS:
+            entries[count++] = "N/A";
+            for (int i = 0; i < 12; i++) {
+                for (int j = 1; j < 5; j++) {
+                    entries[count++] = catalog->classes[i][j];
+                }
+            }
+            break;
+        case DICTIONARY_BACKGROUND:
+            for (int i = 0; i < 16; i++) {
+                entries[count++] = catalog->backgrounds[i];
+            }
+            break;
+        case DICTIONARY_RACE:
+            for (int i = 0; i < 10; i++) {
+                entries[count++] = catalog->races[i];
+            }
+            break;
+        case DICTIONARY_ALIGNMENT:
+            for (int i = 0; i < 9; i++) {
+                entries[count++] = catalog->alignments[i];
+            }
+            break;
+        case DICTIONARY_ARMOR:
+            for (int i = 0; i < 13; i++) {
+                entries[count++] = catalog->armors[i].name;
+            }
+            break;
+        case DICTIONARY_WEAPON:
+            for (int i = 0; i < 31; i++) {
+                entries[count++] = catalog->weapons[i].name;
+            }
+            break;
+        default:
+            break;
+    }
+    return count;
+}
+
+static unsigned char dictionaryCode(struct Character *character, enum ColumnDictionary dictionary) {
+    int code = -1, classId = -1;
+    switch (dictionary) {
+        case DICTIONARY_CLASS:
+        case DICTIONARY_SUBCLASS:
+            for (int i = 0; i < 12 && classId < 0; i++) {
+                if (strcmp(catalog->classes[i][0], character->class->name) == 0) {
+                    classId = i;
+                }
+            }
+            if (dictionary == DICTIONARY_CLASS) {
+                code = classId;
+            }
+            else if (strcmp(character->class->subClass, "N/A") == 0) {
+                code = 0;
+            }
+            else if (classId >= 0) {
+                int subClassId = catalogIndex(character->class->subClass, catalog->classes[classId] + 1, 4);
+                code = subClassId < 0 ? -1 : 1 + classId * 4 + subClassId;
+            }
+            break;
+        case DICTIONARY_BACKGROUND:
+            code = catalogIndex(character->background, catalog->backgrounds, 16);
+            break;
+        case DICTIONARY_RACE:
+            code = catalogIndex(character->race, catalog->races, 10);
+            break;
+        case DICTIONARY_ALIGNMENT:
+            code = catalogIndex(character->alignment, catalog->alignments, 9);
+            break;
+        // Equipment points into the catalog the characters were last remapped to
+        case DICTIONARY_ARMOR:
+            if (character->armor >= catalog->armors && character->armor < catalog->armors + 13) {
+                code = character->armor - catalog->armors;
+            }
+            break;
+        case DICTIONARY_WEAPON:
+            if (character->weapon >= catalog->weapons && character->weapon < catalog->weapons + 31) {
+                code = character->weapon - catalog->weapons;
+            }
+            break;
+        default:
+            break;
+    }
+    return code < 0 ? COLUMN_NULL : (unsigned char)code;
+}
+
+// One batch of encoded columns
+struct ColumnBatch {
+    struct Character **characters;    // First character of the batch
+    int rows;
+    unsigned char *columns[ROSTER_COLUMN_COUNT];
+    size_t lengths[ROSTER_COLUMN_COUNT];
+};
+
+// Fixed width and dictionary columns; the string column is filled by the writer
+static void columnBatchWorker(int begin, int end, void *arg) {
+    struct ColumnBatch *batch = arg;
+
+    for (int c = 0; c < ROSTER_COLUMN_COUNT; c++) {
+        unsigned char *column = batch->columns[c];
+        for (int i = begin; i < end; i++) {
+            struct Character *character = batch->characters[i];
+            int value = 0;
+            if (rosterColumns[c].offset == ARMOR_CLASS_OFFSET) {
+                value = equippedArmorClass(character);
+            }
+            else if (rosterColumns[c].type != COLUMN_DICTIONARY && rosterColumns[c].type != COLUMN_STRING) {
+                value = *(const int *)((const char *)character + rosterColumns[c].offset);
+            }
+            switch (rosterColumns[c].type) {
+                case COLUMN_UINT8:
+                    column[i] = (unsigned char)value;
+                    break;
+                case COLUMN_INT16: {
+                    short narrow = (short)value;
+                    memcpy(column + i * 2, &narrow, 2);
+                    break;
+                }
+                case COLUMN_INT32:
+                    memcpy(column + i * 4, &value, 4);
+                    break;
+                case COLUMN_DICTIONARY:
+                    column[i] = dictionaryCode(character, rosterColumns[c].dictionary);
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+}
+
+// Writes length bytes and zero padding up to the next 8 byte boundary, keeping track of the file offset
+static int writeAligned(FILE *file, const void *data, size_t length, unsigned long long *offset) {
+    static const char padding[8];
+    size_t pad = (8 - (*offset + length) % 8) % 8;
+    *offset += length + pad;
+    return fwrite(data, 1, length, file) == length && fwrite(padding, 1, pad, file) == pad;
+}
+
+int exportRosterColumns(struct Character **characters, int count, const char *fileName) {
+    TRACE_SPAN("exportRosterColumns", "file write");
+    char tempName[256];
+    unsigned long long offset = 0;
+    int batchCount = (count + COLUMN_BATCH_ROWS - 1) / COLUMN_BATCH_ROWS;
+
+    snprintf(tempName, sizeof(tempName), "%s.tmp", fileName);
+    FILE *file = fopen(tempName, "wb");
+    unsigned long long *batchOffsets = trackedMalloc((batchCount + 1) * sizeof(unsigned long long), MEMORY_IO);
+    struct ColumnBatch batch;
+    memset(&batch, 0, sizeof(batch));
+    for (int c = 0; c < ROSTER_COLUMN_COUNT; c++) {
+        // The string column needs its offsets plus up to 24 bytes of name per row
+        size_t capacity = rosterColumns[c].type == COLUMN_STRING ? (COLUMN_BATCH_ROWS + 1) * 4 + COLUMN_BATCH_ROWS * 25 :
+                          (size_t)COLUMN_BATCH_ROWS * columnWidth(rosterColumns[c].type);
+        batch.columns[c] = trackedMalloc(capacity, MEMORY_IO);
+        if (batch.columns[c] == NULL) {
+            printf("Memory allocation failed.\n");
+            exit(1);
+        }
+    }
+    if (batchOffsets == NULL) {
+        printf("Memory allocation failed.\n");
+        exit(1);
+    }
+    if (file == NULL) {
+        printf("Couldn't open %s.\n", tempName);
+    }
+    else {
+        setvbuf(file, NULL, _IOFBF, 1 << 20);
+    }
+
+    // Schema
+    char *header = NULL;
+    size_t headerLength = 0;
+    FILE *schema = open_memstream(&header, &headerLength);
+    if (schema == NULL) {
+        printf("Memory allocation failed.\n");
+        exit(1);
+    }
+    unsigned int columnCount = ROSTER_COLUMN_COUNT;
+    fwrite(COLUMN_MAGIC, 8, 1, schema);
+    fwrite(&columnCount, 4, 1, schema);
+    for (int c = 0; c < ROSTER_COLUMN_COUNT; c++) {
+        const char *entries[64];
+        fputc(rosterColumns[c].type, schema);
+        fputc((int)strlen(rosterColumns[c].name), schema);
+        fputs(rosterColumns[c].name, schema);
+        if (rosterColumns[c].type == COLUMN_DICTIONARY) {
+            unsigned short entryCount = (unsigned short)dictionaryEntries(rosterColumns[c].dictionary, entries);
+            fwrite(&entryCount, 2, 1, schema);
+            for (int e = 0; e < entryCount; e++) {
+                size_t length = strlen(entries[e]);
+                length = length > 255 ? 255 : length;
+                fputc((int)length, schema);
+                fwrite(entries[e], 1, length, schema);
+            }
+        }
+    }
+    fclose(schema);
+    trackAdopted(header, MEMORY_IO);
+    int written = file != NULL && writeAligned(file, header, headerLength, &offset);
+    trackedFree(header, MEMORY_IO);
+
+    // Batches
+    for (int b = 0; b < batchCount && written; b++) {
+        unsigned int rowHeader[2];
+        batch.characters = characters + (size_t)b * COLUMN_BATCH_ROWS;
+        batch.rows = count - b * COLUMN_BATCH_ROWS < COLUMN_BATCH_ROWS ? count - b * COLUMN_BATCH_ROWS : COLUMN_BATCH_ROWS;
+        parallelFor(batch.rows, columnBatchWorker, &batch);
+
+        for (int c = 0; c < ROSTER_COLUMN_COUNT; c++) {
+            if (rosterColumns[c].type != COLUMN_STRING) {
+                batch.lengths[c] = (size_t)batch.rows * columnWidth(rosterColumns[c].type);
+                continue;
+            }
+            unsigned int *offsets = (unsigned int *)batch.columns[c];
+            char *text = (char *)(offsets + batch.rows + 1);
+            offsets[0] = 0;
+            for (int i = 0; i < batch.rows; i++) {
+                size_t length = strlen(batch.characters[i]->name);
+                memcpy(text + offsets[i], batch.characters[i]->name, length);
+                offsets[i + 1] = offsets[i] + (unsigned int)length;
+            }
+            batch.lengths[c] = (batch.rows + 1) * 4 + offsets[batch.rows];
+        }
+
+        batchOffsets[b] = offset;
+        rowHeader[0] = (unsigned int)batch.rows;
+        rowHeader[1] = 0;
+        written = writeAligned(file, rowHeader, sizeof(rowHeader), &offset);
+        for (int c = 0; c < ROSTER_COLUMN_COUNT && written; c++) {
+            unsigned long long length = batch.lengths[c];
+            written = writeAligned(file, &length, sizeof(length), &offset) && writeAligned(file, batch.columns[c], batch.lengths[c], &offset);
+        }
+    }
+
+    // Footer
+    if (written) {
+        unsigned long long totals[2] = { (unsigned long long)batchCount, (unsigned long long)count };
+        written = fwrite(batchOffsets, sizeof(unsigned long long), batchCount, file) == (size_t)batchCount &&
+                  fwrite(totals, sizeof(totals), 1, file) == 1 && fwrite(COLUMN_MAGIC, 8, 1, file) == 1;
+    }
+
+    for (int c = 0; c < ROSTER_COLUMN_COUNT; c++) {
+        trackedFree(batch.columns[c], MEMORY_IO);
+    }
+    trackedFree(batchOffsets, MEMORY_IO);
+    if (file == NULL) {
+        return -1;
+    }
+    written = fflush(file) == 0 && written && fsync(fileno(file)) == 0;
+    if (fclose(file) != 0 || !written || rename(tempName, fileName) != 0) {
+        printf("Couldn't write %s.\n", fileName);
+        remove(tempName);
+        return -1;
+    }
+    return 0;
+}
+
+// Name filter functions
+static unsigned long long nameHash(const char *name) {
+    unsigned long long hash = 1469598103934665603ull;   // FNV-1a
+    for (; *name != '\0'; name++) {
+        hash = (hash ^ (unsigned char)*name) * 1099511628211ull;
+    }
+    return hash ^ (hash >> 29);
+}
+
+static unsigned short nameFingerprint(unsigned long long hash) {
+    unsigned short fingerprint = (unsigned short)(hash >> 48);
+    return fingerprint != 0 ? fingerprint : 1;   // 0 marks an empty slot
+}
+
+// The other bucket only depends on the bucket and fingerprint, so a fingerprint can be moved without its name
+static unsigned int alternateBucket(const struct NameFilter *filter, unsigned int bucket, unsigned short fingerprint) {
+    return (bucket ^ (fingerprint * 0x5bd1e995u)) & (filter->bucketCount - 1);
+}
+
+static int bucketInsert(struct NameFilter *filter, unsigned int bucket, unsigned short fingerprint) {
+    unsigned short *slots = &filter->slots[bucket * FILTER_BUCKET_SIZE];
+    for (int i = 0; i < FILTER_BUCKET_SIZE; i++) {
+        if (slots[i] == 0) {
+            slots[i] = fingerprint;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int bucketRemove(struct NameFilter *filter, unsigned int bucket, unsigned short fingerprint) {
+    unsigned short *slots = &filter->slots[bucket * FILTER_BUCKET_SIZE];
+    for (int i = 0; i < FILTER_BUCKET_SIZE; i++) {
+        if (slots[i] == fingerprint) {
+            slots[i] = 0;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int bucketContains(const struct NameFilter *filter, unsigned int bucket, unsigned short fingerprint) {
+    const unsigned short *slots = &filter->slots[bucket * FILTER_BUCKET_SIZE];
+    for (int i = 0; i < FILTER_BUCKET_SIZE; i++) {
+        if (slots[i] == fingerprint) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Returns 0 if the fingerprint could not be placed (the filter has lost a fingerprint and must be rebuilt)
+static int filterInsert(struct NameFilter *filter, const char *name) {
+    static unsigned int kickState = 2463534242u;
+    unsigned long long hash = nameHash(name);
+    unsigned short fingerprint = nameFingerprint(hash);
+    unsigned int bucket = (unsigned int)hash & (filter->bucketCount - 1);
+
+    if (bucketInsert(filter, bucket, fingerprint) || bucketInsert(filter, alternateBucket(filter, bucket, fingerprint), fingerprint)) {
+        filter->count++;
+        filter->nameSum += hash;
+        return 1;
+    }
+
+    // Both buckets are full, so keep evicting a random fingerprint to its other bucket until one lands
+    for (int kick = 0; kick < FILTER_MAX_KICKS; kick++) {
+        kickState ^= kickState << 13;
+        kickState ^= kickState >> 17;
+        kickState ^= kickState << 5;
+        unsigned short *slot = &filter->slots[bucket * FILTER_BUCKET_SIZE + kickState % FILTER_BUCKET_SIZE];
+        unsigned short evicted = *slot;
+        *slot = fingerprint;
+        fingerprint = evicted;
+        bucket = alternateBucket(filter, bucket, fingerprint);
+        if (bucketInsert(filter, bucket, fingerprint)) {
+            filter->count++;
+            filter->nameSum += hash;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void allocateNameFilter(struct NameFilter *filter, unsigned int bucketCount) {
+    filter->bucketCount = bucketCount;
+    filter->count = 0;
+    filter->saturated = 0;
+    filter->nameSum = 0;
+    filter->slots = trackedCalloc((size_t)bucketCount * FILTER_BUCKET_SIZE, sizeof(unsigned short), MEMORY_NAMES);
+    if (filter->slots == NULL) {
+        printf("Memory allocation failed.\n");
+        exit(1);
+    }
+}
+
+void freeNameFilter(struct NameFilter *filter) {
+    trackedFree(filter->slots, MEMORY_NAMES);
+    filter->slots = NULL;
+    filter->bucketCount = 0;
+    filter->count = 0;
+    filter->saturated = 0;
+    filter->nameSum = 0;
+}
+
+void rebuildNameFilter(struct Character *head) {
+    unsigned int count = 0;
+    for (struct Character *character = head; character != NULL; character = character->next) {
+        count++;
+    }
+
+    // Start half full, and double if the names still do not fit (only likely with many identical names)
+    unsigned int bucketCount = 16;
+    while (bucketCount * FILTER_BUCKET_SIZE < count * 2) {
+        bucketCount *= 2;
+    }
+    for (int attempt = 0; attempt < 4; attempt++, bucketCount *= 2) {
+        freeNameFilter(&nameFilter);
+        allocateNameFilter(&nameFilter, bucketCount);
+
+        struct Character *character = head;
+        while (character != NULL && filterInsert(&nameFilter, character->name)) {
+            character = character->next;
+        }
+        if (character == NULL) {
+            return;
+        }
+    }
+    nameFilter.saturated = 1;
+}
+
+static int filterContains(const struct NameFilter *filter, const char *name) {
+    if (filter->slots == NULL || filter->saturated) {
+        return 1;
+    }
+    unsigned long long hash = nameHash(name);
+    unsigned short fingerprint = nameFingerprint(hash);
+    unsigned int bucket = (unsigned int)hash & (filter->bucketCount - 1);
+    return bucketContains(filter, bucket, fingerprint) || bucketContains(filter, alternateBucket(filter, bucket, fingerprint), fingerprint);
+}
+
+int nameFilterContains(const char *name) {
+    return filterContains(&nameFilter, name);
+}
+
+// A saturated filter is rebuilt on the next add, since deletes may have made room for the roster again
+void nameFilterAdd(struct Character *head, const char *name) {
+    if (nameFilter.slots == NULL || nameFilter.saturated || nameFilter.count + 1 > FILTER_MAX_LOAD * nameFilter.bucketCount * FILTER_BUCKET_SIZE || !filterInsert(&nameFilter, name)) {
+        rebuildNameFilter(head);   // head already holds the new character
+    }
+}
+
+void nameFilterAddMany(struct Character *head, struct Character **characters, int count) {
+    if (nameFilter.slots == NULL || nameFilter.saturated || nameFilter.count + count > FILTER_MAX_LOAD * nameFilter.bucketCount * FILTER_BUCKET_SIZE) {
+        rebuildNameFilter(head);
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        if (!filterInsert(&nameFilter, characters[i]->name)) {
+            rebuildNameFilter(head);
+            return;
+        }
+    }
+}
+
+void nameFilterRemove(const char *name) {
+    if (nameFilter.slots == NULL || nameFilter.saturated) {
+        return;
+    }
+    unsigned long long hash = nameHash(name);
+    unsigned short fingerprint = nameFingerprint(hash);
+    unsigned int bucket = (unsigned int)hash & (nameFilter.bucketCount - 1);
+    if (bucketRemove(&nameFilter, bucket, fingerprint) || bucketRemove(&nameFilter, alternateBucket(&nameFilter, bucket, fingerprint), fingerprint)) {
+        nameFilter.count--;
+        nameFilter.nameSum -= hash;
+    }
+}
+
+int characterNameExists(struct Character *head, const char *name) {
+    if (!nameFilterContains(name)) {
+        return 0;
+    }
+    for (struct Character *character = head; character != NULL; character = character->next) {
+        if (strcmp(character->name, name) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// A new name the filters could not rule out, checked exactly once the whole batch has been seen
+struct TakenName {
+    const char *name;
+    int index;                        // Position in the batch
+    int taken;
+};
+
+static int compareTakenNames(const void *a, const void *b) {
+    const struct TakenName *first = a;
+    const struct TakenName *second = b;
+    int order = strcmp(first->name, second->name);
+    return order != 0 ? order : (first->index > second->index) - (first->index < second->index);
+}
+
+// Marks every candidate with the name, which all sit together from the first one
+static void markTakenName(struct TakenName *names, int count, const char *name) {
+    int low = 0, high = count;
+    while (low < high) {
+        int middle = low + (high - low) / 2;
+        if (strcmp(names[middle].name, name) < 0) {
+            low = middle + 1;
+        }
+        else {
+            high = middle;
+        }
+    }
+    for (; low < count && strcmp(names[low].name, name) == 0; low++) {
+        names[low].taken = 1;
+    }
+}
+
+int dropTakenNames(struct Character *head, struct Character **characters, int count) {
+    TRACE_SPAN("dropTakenNames", "roster");
+    struct NameFilter batch;
+    struct TakenName *candidates = trackedMalloc((count > 0 ? count : 1) * sizeof(struct TakenName), MEMORY_WORK);
+    char *isCandidate = trackedCalloc(count > 0 ? count : 1, 1, MEMORY_WORK);
+    if (candidates == NULL || isCandidate == NULL) {
+        printf("Memory allocation failed.\n");
+        exit(1);
+    }
+
+    // A name the roster's filter rules out and that is new to the batch is certainly free. The batch gets a
+    // filter of its own so the roster's only ever holds the names that are kept.
+    unsigned int bucketCount = 16;
+    while (bucketCount * FILTER_BUCKET_SIZE < (unsigned int)count * 2) {
+        bucketCount *= 2;
+    }
+    allocateNameFilter(&batch, bucketCount);
+    int candidateCount = 0;
+    for (int i = 0; i < count; i++) {
+        const char *name = characters[i]->name;
+        int maybe = nameFilterContains(name) || filterContains(&batch, name);
+        if (!filterInsert(&batch, name)) {
+            batch.saturated = 1;   // A fingerprint was lost, so every later name has to be checked
+        }
+        if (maybe) {
+            candidates[candidateCount].name = name;
+            candidates[candidateCount].index = i;
+            candidates[candidateCount].taken = 0;
+            candidateCount++;
+            isCandidate[i] = 1;
+        }
+    }
+    freeNameFilter(&batch);
+
+    // The rest are checked exactly: repeats of a candidate, and candidates the roster or a free batch name already has
+    if (candidateCount > 0) {
+        qsort(candidates, candidateCount, sizeof(struct TakenName), compareTakenNames);
+        for (int c = 1; c < candidateCount; c++) {
+            if (strcmp(candidates[c].name, candidates[c - 1].name) == 0) {
+                candidates[c].taken = 1;
+            }
+        }
+        for (struct Character *character = head; character != NULL; character = character->next) {
+            markTakenName(candidates, candidateCount, character->name);
+        }
+        for (int i = 0; i < count; i++) {
+            if (!isCandidate[i]) {
+                markTakenName(candidates, candidateCount, characters[i]->name);
+            }
+        }
+        for (int c = 0; c < candidateCount; c++) {
+            isCandidate[candidates[c].index] = candidates[c].taken ? 2 : 0;
+        }
+    }
+
+    int kept = 0;
+    for (int i = 0; i < count; i++) {
+        if (isCandidate[i] == 2) {
+            freeCharacter(characters[i]);
+        }
+        else {
+            characters[kept++] = characters[i];
+        }
+    }
+    trackedFree(candidates, MEMORY_WORK);
+    trackedFree(isCandidate, MEMORY_WORK);
+    return kept;
+}
+
+// names.filter layout: the header below followed by bucketCount * FILTER_BUCKET_SIZE fingerprints
+struct NameFilterHeader {
+    char magic[8];                    // "DNDNAME2"
+    int indexEntryLines;              // index.txt line counts the filter was saved with
+    int indexTombstoneLines;
+    unsigned int bucketCount;
+    unsigned int count;
+    unsigned long long nameSum;
+};
+
+// Writes a filter to <directory>names.filter, stamped with the index line counts it matches
+static void writeNameFilter(const struct NameFilter *filter, const char *directory, int entryLines, int tombstoneLines) {
+    TRACE_SPAN("saveNameFilter", "file write");
+    char path[100];
+    snprintf(path, sizeof(path), "%snames.filter", directory);
+    if (filter->slots == NULL || filter->saturated) {
+        remove(path);
+        return;
+    }
+
+    struct NameFilterHeader header;
+    memcpy(header.magic, "DNDNAME2", 8);
+    header.indexEntryLines = entryLines;
+    header.indexTombstoneLines = tombstoneLines;
+    header.bucketCount = filter->bucketCount;
+    header.count = filter->count;
+    header.nameSum = filter->nameSum;
+
+    size_t slotBytes = (size_t)filter->bucketCount * FILTER_BUCKET_SIZE * sizeof(unsigned short);
+    char *contents = trackedMalloc(sizeof(header) + slotBytes, MEMORY_IO);
+    if (contents == NULL) {
+        return;   // The filter is rebuilt at startup instead
+    }
+    memcpy(contents, &header, sizeof(header));
+    memcpy(contents + sizeof(header), filter->slots, slotBytes);
+    writeFileAtomically(path, contents, sizeof(header) + slotBytes, durabilityMode != DURABILITY_ASYNC);
+    trackedFree(contents, MEMORY_IO);
+}
+
+void saveNameFilter(void) {
+    writeNameFilter(&nameFilter, campaignDirectory, indexEntryLines, indexTombstoneLines);
+}
+
+int loadNameFilter(struct Character *head) {
+    TRACE_SPAN("loadNameFilter", "roster");
+    char path[100];
+    struct NameFilterHeader header;
+
+    campaignFilePath("names.filter", path, sizeof(path));
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return -1;
+    }
+
+    // A filter saved against a different index would miss names, so it has to match the index line for line
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, "DNDNAME2", 8) != 0 ||
+        header.indexEntryLines != indexEntryLines || header.indexTombstoneLines != indexTombstoneLines ||
+        header.bucketCount < 16 || (header.bucketCount & (header.bucketCount - 1)) != 0 || header.bucketCount > (1u << 28)) {
+        fclose(file);
+        return -1;
+    }
+
+    // Line counts can match an index that was edited by hand, so the names themselves have to add up as well
+    unsigned int characters = 0;
+    unsigned long long nameSum = 0;
+    for (struct Character *character = head; character != NULL; character = character->next) {
+        characters++;
+        nameSum += nameHash(character->name);
+    }
+    if (header.count != characters || header.nameSum != nameSum) {
+        fclose(file);
+        return -1;
+    }
+
+    struct NameFilter loaded;
+    allocateNameFilter(&loaded, header.bucketCount);
+    loaded.count = header.count;
+    loaded.nameSum = header.nameSum;
+    if (fread(loaded.slots, sizeof(unsigned short) * FILTER_BUCKET_SIZE, header.bucketCount, file) != header.bucketCount) {
+        freeNameFilter(&loaded);
+        fclose(file);
+        return -1;
+    }
+    fclose(file);
+
+    // Every stored fingerprint takes one slot
+    unsigned int used = 0;
+    for (size_t i = 0; i < (size_t)header.bucketCount * FILTER_BUCKET_SIZE; i++) {
+        used += loaded.slots[i] != 0;
+    }
+    if (used != header.count) {
+        freeNameFilter(&loaded);
+        return -1;
+    }
+
+    freeNameFilter(&nameFilter);
+    nameFilter = loaded;
+    return 0;
+}
+
+// Campaign functions
+// Campaign names become directory names, so keep them to letters, digits, '-' and '_'
+static int isValidCampaignName(const char *name) {
+    if (name[0] == '\0') {
+        return 0;
+    }
+    for (int i = 0; name[i] != '\0'; i++) {
+        if (!isalnum((unsigned char)name[i]) && name[i] != '-' && name[i] != '_') {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Roster and name filter memory not held by a parked campaign, which is the current campaign's share.
+// Parked rosters don't change, so this is a running count instead of a walk over the roster.
+static size_t currentCampaignBytes(struct Campaign *parked) {
+    long long bytes = __atomic_load_n(&memoryUsage[MEMORY_ROSTER].liveBytes, __ATOMIC_RELAXED) +
+                      __atomic_load_n(&memoryUsage[MEMORY_NAMES].liveBytes, __ATOMIC_RELAXED);
+    for (; parked != NULL; parked = parked->next) {
+        bytes -= (long long)parked->bytes;
+    }
+    return bytes > 0 ? (size_t)bytes : 0;
+}
+
+// Moves the storage counters between the globals and a campaign
+static void parkCampaign(struct Campaign *campaign, struct Character *head) {
+    campaign->characters = head;
+    campaign->nextCharacterId = nextCharacterId;
+    campaign->indexEntryLines = indexEntryLines;
+    campaign->indexTombstoneLines = indexTombstoneLines;
+    campaign->loadedCharacterCount = loadedCharacterCount;
+    campaign->names = nameFilter;
+    campaign->bytes = currentCampaignBytes(campaign->next);
+}
+
+static void resumeCampaign(struct Campaign *campaign) {
+    snprintf(campaignDirectory, sizeof(campaignDirectory), "%s", campaign->directory);
+    nextCharacterId = campaign->nextCharacterId;
+    indexEntryLines = campaign->indexEntryLines;
+    indexTombstoneLines = campaign->indexTombstoneLines;
+    loadedCharacterCount = campaign->loadedCharacterCount;
+    nameFilter = campaign->names;
+}
+
+// Creates a campaign, makes it current and loads its roster from disk
+static struct Campaign *openCampaign(const char *name) {
+    struct Campaign *campaign = trackedCalloc(1, sizeof(struct Campaign), MEMORY_ROSTER);
+    if (campaign == NULL) {
+        printf("Memory allocation failed.\n");
+        exit(1);
+    }
+    snprintf(campaign->name, sizeof(campaign->name), "%s", name);
+    if (strcmp(name, DEFAULT_CAMPAIGN) != 0) {
+        mkdir(CAMPAIGN_DIRECTORY, 0755);
+        snprintf(campaign->directory, sizeof(campaign->directory), "%s/%s", CAMPAIGN_DIRECTORY, name);
+        mkdir(campaign->directory, 0755);
+        strcat(campaign->directory, "/");
+    }
+    campaign->nextCharacterId = 1;
+    resumeCampaign(campaign);
+
+    loadCharactersFromFile(&campaign->characters);
+    if (loadNameFilter(campaign->characters) != 0) {
+        rebuildNameFilter(campaign->characters);
+    }
+    campaign->names = nameFilter;
+    // Every other resident campaign is parked by now
+    campaign->bytes = currentCampaignBytes(campaigns);
+    return campaign;
+}
+
+void openInitialCampaign(struct Character **head) {
+    if (!isValidCampaignName(initialCampaign)) {
+        printf("Campaign names may only use letters, digits, '-' and '_', opening the %s campaign.\n", DEFAULT_CAMPAIGN);
+        snprintf(initialCampaign, sizeof(initialCampaign), "%s", DEFAULT_CAMPAIGN);
+    }
+    campaigns = openCampaign(initialCampaign);
+    *head = campaigns->characters;
+}
+
+void switchCampaign(struct Character **head, const char *name) {
+    struct Campaign *current = campaigns;
+    struct timespec started, finished;
+
+    if (!isValidCampaignName(name)) {
+        printf("Campaign names may only use letters, digits, '-' and '_'.\n\n");
+        return;
+    }
+    if (strcmp(current->name, name) == 0) {
+        printf("'%s' is already the current campaign.\n\n", name);
+        return;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &started);
+
+    // Queued writes find their files through campaignDirectory, so the parked campaign's writes have to land
+    // before it changes (only a campaign that saved something since the last flush waits on the disk)
+    flushPendingWrites();
+    parkCampaign(current, *head);
+
+    struct Campaign *previous = current;
+    struct Campaign *campaign = current->next;
+    while (campaign != NULL && strcmp(campaign->name, name) != 0) {
+        previous = campaign;
+        campaign = campaign->next;
+    }
+    int resident = campaign != NULL;
+    if (resident) {
+        previous->next = campaign->next;
+        resumeCampaign(campaign);
+    }
+    else {
+        campaign = openCampaign(name);
+    }
+    campaign->next = campaigns;
+    campaigns = campaign;
+    *head = campaign->characters;
+
+    clock_gettime(CLOCK_MONOTONIC, &finished);
+    double micros = (finished.tv_sec - started.tv_sec) * 1e6 + (finished.tv_nsec - started.tv_nsec) / 1e3;
+    printf("Switched to the %s campaign (%s in %.0f microseconds).\n\n", name, resident ? "resident" : "loaded from disk", micros);
+
+    enforceCampaignBudget();
+}
+
+// The filter travels with a parked campaign, so it is only written out once the campaign is freed. A filter
+// left stale by a crash doesn't match the index line counts and is rebuilt when the campaign is next opened.
+static void freeCampaign(struct Campaign *campaign) {
+    struct Character *next;
+    writeNameFilter(&campaign->names, campaign->directory, campaign->indexEntryLines, campaign->indexTombstoneLines);
+    for (struct Character *character = campaign->characters; character != NULL; character = next) {
+        next = character->next;
+        freeCharacter(character);
+    }
+    freeNameFilter(&campaign->names);
+    trackedFree(campaign, MEMORY_ROSTER);
+}
+
+void enforceCampaignBudget(void) {
+    size_t total = 0;
+    for (struct Campaign *campaign = campaigns; campaign != NULL; campaign = campaign->next) {
+        total += campaign->bytes;
+    }
+
+    // Parked campaigns had their writes flushed when they were switched away from, so they can simply be freed
+    while (total > campaignBudget && campaigns->next != NULL) {
+        struct Campaign *previous = campaigns;
+        while (previous->next->next != NULL) {
+            previous = previous->next;
+        }
+        struct Campaign *coldest = previous->next;
+        previous->next = NULL;
+        total -= coldest->bytes;
+        printf("Closed the %s campaign to stay under the campaign memory budget.\n\n", coldest->name);
+        freeCampaign(coldest);
+    }
+}
+
+void closeCampaigns(void) {
+    if (campaigns == NULL) {
+        return;
+    }
+    struct Campaign *next;
+    for (struct Campaign *campaign = campaigns->next; campaign != NULL; campaign = next) {
+        next = campaign->next;
+        freeCampaign(campaign);
+    }
+    // The current campaign's characters are still owned by the caller, its filter is saved for next time
+    saveNameFilter();
+    freeNameFilter(&nameFilter);
+    trackedFree(campaigns, MEMORY_ROSTER);
+    campaigns = NULL;
+}
+
+void campaignMenu(struct Character **head) {
+    TRACE_SPAN("Switch campaign", "menu");
+    char campaignName[25];
+    int userChoice;
+
+    do {
+        printf("\nCampaign Menu (current campaign: %s)\n", campaigns->name);
+        printf("1. Switch to another campaign\n");
+        printf("2. List resident campaigns\n");
+        printf("3. Exit campaign menu\n");
+        printf("Enter your choice: ");
+        scanf("%d", &userChoice);
+
+        switch (userChoice) {
+            case 1:
+                getCharacterName(campaignName, "Enter the name of the campaign (it is created if it does not exist): ");
+                switchCampaign(head, campaignName);
+                break;
+            case 2: {
+                // The current campaign's size is only recorded when it is parked, so bring it up to date
+                campaigns->bytes = currentCampaignBytes(campaigns->next);
+                size_t total = 0;
+                printf("\n%-24s | %-10s | %s\n", "Campaign", "Characters", "Memory");
+                for (struct Campaign *campaign = campaigns; campaign != NULL; campaign = campaign->next) {
+                    int count = 0;
+                    for (struct Character *character = campaign == campaigns ? *head : campaign->characters; character != NULL; character = character->next) {
+                        count++;
+                    }
+                    printf("%-24s | %-10d | %.1f KB%s\n", campaign->name, count, campaign->bytes / 1024.0, campaign == campaigns ? " (current)" : "");
+                    total += campaign->bytes;
+                }
+                printf("%.1f MB of %.1f MB budget in use.\n\n", total / (1024.0 * 1024.0), campaignBudget / (1024.0 * 1024.0));
+                break;
+            }
+            case 3:
+                break;
+            default:
+                printf("\nInvalid choice, please try again...\n\n");
+                break;
+        }
+    } while (userChoice != 3);
+}
+
+// Trace functions
+static struct TraceBuffer *traceBuffers = NULL;   // Every buffer ever handed out, written at exit
+static pthread_mutex_t traceLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t traceKey;                    // Returns a thread's buffer for reuse when the thread exits
+static __thread struct TraceBuffer *threadTrace;
+static struct timespec traceOrigin;
+static int traceThreadCount = 0;
+
+static long long traceNow(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - traceOrigin.tv_sec) * 1000000000LL + (now.tv_nsec - traceOrigin.tv_nsec);
+}
+
+static void releaseTraceBuffer(void *buffer) {
+    pthread_mutex_lock(&traceLock);
+    ((struct TraceBuffer *)buffer)->inUse = 0;
+    pthread_mutex_unlock(&traceLock);
+}
+
+// Threads started by parallelFor come and go, so a new thread takes over a buffer left by one that exited
+static struct TraceBuffer *traceBufferForThread(void) {
+    if (threadTrace != NULL) {
+        return threadTrace;
+    }
+
+    pthread_mutex_lock(&traceLock);
+    struct TraceBuffer *buffer = traceBuffers;
+    while (buffer != NULL && buffer->inUse) {
+        buffer = buffer->next;
+    }
+    if (buffer == NULL) {
+        buffer = trackedCalloc(1, sizeof(struct TraceBuffer), MEMORY_WORK);
+        if (buffer == NULL) {
+            printf("Memory allocation failed.\n");
+            exit(1);
+        }
+        buffer->tid = ++traceThreadCount;
+        buffer->threadName = "thread";
+        buffer->next = traceBuffers;
+        traceBuffers = buffer;
+    }
+    buffer->inUse = 1;
+    pthread_mutex_unlock(&traceLock);
+
+    pthread_setspecific(traceKey, buffer);
+    threadTrace = buffer;
+    return buffer;
+}
+
+void startTracing(void) {
+    if (traceFileName[0] == '\0') {
+        return;
+    }
+    if (pthread_key_create(&traceKey, releaseTraceBuffer) != 0) {
+        printf("Tracing is unavailable.\n");
+        return;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &traceOrigin);
+    tracing = 1;
+    traceThreadName("main");
+}
+
+struct TraceSpan traceBegin(const char *name, const char *category) {
+    struct TraceSpan span = { NULL, NULL, 0 };
+    if (tracing) {
+        span.name = name;
+        span.category = category;
+        span.start = traceNow();
+    }
+    return span;
+}
+
+void traceEnd(struct TraceSpan *span) {
+    if (span->name == NULL || !tracing) {
+        return;
+    }
+    struct TraceBuffer *buffer = traceBufferForThread();
+    struct TraceEvent *event = &buffer->events[buffer->recorded % TRACE_RING_SIZE];
+    event->name = span->name;
+    event->category = span->category;
+    event->start = span->start;
+    event->duration = traceNow() - span->start;
+    buffer->recorded++;
+}
+
+void traceThreadName(const char *name) {
+    if (tracing) {
+        traceBufferForThread()->threadName = name;
+    }
+}
+
+// Called once every other thread has stopped
+void stopTracing(void) {
+    if (!tracing) {
+        return;
+    }
+    tracing = 0;
+
+    FILE *file = fopen(traceFileName, "w");
+    if (file == NULL) {
+        printf("Error: Could not write the trace to '%s'.\n", traceFileName);
+    }
+    else {
+        unsigned long long spans = 0;
+        int first = 1;
+        fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        for (struct TraceBuffer *buffer = traceBuffers; buffer != NULL; buffer = buffer->next) {
+            fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                    first ? "" : ",\n", buffer->tid, buffer->threadName);
+            first = 0;
+
+            // Oldest span first, skipping any the ring has already overwritten
+            unsigned long long oldest = buffer->recorded > TRACE_RING_SIZE ? buffer->recorded - TRACE_RING_SIZE : 0;
+            for (unsigned long long i = oldest; i < buffer->recorded; i++) {
+                const struct TraceEvent *event = &buffer->events[i % TRACE_RING_SIZE];
+                fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                        event->name, event->category, buffer->tid, event->start / 1000.0, event->duration / 1000.0);
+            }
+            spans += buffer->recorded - oldest;
+            if (oldest > 0) {
+                printf("The trace kept the last %d spans of thread %d (%s) and dropped %llu older ones.\n", TRACE_RING_SIZE, buffer->tid, buffer->threadName, oldest);
+            }
+        }
+        fprintf(file, "\n]}\n");
+        fclose(file);
+        printf("Wrote %llu span(s) to %s.\n", spans, traceFileName);
+    }
+
+    struct TraceBuffer *next;
+    for (struct TraceBuffer *buffer = traceBuffers; buffer != NULL; buffer = next) {
+        next = buffer->next;
+        trackedFree(buffer, MEMORY_WORK);
+    }
+    traceBuffers = NULL;
+}
+
+// Memory accounting functions
+static const char *memoryTagNames[MEMORY_TAGS] = { "Catalogs", "Roster", "Names", "History", "I/O buffers", "Work" };
+
+static void raisePeak(long long *peak, long long live) {
+    long long seen = __atomic_load_n(peak, __ATOMIC_RELAXED);
+    while (live > seen && !__atomic_compare_exchange_n(peak, &seen, live, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+// Worker threads allocate too, so the counters are only ever changed atomically
+static void accountMemory(enum MemoryTag tag, long long bytes, int allocations) {
+    struct MemoryUsage *usage = &memoryUsage[tag];
+
+    raisePeak(&usage->peakBytes, __atomic_add_fetch(&usage->liveBytes, bytes, __ATOMIC_RELAXED));
+    raisePeak(&memoryTotal.peakBytes, __atomic_add_fetch(&memoryTotal.liveBytes, bytes, __ATOMIC_RELAXED));
+    __atomic_add_fetch(&usage->liveAllocations, allocations, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&memoryTotal.liveAllocations, allocations, __ATOMIC_RELAXED);
+    if (allocations > 0) {
+        __atomic_add_fetch(&usage->totalAllocations, allocations, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&memoryTotal.totalAllocations, allocations, __ATOMIC_RELAXED);
+    }
+}
+
+void *trackedMalloc(size_t size, enum MemoryTag tag) {
+    void *pointer = malloc(size);
+    trackAdopted(pointer, tag);
+    return pointer;
+}
 
-                       // Update the .txt file for the character
-            char firstName[100];
-            sscanf(updatedCharacter->name, "%s", firstName);
+void *trackedCalloc(size_t count, size_t size, enum MemoryTag tag) {
+    void *pointer = calloc(count, size);
+    trackAdopted(pointer, tag);
+    return pointer;
+}
 
-            // Construct the corresponding file name
-            char fileName[100];
-            snprintf(fileName, sizeof(fileName), "%s.txt", firstName);
+void *trackedRealloc(void *pointer, size_t size, enum MemoryTag tag) {
+    size_t before = pointer != NULL ? malloc_usable_size(pointer) : 0;
+    void *grown = realloc(pointer, size);
+    // A failed realloc leaves the old block alone
+    if (grown != NULL) {
+        accountMemory(tag, (long long)malloc_usable_size(grown) - (long long)before, pointer == NULL ? 1 : 0);
+    }
+    return grown;
+}
 
-            FILE *characterFile = fopen(fileName, "w");
-            if (characterFile == NULL) {
-                printf("Failed to update the file for character: %s\n", updateCharacterName);
-                return;
-            }
+char *trackedStrdup(const char *value, enum MemoryTag tag) {
+    char *copy = strdup(value);
+    trackAdopted(copy, tag);
+    return copy;
+}
 
-            writeCharacterToFile(fileName, updatedCharacter);
-            return;
-        }
-        updatedCharacter = updatedCharacter->next;
+void trackedFree(void *pointer, enum MemoryTag tag) {
+    if (pointer != NULL) {
+        accountMemory(tag, -(long long)malloc_usable_size(pointer), -1);
+        free(pointer);
     }
+}
 
-    printf("Character could not be found :( \n\n");
+void trackAdopted(void *pointer, enum MemoryTag tag) {
+    if (pointer != NULL) {
+        accountMemory(tag, (long long)malloc_usable_size(pointer), 1);
+    }
 }
 
-//Deletes a character from the list
-void deleteCharacter(struct Character **character, char *deleteCharacterName){
-    struct Character *prev = NULL;
-    struct Character *temp = *character;
-    int userChoice;
-    int validInput = 0;
+static void printMemoryRow(const char *name, const struct MemoryUsage *usage) {
+    printf("%-12s %12.1f %12.1f %14lld %14lld\n", name, __atomic_load_n(&usage->liveBytes, __ATOMIC_RELAXED) / 1024.0,
+           __atomic_load_n(&usage->peakBytes, __ATOMIC_RELAXED) / 1024.0, __atomic_load_n(&usage->liveAllocations, __ATOMIC_RELAXED),
+           __atomic_load_n(&usage->totalAllocations, __ATOMIC_RELAXED));
+}
 
-    // Find the character in the list
-    while(temp != NULL && strcmp(temp->name, deleteCharacterName) != 0){
-        prev = temp;
-        temp = temp->next;
+void printMemoryUsage(void) {
+    printf("\n%-12s %12s %12s %14s %14s\n", "Subsystem", "Live KB", "Peak KB", "Live blocks", "Allocations");
+    for (int tag = 0; tag < MEMORY_TAGS; tag++) {
+        printMemoryRow(memoryTagNames[tag], &memoryUsage[tag]);
     }
+    printMemoryRow("Total", &memoryTotal);
+    printf("\n");
+}
 
-    // If character not found
-    if(temp == NULL){
-        printf("Your character could not be found :(\n\n");
+void reportLeaks(void) {
+    if (memoryTotal.liveAllocations == 0 && memoryTotal.liveBytes == 0) {
         return;
     }
+    printf("\nMemory still allocated at exit:\n");
+    for (int tag = 0; tag < MEMORY_TAGS; tag++) {
+        if (memoryUsage[tag].liveAllocations != 0 || memoryUsage[tag].liveBytes != 0) {
+            printf("  %-12s %lld byte(s) in %lld block(s)\n", memoryTagNames[tag], memoryUsage[tag].liveBytes, memoryUsage[tag].liveAllocations);
+        }
+    }
+}
 
-    printf("Are you sure you want to delete '%s'?\n", temp->name);
-    printf("1. Yes\n");
-    printf("2. No\n");
+// Audit log functions
+// Block of records in the ring
+struct AuditBlock {
+    unsigned int length;
+    unsigned char data[AUDIT_BLOCK_SIZE];
+};
 
-    while(!validInput){
-        printf("Enter your choice: ");
-        scanf("%d", &userChoice);
+// Roll being put together by auditBegin, auditDie and auditEnd
+struct AuditRoll {
+    int depth;                        // auditBegin calls not yet ended
+    enum AuditFunction function;
+    unsigned int nameId;
+    int dice;
+    unsigned char faces[AUDIT_MAX_DICE][2];   // Sides and face of each die
+};
 
-        if(userChoice == 1 || userChoice == 2){
-            validInput = 1;
-        } else {
-            printf("Invalid choice, please try again...\n\n");
+static const char *auditFunctionNames[AUDIT_FUNCTIONS] = { "", "rollDie", "rollD20", "calculateRollModifier", "calculateDamageRoll",
+                                                           "calculateAttackRoll", "makeAttackAction" };
+
+static FILE *auditFile;
+static struct AuditBlock *auditRing;
+static unsigned long long auditSealed = 0;      // Blocks handed to the writer, the roller fills auditRing[auditSealed % AUDIT_RING_BLOCKS]
+static unsigned long long auditWritten = 0;     // Blocks the writer has finished with
+static sem_t auditReady;                        // Posted for every sealed block, and once more to stop the writer
+static sem_t auditFree;                         // Blocks the roller can move on to
+static pthread_t auditThread;
+static int auditThreadRunning = 0;
+static int auditFailed = 0;                     // Boolean indicating a block could not be written
+static unsigned char *auditScratch;             // Compressed copy of the block being written
+static struct timespec auditOrigin;
+static struct AuditRoll auditRoll;
+static unsigned long long auditRolls = 0;
+static char (*auditNames)[25];                  // Names that have been given an id, by id
+static int auditNameCount = 0;
+static int auditNameCapacity = 0;
+static unsigned int *auditNameSlots;            // Open addressing table of name ids by name hash, AUDIT_NO_NAME when empty
+static unsigned int auditNameSlotCount = 0;     // Always a power of two, kept at most half full
+static unsigned int auditLastName = AUDIT_NO_NAME;  // The same character usually rolls several times running
+
+// Block compression is a small LZ77 coder using the LZ4 sequence layout: a token with the literal count in its
+// high nibble and the match length - 4 in its low nibble (15 continues in bytes of up to 255), the literals, a
+// u16 offset back to the match and any match length bytes. The last sequence is literals only. Roll records
+// repeat the same few functions, names and dice, so even a single probe per position finds most of them.
+#define AUDIT_HASH_BITS 12
+#define AUDIT_MIN_MATCH 4
+
+static int putAuditLength(unsigned char *output, size_t *out, size_t capacity, size_t length) {
+    while (length >= 255) {
+        if (*out >= capacity) {
+            return 0;
         }
+        output[(*out)++] = 255;
+        length -= 255;
     }
+    if (*out >= capacity) {
+        return 0;
+    }
+    output[(*out)++] = (unsigned char)length;
+    return 1;
+}
 
-    if(userChoice == 2){
-        printf("\nDeletion canceled. '%s' was not deleted.\n\n", temp->name);
-        return;
+// A matchLength of 0 writes the closing literals-only sequence
+static int putAuditSequence(unsigned char *output, size_t *out, size_t capacity, const unsigned char *literals, size_t literalCount,
+                            size_t offset, size_t matchLength) {
+    size_t match = matchLength > 0 ? matchLength - AUDIT_MIN_MATCH : 0;
+
+    if (*out >= capacity) {
+        return 0;
+    }
+    output[(*out)++] = (unsigned char)(((literalCount < 15 ? literalCount : 15) << 4) | (match < 15 ? match : 15));
+    if (literalCount >= 15 && !putAuditLength(output, out, capacity, literalCount - 15)) {
+        return 0;
+    }
+    if (literalCount > capacity - *out) {
+        return 0;
     }
+    memcpy(output + *out, literals, literalCount);
+    *out += literalCount;
+    if (matchLength == 0) {
+        return 1;
+    }
+    if (capacity - *out < 2) {
+        return 0;
+    }
+    output[(*out)++] = (unsigned char)(offset & 0xFF);
+    output[(*out)++] = (unsigned char)(offset >> 8);
+    return match < 15 || putAuditLength(output, out, capacity, match - 15);
+}
 
-    // Delete the corresponding .txt file
-    char firstName[100];
-    sscanf(temp->name, "%s", firstName);
+// Returns the compressed length, or 0 if it would not fit in capacity bytes
+static size_t compressAuditBlock(const unsigned char *input, size_t length, unsigned char *output, size_t capacity) {
+    int table[1 << AUDIT_HASH_BITS];
+    size_t anchor = 0, i = 0, out = 0;
 
-    // Construct the filename based on the first name (assumes the file is named firstName.txt)
-    char fileName[100];
-    snprintf(fileName, sizeof(fileName), "%s.txt", firstName);
+    for (int h = 0; h < (1 << AUDIT_HASH_BITS); h++) {
+        table[h] = -1;
+    }
+    while (i + AUDIT_MIN_MATCH <= length) {
+        unsigned int sequence;
+        memcpy(&sequence, input + i, AUDIT_MIN_MATCH);
+        unsigned int hash = (sequence * 2654435761U) >> (32 - AUDIT_HASH_BITS);
+        int candidate = table[hash];
+        table[hash] = (int)i;
+        if (candidate < 0 || i - candidate > 0xFFFF || memcmp(input + candidate, input + i, AUDIT_MIN_MATCH) != 0) {
+            i++;
+            continue;
+        }
 
-    // Remove the file
-    if(remove(fileName) == 0){
-        printf("File %s has been deleted.\n", fileName);
-    } else {
-        printf("Error deleting file %s.\n", fileName);
+        size_t matchLength = AUDIT_MIN_MATCH;
+        while (i + matchLength < length && input[candidate + matchLength] == input[i + matchLength]) {
+            matchLength++;
+        }
+        if (!putAuditSequence(output, &out, capacity, input + anchor, i - anchor, i - candidate, matchLength)) {
+            return 0;
+        }
+        i += matchLength;
+        anchor = i;
+    }
+    if (!putAuditSequence(output, &out, capacity, input + anchor, length - anchor, 0, 0)) {
+        return 0;
     }
+    return out;
+}
 
-    // Remove the character from the linked list
-    if(prev == NULL){
-        *character = temp->next;  // The character is at the head of the list
-    } else {
-        prev->next = temp->next;  // Bypass the character to remove it
+static int getAuditLength(const unsigned char *input, size_t *in, size_t length, size_t *value) {
+    int byte;
+    do {
+        if (*in >= length) {
+            return 0;
+        }
+        byte = input[(*in)++];
+        *value += byte;
+    } while (byte == 255);
+    return 1;
+}
+
+// Returns the decompressed length, or 0 if the block is damaged
+static size_t decompressAuditBlock(const unsigned char *input, size_t length, unsigned char *output, size_t capacity) {
+    size_t in = 0, out = 0;
+
+    while (in < length) {
+        int token = input[in++];
+        size_t literals = token >> 4;
+        size_t match = token & 15;
+        if (literals == 15 && !getAuditLength(input, &in, length, &literals)) {
+            return 0;
+        }
+        if (literals > length - in || literals > capacity - out) {
+            return 0;
+        }
+        memcpy(output + out, input + in, literals);
+        in += literals;
+        out += literals;
+        if (in == length) {
+            break;
+        }
+
+        if (length - in < 2) {
+            return 0;
+        }
+        size_t offset = input[in] | ((size_t)input[in + 1] << 8);
+        in += 2;
+        if (match == 15 && !getAuditLength(input, &in, length, &match)) {
+            return 0;
+        }
+        match += AUDIT_MIN_MATCH;
+        if (offset == 0 || offset > out || match > capacity - out) {
+            return 0;
+        }
+        // Byte by byte, the match may overlap what it is copying
+        for (size_t k = 0; k < match; k++, out++) {
+            output[out] = output[out - offset];
+        }
     }
+    return out;
+}
 
-    // Free the memory occupied by the character
-    free(temp);
+// Writes one sealed block, compressed when that makes it smaller
+static void writeAuditBlock(const struct AuditBlock *block) {
+    TRACE_SPAN("writeAuditBlock", "file write");
+    unsigned int lengths[2] = { block->length, block->length };
+    const unsigned char *data = block->data;
+
+    if (auditCompression) {
+        size_t stored = compressAuditBlock(block->data, block->length, auditScratch, block->length - 1);
+        if (stored > 0) {
+            lengths[1] = (unsigned int)stored;
+            data = auditScratch;
+        }
+    }
+    if (fwrite(lengths, sizeof(lengths), 1, auditFile) != 1 || fwrite(data, 1, lengths[1], auditFile) != lengths[1] || fflush(auditFile) != 0) {
+        auditFailed = 1;
+    }
+}
 
-    // Update the index.txt file
-    FILE *indexFile = fopen("index.txt", "r");
-    if(indexFile == NULL){
-        printf("Error: Could not open index file.\n");
-        return;
+static void *auditWriter(void *unused) {
+    (void)unused;
+    traceThreadName("audit");
+    while (1) {
+        while (sem_wait(&auditReady) != 0 && errno == EINTR) {
+        }
+        // stopAuditLog's extra post is only reached once every sealed block has been written
+        if (auditWritten == __atomic_load_n(&auditSealed, __ATOMIC_ACQUIRE)) {
+            return NULL;
+        }
+        writeAuditBlock(&auditRing[auditWritten % AUDIT_RING_BLOCKS]);
+        auditWritten++;
+        sem_post(&auditFree);
     }
+}
 
-    // Create a temporary file to write the updated index
-    FILE *tempFile = fopen("temp_index.txt", "w");
-    if(tempFile == NULL){
-        printf("Error: Could not create temporary index file.\n");
-        fclose(indexFile);
+// Hands the current block to the writer and moves on to the next, waiting if the writer is a whole ring behind
+static void sealAuditBlock(void) {
+    struct AuditBlock *block = &auditRing[auditSealed % AUDIT_RING_BLOCKS];
+    if (block->length == 0) {
+        return;
+    }
+    if (!auditThreadRunning) {
+        writeAuditBlock(block);
+        block->length = 0;
         return;
     }
 
-    char line[100];
-    while(fgets(line, sizeof(line), indexFile)){
-        // Remove the newline character from the line
-        line[strcspn(line, "\n")] = '\0';
-
-        // If the line does not match the fileName, write it to the temp file
-        if(strcmp(line, fileName) != 0){
-            fprintf(tempFile, "%s\n", line);
-        }
+    __atomic_store_n(&auditSealed, auditSealed + 1, __ATOMIC_RELEASE);
+    sem_post(&auditReady);
+    while (sem_wait(&auditFree) != 0 && errno == EINTR) {
     }
+    auditRing[auditSealed % AUDIT_RING_BLOCKS].length = 0;
+}
 
-    fclose(indexFile);
-    fclose(tempFile);
+// Records never straddle two blocks, so each block can be read on its own
+static void auditAppend(const void *record, size_t length) {
+    struct AuditBlock *block = &auditRing[auditSealed % AUDIT_RING_BLOCKS];
+    if (block->length + length > AUDIT_BLOCK_SIZE) {
+        sealAuditBlock();
+        block = &auditRing[auditSealed % AUDIT_RING_BLOCKS];
+    }
+    memcpy(block->data + block->length, record, length);
+    block->length += (unsigned int)length;
+}
 
-    // Replace the old index file with the updated one
-    if(remove("index.txt") == 0){
-        if(rename("temp_index.txt", "index.txt") == 0){
-            printf("Index file updated successfully.\n");
-        } else {
-            printf("Error: Could not rename temporary index file.\n");
-        }
-    } else {
-        printf("Error: Could not delete old index file.\n");
+// Slot of a name in auditNameSlots, either the one holding its id or the empty one it would go in
+static unsigned int auditNameSlot(const char *name) {
+    unsigned int slot = (unsigned int)nameHash(name) & (auditNameSlotCount - 1);
+    while (auditNameSlots[slot] != AUDIT_NO_NAME && strcmp(auditNames[auditNameSlots[slot]], name) != 0) {
+        slot = (slot + 1) & (auditNameSlotCount - 1);
     }
+    return slot;
+}
 
-    printf("\nYour character has been deleted...\n\n");
+// Doubles the name table and puts every id back in
+static void growAuditNameSlots(void) {
+    trackedFree(auditNameSlots, MEMORY_IO);
+    auditNameSlotCount = auditNameSlotCount > 0 ? auditNameSlotCount * 2 : 256;
+    auditNameSlots = trackedMalloc(auditNameSlotCount * sizeof(unsigned int), MEMORY_IO);
+    if (auditNameSlots == NULL) {
+        printf("Memory allocation failed.\n");
+        exit(1);
+    }
+    memset(auditNameSlots, 0xFF, auditNameSlotCount * sizeof(unsigned int));
+    for (int i = 0; i < auditNameCount; i++) {
+        auditNameSlots[auditNameSlot(auditNames[i])] = (unsigned int)i;
+    }
 }
 
-void levelUpCharacter(struct Character *character, char *levelCharacterName){
-    int userChoice;
-    int validInput = 0;
-    if (strcmp(character->name, levelCharacterName) == 0){
-        printf("Are you sure you want to level up '%s'?\n", character->name);
-        printf("1. Yes\n");
-        printf("2. No\n");
-        
-        while(!validInput){
-            printf("Enter your Choice: ");
-            scanf("%d", &userChoice);
+// Id of the character's name, logging the name the first time the character rolls
+static unsigned int auditNameId(struct Character *character) {
+    if (character == NULL) {
+        return AUDIT_NO_NAME;
+    }
+    if (auditLastName != AUDIT_NO_NAME && strcmp(auditNames[auditLastName], character->name) == 0) {
+        return auditLastName;
+    }
+    if ((unsigned int)auditNameCount * 2 >= auditNameSlotCount) {
+        growAuditNameSlots();
+    }
+    unsigned int slot = auditNameSlot(character->name);
+    if (auditNameSlots[slot] != AUDIT_NO_NAME) {
+        auditLastName = auditNameSlots[slot];
+        return auditLastName;
+    }
 
-            if(userChoice != 1 && userChoice != 2) {
-                printf("Invalid choice, please try again...\n\n");
-            } 
-            else{
-                validInput = 1;
-            }
-        }
-    if(userChoice == 1){
-        character->level++;
-        printf("\n'%s' has leveled up! New level: %d\n\n", character->name, character->level);
-        character->HP = calculateHealth(character);
-        if(character->level == 3){
-            printf("You have reached level 3! It's time to choose a subclass for '%s'.\n", character->name);
-            selectSubClass(character);
-        }
-        character->proficiencyModifier = calculateProficiencyModifier(character);
+    if (auditNameCount == auditNameCapacity) {
+        auditNames = growArray(auditNames, &auditNameCapacity, sizeof(auditNames[0]));
+    }
+    snprintf(auditNames[auditNameCount], sizeof(auditNames[0]), "%s", character->name);
+    auditNameSlots[slot] = (unsigned int)auditNameCount;
+
+    unsigned char record[6 + 24];
+    unsigned int id = (unsigned int)auditNameCount;
+    size_t length = strlen(auditNames[auditNameCount]);
+    record[0] = AUDIT_RECORD_NAME;
+    memcpy(record + 1, &id, 4);
+    record[5] = (unsigned char)length;
+    memcpy(record + 6, auditNames[auditNameCount], length);
+    auditAppend(record, 6 + length);
+
+    auditLastName = id;
+    auditNameCount++;
+    return id;
+}
 
-        // Determine the associated file name
-        char firstName[100];
-        sscanf(character->name, "%s", firstName);  // Get the first name
-        char fileName[100];
-        snprintf(fileName, sizeof(fileName), "%s.txt", firstName);
+// A roll too long for one record is written in pieces, each but the last flagged AUDIT_CONTINUED
+static void writeAuditRoll(int continued, int modifier, int result) {
+    unsigned char record[15 + AUDIT_MAX_DICE * 2];
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    unsigned int ms = (unsigned int)((now.tv_sec - auditOrigin.tv_sec) * 1000 + (now.tv_nsec - auditOrigin.tv_nsec) / 1000000);
+    short values[2] = { (short)modifier, (short)result };
+
+    record[0] = AUDIT_RECORD_ROLL;
+    record[1] = (unsigned char)(auditRoll.function | (continued ? AUDIT_CONTINUED : 0));
+    memcpy(record + 2, &auditRoll.nameId, 4);
+    memcpy(record + 6, &ms, 4);
+    memcpy(record + 10, values, 4);
+    record[14] = (unsigned char)auditRoll.dice;
+    memcpy(record + 15, auditRoll.faces, auditRoll.dice * 2);
+    auditAppend(record, 15 + auditRoll.dice * 2);
+    auditRoll.dice = 0;
+    auditRolls += !continued;
+}
 
-        // Update the character's file
-        FILE *characterFile = fopen(fileName, "w");
-        if (characterFile == NULL) {
-            printf("Error: Could not open the file '%s' for writing.\n", fileName);
-            return;
-        }
+void startAuditLog(unsigned long long seed) {
+    if (auditFileName[0] == '\0') {
+        return;
+    }
+    auditFile = fopen(auditFileName, "wb");
+    if (auditFile == NULL) {
+        printf("Error: Could not open the audit log '%s'.\n", auditFileName);
+        return;
+    }
 
-        writeCharacterToFile(fileName, character);
+    long long started = (long long)time(NULL);
+    unsigned int fields[2] = { auditCompression ? AUDIT_COMPRESSED : 0, AUDIT_BLOCK_SIZE };
+    if (fwrite(AUDIT_MAGIC, 8, 1, auditFile) != 1 || fwrite(&seed, 8, 1, auditFile) != 1 || fwrite(&started, 8, 1, auditFile) != 1 ||
+        fwrite(fields, sizeof(fields), 1, auditFile) != 1 || fflush(auditFile) != 0) {
+        printf("Error: Could not write the audit log '%s'.\n", auditFileName);
+        fclose(auditFile);
         return;
     }
+
+    auditRing = trackedMalloc(AUDIT_RING_BLOCKS * sizeof(struct AuditBlock), MEMORY_IO);
+    auditScratch = trackedMalloc(AUDIT_BLOCK_SIZE, MEMORY_IO);
+    if (auditRing == NULL || auditScratch == NULL) {
+        printf("Memory allocation failed.\n");
+        exit(1);
+    }
+    auditRing[0].length = 0;
+    sem_init(&auditReady, 0, 0);
+    sem_init(&auditFree, 0, AUDIT_RING_BLOCKS - 1);
+    clock_gettime(CLOCK_MONOTONIC, &auditOrigin);
+    if (pthread_create(&auditThread, NULL, auditWriter, NULL) == 0) {
+        auditThreadRunning = 1;
     }
     else {
-        printf("Error: Character not found...\n\n");
+        printf("Could not start the audit writer thread, writing each block as it fills instead.\n");
     }
+    auditing = 1;
 }
 
-// Dice rolling functions
-//generates a random number between 1 & 20
-int rollD20(void){
-    return rand() % 20 + 1;
+void auditBegin(enum AuditFunction function, struct Character *character) {
+    if (!auditing || auditRoll.depth++ > 0) {
+        return;
+    }
+    auditRoll.function = function;
+    auditRoll.nameId = auditNameId(character);
+    auditRoll.dice = 0;
 }
-//generates a random number between 1 & 12
-int rollD12(void){
-    return rand() % 12 + 1;
+
+void auditDie(int sides, int face) {
+    if (!auditing) {
+        return;
+    }
+    if (auditRoll.depth == 0) {
+        // Rolled outside the audited functions, so it is a roll of its own
+        auditBegin(AUDIT_DIE, rollingCharacter);
+        auditDie(sides, face);
+        auditEnd(0, face);
+        return;
+    }
+    if (auditRoll.dice == AUDIT_MAX_DICE) {
+        writeAuditRoll(1, 0, 0);
+    }
+    auditRoll.faces[auditRoll.dice][0] = (unsigned char)sides;
+    auditRoll.faces[auditRoll.dice][1] = (unsigned char)face;
+    auditRoll.dice++;
 }
-//generates a random number between 1 & 10
-int rollD10(void){
-    return rand() % 10 + 1;
+
+void auditEnd(int modifier, int result) {
+    if (!auditing || --auditRoll.depth > 0) {
+        return;
+    }
+    writeAuditRoll(0, modifier, result);
 }
-//generates a random number between 1 & 8
-int rollD8(void){
-    return rand() % 8 + 1;
+
+void auditDraw(unsigned long long value) {
+    if (!auditing) {
+        return;
+    }
+    unsigned char record[9];
+    record[0] = AUDIT_RECORD_DRAW;
+    memcpy(record + 1, &value, 8);
+    auditAppend(record, sizeof(record));
 }
-//generates a random number between 1 & 6
-int rollD6(void){
-    return rand() % 6 + 1;
+
+void stopAuditLog(void) {
+    if (!auditing) {
+        return;
+    }
+    sealAuditBlock();
+    auditing = 0;
+    if (auditThreadRunning) {
+        sem_post(&auditReady);
+        pthread_join(auditThread, NULL);
+        auditThreadRunning = 0;
+    }
+    sem_destroy(&auditReady);
+    sem_destroy(&auditFree);
+
+    int written = !auditFailed && fsync(fileno(auditFile)) == 0;
+    if (fclose(auditFile) != 0 || !written) {
+        printf("Error: The audit log '%s' could not be fully written.\n", auditFileName);
+    }
+    else {
+        printf("Wrote %llu roll(s) to the audit log %s.\n", auditRolls, auditFileName);
+    }
+
+    trackedFree(auditRing, MEMORY_IO);
+    trackedFree(auditScratch, MEMORY_IO);
+    trackedFree(auditNames, MEMORY_IO);
+    trackedFree(auditNameSlots, MEMORY_IO);
+    auditRing = NULL;
+    auditScratch = NULL;
+    auditNames = NULL;
+    auditNameSlots = NULL;
+    auditNameCount = auditNameCapacity = 0;
+    auditNameSlotCount = 0;
+    auditLastName = AUDIT_NO_NAME;
+}
+
+// State carried from block to block while a log is replayed
+struct AuditReplay {
+    struct Rng rng;                   // Generator reseeded from the log's header
+    char (*names)[25];
+    int nameCount;
+    int nameCapacity;
+    int functionFilter;               // 0 shows every function
+    int continuing;                   // Boolean indicating the previous record was part of a longer roll
+    unsigned long long rolls;
+    unsigned long long shown;
+    unsigned long long dice;
+    unsigned long long draws;
+    unsigned long long mismatches;    // Rolls or draws the generator disagrees with
+    unsigned long long wrongTotals;   // Rolls whose result doesn't follow from their dice and modifier
+};
+
+// Checks a whole roll's result against its dice and modifier
+static int auditRollAddsUp(int function, int modifier, int result, const unsigned char *dice, int count) {
+    int sum = 0;
+    for (int d = 0; d < count; d++) {
+        sum += dice[d * 2 + 1];
+    }
+    switch (function) {
+        case AUDIT_DIE:
+        case AUDIT_ROLL_D20:
+            return count == 1 && modifier == 0 && result == sum;
+        case AUDIT_ROLL_MODIFIER:
+            return count == 1 && dice[0] == 20 && result == sum + modifier;
+        case AUDIT_DAMAGE_ROLL:
+            return result == (sum + modifier > 1 ? sum + modifier : 1);
+        case AUDIT_ATTACK_ROLL:
+            // Any damage dice from the hit follow the attack die
+            return count >= 1 && dice[0] == 20 && result == dice[1] + modifier;
+        default:
+            // An attack action's damage depends on the target's Armor Class, which isn't logged
+            return 1;
+    }
+}
+
+// Replays every record in one block, returns 0 if the block is damaged
+static int replayAuditBlock(const unsigned char *data, size_t length, struct AuditReplay *replay) {
+    size_t at = 0;
+
+    while (at < length) {
+        switch (data[at]) {
+            case AUDIT_RECORD_NAME: {
+                unsigned int id;
+                if (length - at < 6 || length - at - 6 < data[at + 5] || data[at + 5] > 24) {
+                    return 0;
+                }
+                memcpy(&id, data + at + 1, 4);
+                if (id != (unsigned int)replay->nameCount) {
+                    return 0;
+                }
+                if (replay->nameCount == replay->nameCapacity) {
+                    replay->names = growArray(replay->names, &replay->nameCapacity, sizeof(replay->names[0]));
+                }
+                memcpy(replay->names[replay->nameCount], data + at + 6, data[at + 5]);
+                replay->names[replay->nameCount][data[at + 5]] = '\0';
+                replay->nameCount++;
+                at += 6 + data[at + 5];
+                break;
+            }
+            case AUDIT_RECORD_DRAW: {
+                unsigned long long value;
+                if (length - at < 9) {
+                    return 0;
+                }
+                memcpy(&value, data + at + 1, 8);
+                int matches = value == rngNext(&replay->rng);
+                replay->draws++;
+                replay->mismatches += !matches;
+                if (replay->functionFilter == 0 && auditCharacterFilter[0] == '\0') {
+                    printf("%11s %-24s %-22s seed %llu for a seeded generator%s\n", "", "-", "rngNext", value,
+                           matches ? "" : "  <- does not match the generator");
+                }
+                at += 9;
+                break;
+            }
+            case AUDIT_RECORD_ROLL: {
+                unsigned int nameId;
+                unsigned int ms;
+                short values[2];
+                if (length - at < 15 || length - at - 15 < (size_t)data[at + 14] * 2) {
+                    return 0;
+                }
+                int function = data[at + 1] & ~AUDIT_CONTINUED;
+                int continued = (data[at + 1] & AUDIT_CONTINUED) != 0;
+                int count = data[at + 14];
+                const unsigned char *dice = data + at + 15;
+                memcpy(&nameId, data + at + 2, 4);
+                memcpy(&ms, data + at + 6, 4);
+                memcpy(values, data + at + 10, 4);
+                if (function < 1 || function >= AUDIT_FUNCTIONS || (nameId != AUDIT_NO_NAME && nameId >= (unsigned int)replay->nameCount)) {
+                    return 0;
+                }
+
+                // Every die is replayed, shown or not, to keep the generator in step
+                int matches = 1, expected = 0, firstWrong = -1;
+                for (int d = 0; d < count; d++) {
+                    if (dice[d * 2] == 0) {
+                        return 0;
+                    }
+                    int face = rngRoll(&replay->rng, dice[d * 2]);
+                    if (face != dice[d * 2 + 1] && firstWrong < 0) {
+                        firstWrong = d;
+                        expected = face;
+                        matches = 0;
+                    }
+                }
+                int whole = !continued && !replay->continuing;
+                int addsUp = !whole || auditRollAddsUp(function, values[0], values[1], dice, count);
+                replay->dice += count;
+                replay->rolls += !continued;
+                replay->mismatches += !matches;
+                replay->wrongTotals += !addsUp;
+                replay->continuing = continued;
+
+                const char *name = nameId == AUDIT_NO_NAME ? "-" : replay->names[nameId];
+                if ((replay->functionFilter == 0 || replay->functionFilter == function) &&
+                    (auditCharacterFilter[0] == '\0' || strcmp(auditCharacterFilter, name) == 0)) {
+                    printf("[%9.3fs] %-24s %-22s", ms / 1000.0, name, auditFunctionNames[function]);
+                    for (int d = 0; d < count; d++) {
+                        printf(" d%d:%d", dice[d * 2], dice[d * 2 + 1]);
+                    }
+                    if (continued) {
+                        printf(" ...");
+                    }
+                    else {
+                        printf("  %+d = %d", values[0], values[1]);
+                    }
+                    if (!matches) {
+                        printf("  <- the generator rolls d%d:%d", dice[firstWrong * 2], expected);
+                    }
+                    if (!addsUp) {
+                        printf("  <- the result doesn't add up");
+                    }
+                    printf("\n");
+                    replay->shown += !continued;
+                }
+                at += 15 + count * 2;
+                break;
+            }
+            default:
+                return 0;
+        }
+    }
+    return 1;
+}
+
+int readAuditLog(const char *fileName) {
+    char magic[8];
+    unsigned long long seed;
+    long long started;
+    unsigned int fields[2];
+    struct AuditReplay replay;
+
+    memset(&replay, 0, sizeof(replay));
+    if (auditFunctionFilter[0] != '\0') {
+        for (int f = 1; f < AUDIT_FUNCTIONS; f++) {
+            if (strcasecmp(auditFunctionFilter, auditFunctionNames[f]) == 0) {
+                replay.functionFilter = f;
+            }
+        }
+        if (replay.functionFilter == 0) {
+            printf("Unknown function '%s'. Rolls are made by:", auditFunctionFilter);
+            for (int f = 1; f < AUDIT_FUNCTIONS; f++) {
+                printf(" %s", auditFunctionNames[f]);
+            }
+            printf("\n");
+            return 1;
+        }
+    }
+
+    FILE *file = fopen(fileName, "rb");
+    if (file == NULL) {
+        printf("Couldn't open %s.\n", fileName);
+        return 1;
+    }
+    if (fread(magic, 8, 1, file) != 1 || memcmp(magic, AUDIT_MAGIC, 8) != 0 || fread(&seed, 8, 1, file) != 1 ||
+        fread(&started, 8, 1, file) != 1 || fread(fields, sizeof(fields), 1, file) != 1 || fields[1] == 0 || fields[1] > (1U << 24)) {
+        printf("%s is not an audit log.\n", fileName);
+        fclose(file);
+        return 1;
+    }
+
+    char when[32];
+    time_t startTime = (time_t)started;
+    strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", localtime(&startTime));
+    printf("Audit log %s, started %s with dice seed %llu%s.\n\n", fileName, when, seed, (fields[0] & AUDIT_COMPRESSED) ? " (compressed)" : "");
+
+    unsigned int blockSize = fields[1];
+    unsigned char *stored = trackedMalloc(blockSize, MEMORY_IO);
+    unsigned char *raw = trackedMalloc(blockSize, MEMORY_IO);
+    if (stored == NULL || raw == NULL) {
+        printf("Memory allocation failed.\n");
+        exit(1);
+    }
+    rngSeed(&replay.rng, seed);
+
+    unsigned int lengths[2];
+    int blocks = 0, damaged = 0;
+    while (!damaged && fread(lengths, sizeof(lengths), 1, file) == 1) {
+        blocks++;
+        if (lengths[0] == 0 || lengths[0] > blockSize || lengths[1] == 0 || lengths[1] > lengths[0]) {
+            printf("Block %d is damaged.\n", blocks);
+            damaged = 1;
+        }
+        else if (fread(stored, 1, lengths[1], file) != lengths[1]) {
+            printf("The log ends part way through block %d.\n", blocks);
+            damaged = 1;
+        }
+        else {
+            const unsigned char *data = stored;
+            if (lengths[1] < lengths[0]) {
+                data = raw;
+                damaged = decompressAuditBlock(stored, lengths[1], raw, lengths[0]) != lengths[0];
+            }
+            damaged = damaged || !replayAuditBlock(data, lengths[0], &replay);
+            if (damaged) {
+                printf("Block %d is damaged.\n", blocks);
+            }
+        }
+    }
+    fclose(file);
+    trackedFree(stored, MEMORY_IO);
+    trackedFree(raw, MEMORY_IO);
+    trackedFree(replay.names, MEMORY_IO);
+
+    printf("\n%llu roll(s) in %d block(s)", replay.rolls, blocks);
+    if (replay.functionFilter != 0 || auditCharacterFilter[0] != '\0') {
+        printf(", %llu shown", replay.shown);
+    }
+    printf(". Replayed %llu die roll(s) and %llu seed draw(s).\n", replay.dice, replay.draws);
+    if (replay.mismatches == 0 && replay.wrongTotals == 0 && !damaged) {
+        printf("Every roll matches the seeded generator.\n");
+        return 0;
+    }
+    if (replay.mismatches > 0) {
+        printf("%llu roll(s) do not match the seeded generator.\n", replay.mismatches);
+    }
+    if (replay.wrongTotals > 0) {
+        printf("%llu roll(s) have a result that doesn't follow from their dice.\n", replay.wrongTotals);
+    }
+    return 1;
 }
-//generates a random number between 1 & 4
-int rollD4(void){
-    return rand() % 4 + 1;
-}
\ No newline at end of file